@@ -30,6 +30,12 @@ extern "C"
 #define PACKED_END
 #endif
 
+/* memory barriers for data shared between threads without locks, stores
+ * before the release barrier are seen before the stores after it, loads
+ * before the acquire barrier are done before the loads after it */
+#define OSAL_RELEASE_BARRIER() __atomic_thread_fence(__ATOMIC_RELEASE)
+#define OSAL_ACQUIRE_BARRIER() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+
 int osal_gettimeofday(struct timeval *tv, struct timezone *tz);
 void *osal_malloc(size_t size);
 void osal_free(void *ptr);
@@ -86,3 +86,32 @@ osal_mutex_t * osal_mtx_create(void)
         /* return (void*)RtCreateMutex(NULL, FALSE, NULL); */
         return (void *)0;
 }
+
+/** Monotonic time in ns from some unspecified moment in the past.
+ *
+ * @return monotonic time in ns
+ */
+int64 osal_monotonic_time(void)
+{
+   struct timeval tv;
+
+   osal_gettimeofday(&tv, 0);
+   return (int64)tv.tv_sec * 1000000000LL + (int64)tv.tv_usec * 1000LL;
+}
+
+/** Sleep until an absolute deadline on the osal_monotonic_time clock.
+ *
+ * @param[in]  deadline   = deadline in ns
+ * @return 0 on success
+ */
+int osal_sleep_until(int64 deadline)
+{
+   int64 now;
+
+   now = osal_monotonic_time();
+   if (deadline > now)
+   {
+      osal_usleep((uint32)((deadline - now) / 1000));
+   }
+   return 0;
+}
@@ -32,6 +32,18 @@ extern "C"
     #endif
 #endif
 
+/* memory barriers for data shared between threads without locks, stores
+ * before the release barrier are seen before the stores after it, loads
+ * before the acquire barrier are done before the loads after it */
+#ifdef _MSC_VER
+#include <intrin.h>
+#define OSAL_RELEASE_BARRIER() _ReadWriteBarrier()
+#define OSAL_ACQUIRE_BARRIER() _ReadWriteBarrier()
+#elif defined(__GNUC__)
+#define OSAL_RELEASE_BARRIER() __atomic_thread_fence(__ATOMIC_RELEASE)
+#define OSAL_ACQUIRE_BARRIER() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#endif
+
 #define OSAL_THREAD_HANDLE   RTHANDLE
 #define OSAL_THREAD_FUNC     void
 #define OSAL_THREAD_FUNC_RT  void
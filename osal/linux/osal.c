@@ -3,14 +3,20 @@
  * LICENSE file in the project root for full license information
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
 #include <time.h>
 #include <sys/time.h>
+#include <sched.h>
+#include <errno.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <string.h>
 #include <osal.h>
 
 #define USECS_PER_SEC     1000000
+#define NSECS_PER_SEC     1000000000
 
 int osal_usleep (uint32 usec)
 {
@@ -142,3 +148,85 @@ int osal_thread_create_rt(void *thandle, int stacksize, void *func, void *param)
 
    return 1;
 }
+
+/** Create a thread with SCHED_FIFO priority and optional CPU affinity. Both
+ * are applied through the thread attributes, so the thread never runs with
+ * the wrong settings and nothing is left running when they are refused.
+ * The thread is created detached, it releases its resources when it returns.
+ *
+ * @param[out] thandle    = pthread_t handle
+ * @param[in]  stacksize  = stack size in bytes
+ * @param[in]  func       = thread function
+ * @param[in]  param      = thread function argument
+ * @param[in]  priority   = SCHED_FIFO priority, 0 keeps the default policy
+ * @param[in]  cpu        = CPU to pin the thread to, -1 for no affinity
+ * @return 1 on success, 0 if the thread could not be created
+ */
+int osal_thread_create_rt_affinity(void *thandle, int stacksize, void *func, void *param,
+                                   int priority, int cpu)
+{
+   int                  ret;
+   pthread_attr_t       attr;
+   struct sched_param   schparam;
+   cpu_set_t            cpuset;
+   pthread_t            *threadp;
+
+   threadp = thandle;
+   pthread_attr_init(&attr);
+   pthread_attr_setstacksize(&attr, stacksize);
+   pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+   if (priority > 0)
+   {
+      memset(&schparam, 0, sizeof(schparam));
+      schparam.sched_priority = priority;
+      pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+      pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+      pthread_attr_setschedparam(&attr, &schparam);
+   }
+   if (cpu >= 0)
+   {
+      CPU_ZERO(&cpuset);
+      CPU_SET(cpu, &cpuset);
+      pthread_attr_setaffinity_np(&attr, sizeof(cpuset), &cpuset);
+   }
+   ret = pthread_create(threadp, &attr, func, param);
+   pthread_attr_destroy(&attr);
+   if(ret != 0)
+   {
+      return 0;
+   }
+
+   return 1;
+}
+
+/** Monotonic time in ns from some unspecified moment in the past.
+ *
+ * @return monotonic time in ns
+ */
+int64 osal_monotonic_time(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (int64)ts.tv_sec * NSECS_PER_SEC + ts.tv_nsec;
+}
+
+/** Sleep until an absolute monotonic deadline.
+ *
+ * @param[in]  deadline   = deadline in ns on the osal_monotonic_time clock
+ * @return 0 on success
+ */
+int osal_sleep_until(int64 deadline)
+{
+   struct timespec ts;
+   int ret;
+
+   ts.tv_sec = deadline / NSECS_PER_SEC;
+   ts.tv_nsec = deadline % NSECS_PER_SEC;
+   do
+   {
+      ret = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+   } while (ret == EINTR);
+
+   return ret;
+}
@@ -51,6 +51,10 @@ ec_timet osal_current_time(void);
 void osal_time_diff(ec_timet *start, ec_timet *end, ec_timet *diff);
 int osal_thread_create(void *thandle, int stacksize, void *func, void *param);
 int osal_thread_create_rt(void *thandle, int stacksize, void *func, void *param);
+int osal_thread_create_rt_affinity(void *thandle, int stacksize, void *func, void *param,
+                                   int priority, int cpu);
+int64 osal_monotonic_time(void);
+int osal_sleep_until(int64 deadline);
 
 #ifdef __cplusplus
 }
@@ -142,3 +142,75 @@ int osal_thread_create_rt(void *thandle, int stacksize, void *func, void *param)
 
    return 1;
 }
+
+/** Create a thread with SCHED_FIFO priority. CPU affinity is not supported
+ * on this port and the cpu argument is ignored.
+ * The thread is created detached, it releases its resources when it returns.
+ *
+ * @param[out] thandle    = pthread_t handle
+ * @param[in]  stacksize  = stack size in bytes
+ * @param[in]  func       = thread function
+ * @param[in]  param      = thread function argument
+ * @param[in]  priority   = SCHED_FIFO priority, 0 keeps the default policy
+ * @param[in]  cpu        = ignored
+ * @return 1 on success, 0 if the thread could not be created
+ */
+int osal_thread_create_rt_affinity(void *thandle, int stacksize, void *func, void *param,
+                                   int priority, int cpu)
+{
+   int                  ret;
+   pthread_attr_t       attr;
+   struct sched_param   schparam;
+   pthread_t            *threadp;
+
+   (void)cpu;
+   threadp = thandle;
+   pthread_attr_init(&attr);
+   pthread_attr_setstacksize(&attr, stacksize);
+   pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+   if (priority > 0)
+   {
+      memset(&schparam, 0, sizeof(schparam));
+      schparam.sched_priority = priority;
+      pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+      pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+      pthread_attr_setschedparam(&attr, &schparam);
+   }
+   ret = pthread_create(threadp, &attr, func, param);
+   pthread_attr_destroy(&attr);
+   if(ret != 0)
+   {
+      return 0;
+   }
+
+   return 1;
+}
+
+/** Monotonic time in ns from some unspecified moment in the past.
+ *
+ * @return monotonic time in ns
+ */
+int64 osal_monotonic_time(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (int64)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/** Sleep until an absolute deadline on the osal_monotonic_time clock.
+ *
+ * @param[in]  deadline   = deadline in ns
+ * @return 0 on success
+ */
+int osal_sleep_until(int64 deadline)
+{
+   int64 now;
+
+   now = osal_monotonic_time();
+   if (deadline > now)
+   {
+      osal_usleep((uint32)((deadline - now) / 1000));
+   }
+   return 0;
+}
@@ -143,3 +143,55 @@ int osal_thread_create_rt(void *thandle, int stacksize, void *func, void *param)
    }
    return 1;
 }
+
+/** Create a task with the given priority. CPU affinity is not supported on
+ * this port and the cpu argument is ignored.
+ *
+ * @param[out] thandle    = task handle
+ * @param[in]  stacksize  = stack size in bytes
+ * @param[in]  func       = task function
+ * @param[in]  param      = task function argument
+ * @param[in]  priority   = task priority, 0 selects the default rt priority
+ * @param[in]  cpu        = ignored
+ * @return 1 on success, 0 if the task could not be created
+ */
+int osal_thread_create_rt_affinity(void *thandle, int stacksize, void *func, void *param,
+                                   int priority, int cpu)
+{
+   (void)cpu;
+   thandle = task_spawn ("worker_rt", func, (priority > 0) ? priority : 15, stacksize, param);
+   if(!thandle)
+   {
+      return 0;
+   }
+   return 1;
+}
+
+/** Monotonic time in ns from some unspecified moment in the past.
+ *
+ * @return monotonic time in ns
+ */
+int64 osal_monotonic_time(void)
+{
+   struct timeval tv;
+
+   gettimeofday(&tv, 0);
+   return (int64)tv.tv_sec * 1000000000LL + (int64)tv.tv_usec * 1000LL;
+}
+
+/** Sleep until an absolute deadline on the osal_monotonic_time clock.
+ *
+ * @param[in]  deadline   = deadline in ns
+ * @return 0 on success
+ */
+int osal_sleep_until(int64 deadline)
+{
+   int64 now;
+
+   now = osal_monotonic_time();
+   if (deadline > now)
+   {
+      osal_usleep((uint32)((deadline - now) / 1000));
+   }
+   return 0;
+}
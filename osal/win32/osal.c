@@ -150,3 +150,57 @@ int osal_thread_create_rt(void **thandle, int stacksize, void *func, void *param
    }
    return ret;
 }
+
+/** Create a time critical thread. The priority argument is ignored, the
+ * thread always runs at THREAD_PRIORITY_TIME_CRITICAL.
+ *
+ * @param[out] thandle    = thread handle
+ * @param[in]  stacksize  = stack size in bytes
+ * @param[in]  func       = thread function
+ * @param[in]  param      = thread function argument
+ * @param[in]  priority   = ignored
+ * @param[in]  cpu        = CPU to pin the thread to, -1 for no affinity
+ * @return 1 on success, 0 if the thread could not be created
+ */
+int osal_thread_create_rt_affinity(void **thandle, int stacksize, void *func, void *param,
+                                   int priority, int cpu)
+{
+   int ret;
+
+   (void)priority;
+   ret = osal_thread_create_rt(thandle, stacksize, func, param);
+   if (ret && (cpu >= 0))
+   {
+      SetThreadAffinityMask(*thandle, (DWORD_PTR)1 << cpu);
+   }
+   return ret;
+}
+
+/** Monotonic time in ns from some unspecified moment in the past.
+ *
+ * @return monotonic time in ns
+ */
+int64 osal_monotonic_time(void)
+{
+   struct timeval tv;
+
+   osal_getrelativetime(&tv, 0);
+   return (int64)tv.tv_sec * 1000000000LL + (int64)tv.tv_usec * 1000LL;
+}
+
+/** Sleep until an absolute deadline on the osal_monotonic_time clock.
+ *
+ * @param[in]  deadline   = deadline in ns
+ * @return 0 on success
+ */
+int osal_sleep_until(int64 deadline)
+{
+   int64 now;
+
+   now = osal_monotonic_time();
+   if (deadline > now)
+   {
+      osal_usleep((uint32)((deadline - now) / 1000));
+   }
+   return 0;
+}
@@ -26,6 +26,12 @@ extern "C"
 #define PACKED_END __pragma(pack(pop))
 #endif
 
+/* memory barriers for data shared between threads without locks, stores
+ * before the release barrier are seen before the stores after it, loads
+ * before the acquire barrier are done before the loads after it */
+#define OSAL_RELEASE_BARRIER() MemoryBarrier()
+#define OSAL_ACQUIRE_BARRIER() MemoryBarrier()
+
 #define OSAL_THREAD_HANDLE HANDLE
 #define OSAL_THREAD_FUNC void
 #define OSAL_THREAD_FUNC_RT void
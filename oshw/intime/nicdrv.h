@@ -77,6 +77,8 @@ typedef struct
    uint8          lastidx;
    /** current redundancy state */
    int            redstate;
+   /** number of frames transmitted on the primary port */
+   uint32         txframes;
    /** pointer to redundancy port and buffers */
    ecx_redportt   *redport;
    RTHANDLE       getindex_region;
@@ -98,19 +100,26 @@ int ec_setupnic(const char * ifname, int secondary);
 int ec_closenic(void);
 void ec_setupheader(void *p);
 void ec_setbufstat(uint8 idx, int bufstat);
-uint8 ec_getindex(void);
+int ec_getindex(void);
+int ec_getindex_part(int part);
+void ec_getframetime(uint8 idx, ec_frametimet *frametime);
 int ec_outframe(uint8 idx, int sock);
 int ec_outframe_red(uint8 idx);
+int ec_outframe_red_batch(const uint8 *idx, int n);
 int ec_waitinframe(uint8 idx, int timeout);
 int ec_srconfirm(uint8 idx,int timeout);
 
 int ecx_setupnic(ecx_portt *port, const char * ifname, int secondary);
 int ecx_closenic(ecx_portt *port);
 void ecx_setbufstat(ecx_portt *port, uint8 idx, int bufstat);
-uint8 ecx_getindex(ecx_portt *port);
+int ecx_getindex(ecx_portt *port);
+int ecx_getindex_part(ecx_portt *port, int part);
+void ecx_getframetime(ecx_portt *port, uint8 idx, ec_frametimet *frametime);
 int ecx_outframe(ecx_portt *port, uint8 idx, int sock);
 int ecx_outframe_red(ecx_portt *port, uint8 idx);
+int ecx_outframe_red_batch(ecx_portt *port, const uint8 *idx, int n);
 int ecx_waitinframe(ecx_portt *port, uint8 idx, int timeout);
+int ecx_waitinframe_any(ecx_portt *port, const uint8 *idx, int n, int *wkc, int timeout);
 int ecx_srconfirm(ecx_portt *port, uint8 idx,int timeout);
 
 #endif
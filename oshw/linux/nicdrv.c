@@ -28,8 +28,13 @@
  * packets. The software layer will detect the possible failure modes and
  * compensate. If needed the packets from interface A are resent through interface B.
  * This layer if fully transparent for the higher layers.
+ *
+ * Instead of the PF_PACKET socket an AF_XDP socket can be used, see
+ * nicdrv_xdp.c and ECT_PORTMODE_XDP.
  */
 
+/* sendmmsg() and recvmmsg() */
+#define _GNU_SOURCE
 #include <sys/types.h>
 #include <sys/ioctl.h>
 #include <net/if.h>
@@ -39,9 +44,18 @@
 #include <time.h>
 #include <arpa/inet.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <fcntl.h>
 #include <string.h>
-#include <netpacket/packet.h>
+#include <sys/mman.h>
+#include <linux/if_packet.h>
+#include <poll.h>
+#include <limits.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <sys/eventfd.h>
+#include <linux/net_tstamp.h>
+#include <linux/errqueue.h>
 #include <pthread.h>
 
 #include "oshw.h"
@@ -72,6 +86,15 @@ const uint16 secMAC[3] = { 0x0404, 0x0404, 0x0404 };
 /** second MAC word is used for identification */
 #define RX_SEC secMAC[1]
 
+/** size of one frame slot in the packet rings, holds header and max frame */
+#define EC_RINGFRAMESIZE   2048
+/** number of frame slots in the receive ring, must be a power of 2 */
+#define EC_RXRINGFRAMES    64
+/** number of frame slots in the transmit ring, must be a power of 2 */
+#define EC_TXRINGFRAMES    64
+/** size of the ancillary data buffer receiving the timestamps of one frame */
+#define EC_CMSGSIZE        256
+
 static void ecx_clear_rxbufstat(int *rxbufstat)
 {
    int i;
@@ -81,23 +104,225 @@ static void ecx_clear_rxbufstat(int *rxbufstat)
    }
 }
 
-/** Basic setup to connect NIC to socket.
+/** Current time on the clock of the kernel timestamps.
+ * @return time in ns since 1970-01-01
+ */
+static int64 ecx_realtime(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_REALTIME, &ts);
+
+   return ((int64)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+/** Software timestamp of a message read with recvmsg().
+ * @param[in] msg         = message header with ancillary data
+ * @return time in ns since 1970-01-01, 0 if the message has none
+ */
+static int64 ecx_cmsgtime(struct msghdr *msg)
+{
+   struct cmsghdr *cmsg;
+   struct scm_timestamping ts;
+
+   for (cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg))
+   {
+      if ((cmsg->cmsg_level == SOL_SOCKET) && (cmsg->cmsg_type == SCM_TIMESTAMPING))
+      {
+         memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+         return ((int64)ts.ts[0].tv_sec * 1000000000) + ts.ts[0].tv_nsec;
+      }
+   }
+
+   return 0;
+}
+
+/** Non blocking read of one frame from a socket with its receive timestamp.
+ * @param[in]  sock       = socket
+ * @param[out] buf        = frame buffer
+ * @param[in]  len        = size of frame buffer
+ * @param[in]  flags      = recvmsg() flags
+ * @param[out] rxtime     = receive timestamp, 0 if not available
+ * @return number of bytes read or -1
+ */
+static int ecx_recvts(int sock, void *buf, int len, int flags, int64 *rxtime)
+{
+   struct msghdr msg;
+   struct iovec iov;
+   uint8 cbuf[EC_CMSGSIZE];
+   int bytesrx;
+
+   iov.iov_base = buf;
+   iov.iov_len = len;
+   memset(&msg, 0, sizeof(msg));
+   msg.msg_iov = &iov;
+   msg.msg_iovlen = 1;
+   msg.msg_control = cbuf;
+   msg.msg_controllen = sizeof(cbuf);
+   bytesrx = recvmsg(sock, &msg, flags);
+   *rxtime = (bytesrx > 0) ? ecx_cmsgtime(&msg) : 0;
+
+   return bytesrx;
+}
+
+/** Read the transmit timestamps the kernel queued on the error queue of the
+ * primary socket. The looped back frame carries the index the timestamp
+ * belongs to.
  * @param[in] port        = port context struct
- * @param[in] ifname      = Name of NIC device, f.e. "eth0"
- * @param[in] secondary   = if >0 then use secondary stack instead of primary
+ */
+static void ecx_txtsdrain(ecx_portt *port)
+{
+   struct msghdr msg;
+   struct iovec iov;
+   uint8 buf[ETH_HEADERSIZE + sizeof(ec_comt)];
+   uint8 cbuf[EC_CMSGSIZE];
+   ec_comt *ecp;
+   int64 txtime;
+
+   if (!(port->portmode & ECT_PORTMODE_TIMESTAMP) || port->xsk.umem)
+   {
+      return;
+   }
+   do
+   {
+      iov.iov_base = buf;
+      iov.iov_len = sizeof(buf);
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_iov = &iov;
+      msg.msg_iovlen = 1;
+      msg.msg_control = cbuf;
+      msg.msg_controllen = sizeof(cbuf);
+      if (recvmsg(port->sockhandle, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < (int)sizeof(buf))
+      {
+         return;
+      }
+      txtime = ecx_cmsgtime(&msg);
+      ecp = (ec_comt *)&buf[ETH_HEADERSIZE];
+      if (txtime && (ecp->index < port->bufnr))
+      {
+         port->txtime[ecp->index] = txtime;
+      }
+   } while (1);
+}
+
+/** Attach mmap'd packet rings to a socket. TPACKET_V2 is used because it
+ * hands every frame to user space as soon as it is received, TPACKET_V3
+ * retires its blocks with a millisecond timer which is too slow for
+ * cyclic process data.
+ * @param[in]  sock        = socket handle
+ * @param[out] rxring      = receive ring, NULL if not wanted
+ * @param[out] txring      = transmit ring, NULL if not wanted
+ * @param[out] map         = start of mapped area
+ * @param[out] mapsize     = size of mapped area
  * @return >0 if succeeded
  */
-int ecx_setupnic(ecx_portt *port, const char *ifname, int secondary)
+static int ecx_setupring(int sock, ec_ringT *rxring, ec_ringT *txring, void **map, size_t *mapsize)
+{
+   int i;
+   long blocksize;
+   size_t rxsize, txsize;
+   struct tpacket_req req;
+   uint8 *p;
+
+   i = TPACKET_V2;
+   if (setsockopt(sock, SOL_PACKET, PACKET_VERSION, &i, sizeof(i)) != 0)
+   {
+      return 0;
+   }
+   blocksize = sysconf(_SC_PAGESIZE);
+   if (blocksize < EC_RINGFRAMESIZE)
+   {
+      blocksize = EC_RINGFRAMESIZE;
+   }
+   rxsize = 0;
+   txsize = 0;
+   p = MAP_FAILED;
+   req.tp_block_size = blocksize;
+   req.tp_frame_size = EC_RINGFRAMESIZE;
+   if (rxring)
+   {
+      req.tp_frame_nr = EC_RXRINGFRAMES;
+      req.tp_block_nr = (EC_RXRINGFRAMES * EC_RINGFRAMESIZE) / blocksize;
+      if (setsockopt(sock, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) == 0)
+      {
+         rxsize = (size_t)req.tp_block_size * req.tp_block_nr;
+      }
+   }
+   if (txring && (!rxring || rxsize))
+   {
+      /* drop malformed frames instead of stalling the ring */
+      i = 1;
+      setsockopt(sock, SOL_PACKET, PACKET_LOSS, &i, sizeof(i));
+      req.tp_frame_nr = EC_TXRINGFRAMES;
+      req.tp_block_nr = (EC_TXRINGFRAMES * EC_RINGFRAMESIZE) / blocksize;
+      if (setsockopt(sock, SOL_PACKET, PACKET_TX_RING, &req, sizeof(req)) == 0)
+      {
+         txsize = (size_t)req.tp_block_size * req.tp_block_nr;
+      }
+   }
+   *mapsize = rxsize + txsize;
+   if ((!rxring || rxsize) && (!txring || txsize))
+   {
+      p = mmap(NULL, *mapsize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED, sock, 0);
+      if (p == MAP_FAILED)
+      {
+         /* locking the rings can fail without privileges, it is optional */
+         p = mmap(NULL, *mapsize, PROT_READ | PROT_WRITE, MAP_SHARED, sock, 0);
+      }
+   }
+   if (p == MAP_FAILED)
+   {
+      /* release rings again so recv() and send() keep working */
+      memset(&req, 0, sizeof(req));
+      if (rxsize)
+      {
+         setsockopt(sock, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req));
+      }
+      if (txsize)
+      {
+         setsockopt(sock, SOL_PACKET, PACKET_TX_RING, &req, sizeof(req));
+      }
+      *mapsize = 0;
+      return 0;
+   }
+   /* the kernel maps the receive ring first, followed by the transmit ring */
+   if (rxring)
+   {
+      rxring->base = p;
+      rxring->framesize = EC_RINGFRAMESIZE;
+      rxring->framenr = EC_RXRINGFRAMES;
+      rxring->head = 0;
+   }
+   if (txring)
+   {
+      txring->base = p + rxsize;
+      txring->framesize = EC_RINGFRAMESIZE;
+      txring->framenr = EC_TXRINGFRAMES;
+      txring->head = 0;
+      pthread_mutex_init(&(txring->mutex), NULL);
+   }
+   *map = p;
+
+   return 1;
+}
+
+/** Setup of the port state used by all transports, buffers, stacks and the
+ * frame index pool.
+ * @param[in] port        = port context struct
+ * @param[in] secondary   = if >0 then setup secondary stack instead of primary
+ * @return >0 if succeeded
+ */
+static int ecx_setupport(ecx_portt *port, int secondary)
 {
    int i;
-   int r, rval, ifindex;
-   struct timeval timeout;
-   struct ifreq ifr;
-   struct sockaddr_ll sll;
    int *psock;
+   ec_ringT *rxring;
+   ec_ringT *txring;
+   void **ringmap;
+   size_t *ringmapsize;
+   ec_xskT *xsk;
    pthread_mutexattr_t mutexattr;
 
-   rval = 0;
    if (secondary)
    {
       /* secondary port struct available? */
@@ -114,7 +339,24 @@ int ecx_setupnic(ecx_portt *port, const char *ifname, int secondary)
          port->redport->stack.rxbuf       = &(port->redport->rxbuf);
          port->redport->stack.rxbufstat   = &(port->redport->rxbufstat);
          port->redport->stack.rxsa        = &(port->redport->rxsa);
+         port->redport->stack.rxtime      = &(port->redport->rxtime);
+         memset(port->redport->rxtime, 0, sizeof(port->redport->rxtime));
+         port->redport->stack.rxring      = &(port->redport->rxring);
+         port->redport->stack.txring      = &(port->redport->txring);
+         port->redport->stack.xsk         = &(port->redport->xsk);
+         port->redport->stack.mmsgbuf     = &(port->redport->mmsgbuf);
+         port->redport->stack.rxwait      = &(port->redport->rxwait);
+         memset(port->redport->rxwait, 0, sizeof(port->redport->rxwait));
+      for (i = 0; i < EC_MAXBUF; i++)
+      {
+         port->redport->rxwait[i].evfd = -1;
+      }
          ecx_clear_rxbufstat(&(port->redport->rxbufstat[0]));
+         rxring = &(port->redport->rxring);
+         txring = &(port->redport->txring);
+         ringmap = &(port->redport->ringmap);
+         ringmapsize = &(port->redport->ringmapsize);
+         xsk = &(port->redport->xsk);
       }
       else
       {
@@ -126,11 +368,58 @@ int ecx_setupnic(ecx_portt *port, const char *ifname, int secondary)
    {
       pthread_mutexattr_init(&mutexattr);
       pthread_mutexattr_setprotocol(&mutexattr  , PTHREAD_PRIO_INHERIT);
-      pthread_mutex_init(&(port->getindex_mutex), &mutexattr);
       pthread_mutex_init(&(port->tx_mutex)      , &mutexattr);
       pthread_mutex_init(&(port->rx_mutex)      , &mutexattr);
       port->sockhandle        = -1;
       port->lastidx           = 0;
+      /* unknown modes select the defaults */
+      port->portmode &= (ECT_PORTMODE_RXRING | ECT_PORTMODE_TXRING | ECT_PORTMODE_XDP |
+                         ECT_PORTMODE_XDPSKB | ECT_PORTMODE_MMSG | ECT_PORTMODE_DISPATCH |
+                         ECT_PORTMODE_TIMESTAMP);
+      if ((port->waitmode < ECT_WAIT_SPIN) || (port->waitmode > ECT_WAIT_HYBRID))
+      {
+         port->waitmode = ECT_WAIT_SPIN;
+      }
+      if (port->spintime < 0)
+      {
+         port->spintime = 0;
+      }
+      if ((port->bufnr <= 0) || (port->bufnr > EC_MAXBUF))
+      {
+         port->bufnr = EC_MAXBUF;
+      }
+      memset(port->idxfree, 0, sizeof(port->idxfree));
+      for (i = 0; i < port->bufnr; i++)
+      {
+         port->idxfree[i / 64] |= (uint64)1 << (i % 64);
+      }
+      port->idxexhausted      = 0;
+      port->txframes          = 0;
+      port->redtxframes       = 0;
+      port->rxframes          = 0;
+      port->foreign           = 0;
+      port->stale             = 0;
+      port->timeouts          = 0;
+      port->retries           = 0;
+      port->redrepairs        = 0;
+#ifdef EC_TRACE
+      port->tracehead         = 0;
+      memset(port->trace, 0, sizeof(port->trace));
+#endif
+      /* reserved process data indexes first, best effort indexes after them */
+      if ((port->rtbufnr < 0) || (port->rtbufnr >= port->bufnr))
+      {
+         port->rtbufnr = 0;
+      }
+      memset(port->idxpart, 0, sizeof(port->idxpart));
+      port->idxpart[EC_IDXPART_RT].first = 0;
+      port->idxpart[EC_IDXPART_RT].nr = port->rtbufnr;
+      port->idxpart[EC_IDXPART_BE].first = port->rtbufnr;
+      port->idxpart[EC_IDXPART_BE].nr = port->bufnr - port->rtbufnr;
+      for (i = 0; i < EC_IDXPARTS; i++)
+      {
+         port->idxpart[i].lastidx = port->idxpart[i].first + port->idxpart[i].nr - 1;
+      }
       port->redstate          = ECT_RED_NONE;
       port->stack.sock        = &(port->sockhandle);
       port->stack.txbuf       = &(port->txbuf);
@@ -139,9 +428,83 @@ int ecx_setupnic(ecx_portt *port, const char *ifname, int secondary)
       port->stack.rxbuf       = &(port->rxbuf);
       port->stack.rxbufstat   = &(port->rxbufstat);
       port->stack.rxsa        = &(port->rxsa);
+      port->stack.rxtime      = &(port->rxtime);
+      memset(port->rxtime, 0, sizeof(port->rxtime));
+      memset(port->txtime, 0, sizeof(port->txtime));
+      port->stack.rxring      = &(port->rxring);
+      port->stack.txring      = &(port->txring);
+      port->stack.xsk         = &(port->xsk);
+      port->stack.mmsgbuf     = &(port->mmsgbuf);
+      port->stack.rxwait      = &(port->rxwait);
+      memset(port->rxwait, 0, sizeof(port->rxwait));
+      for (i = 0; i < EC_MAXBUF; i++)
+      {
+         port->rxwait[i].evfd = -1;
+      }
+      port->rxleader          = 0;
       ecx_clear_rxbufstat(&(port->rxbufstat[0]));
       psock = &(port->sockhandle);
+      rxring = &(port->rxring);
+      txring = &(port->txring);
+      ringmap = &(port->ringmap);
+      ringmapsize = &(port->ringmapsize);
+      xsk = &(port->xsk);
+   }
+   rxring->base = NULL;
+   txring->base = NULL;
+   *ringmap = NULL;
+   *ringmapsize = 0;
+   xsk->umem = NULL;
+   *psock = -1;
+   /* setup ethernet headers in tx buffers so we don't have to repeat it */
+   for (i = 0; i < EC_MAXBUF; i++)
+   {
+      ec_setupheader(&(port->txbuf[i]));
+      port->rxbufstat[i] = EC_BUF_EMPTY;
+   }
+   ec_setupheader(&(port->txbuf2));
+
+   return 1;
+}
+
+/** Connect NIC to a raw socket, the built in transport.
+ * @param[in] port        = port context struct
+ * @param[in] ifname      = Name of NIC device, f.e. "eth0"
+ * @param[in] secondary   = if >0 then use secondary stack instead of primary
+ * @return >0 if succeeded
+ */
+static int ecx_rawsetup(ecx_portt *port, const char *ifname, int secondary)
+{
+   int i;
+   int r, rval, ifindex;
+   struct timeval timeout;
+   struct ifreq ifr;
+   struct sockaddr_ll sll;
+   int *psock;
+   ec_stackT *stack;
+   ec_ringT *rxring;
+   ec_ringT *txring;
+   void **ringmap;
+   size_t *ringmapsize;
+   ec_xskT *xsk;
+
+   rval = 0;
+   if (secondary)
+   {
+      stack = &(port->redport->stack);
+      ringmap = &(port->redport->ringmap);
+      ringmapsize = &(port->redport->ringmapsize);
    }
+   else
+   {
+      stack = &(port->stack);
+      ringmap = &(port->ringmap);
+      ringmapsize = &(port->ringmapsize);
+   }
+   psock = stack->sock;
+   rxring = stack->rxring;
+   txring = stack->txring;
+   xsk = stack->xsk;
    /* we use RAW packet socket, with packet type ETH_P_ECAT */
    *psock = socket(PF_PACKET, SOCK_RAW, htons(ETH_P_ECAT));
 
@@ -167,32 +530,173 @@ int ecx_setupnic(ecx_portt *port, const char *ifname, int secondary)
    sll.sll_ifindex = ifindex;
    sll.sll_protocol = htons(ETH_P_ECAT);
    r = bind(*psock, (struct sockaddr *)&sll, sizeof(sll));
-   /* setup ethernet headers in tx buffers so we don't have to repeat it */
-   for (i = 0; i < EC_MAXBUF; i++)
+   /* optional AF_XDP socket, it replaces the packet socket if it can be set up */
+   if ((r == 0) && (port->portmode & ECT_PORTMODE_XDP))
    {
-      ec_setupheader(&(port->txbuf[i]));
-      port->rxbufstat[i] = EC_BUF_EMPTY;
+      i = ecx_xdp_setup(xsk, ifindex, (port->portmode & ECT_PORTMODE_XDPSKB));
+      if (i >= 0)
+      {
+         close(*psock);
+         *psock = i;
+         port->portmode &= ~(ECT_PORTMODE_RXRING | ECT_PORTMODE_TXRING);
+      }
+      else
+      {
+         port->portmode &= ~(ECT_PORTMODE_XDP | ECT_PORTMODE_XDPSKB);
+      }
+   }
+   /* optional packet rings, fall back to recv()/send() if the kernel refuses them */
+   if ((r == 0) && (port->portmode & (ECT_PORTMODE_RXRING | ECT_PORTMODE_TXRING)))
+   {
+      if (!ecx_setupring(*psock,
+                         (port->portmode & ECT_PORTMODE_RXRING) ? rxring : NULL,
+                         (port->portmode & ECT_PORTMODE_TXRING) ? txring : NULL,
+                         ringmap, ringmapsize))
+      {
+         port->portmode &= ~(ECT_PORTMODE_RXRING | ECT_PORTMODE_TXRING);
+      }
+   }
+   /* software timestamps, transmit timestamps only for the frames of the primary socket */
+   if ((r == 0) && (port->portmode & ECT_PORTMODE_TIMESTAMP) && !xsk->umem)
+   {
+      i = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+      if (!secondary)
+      {
+         i |= SOF_TIMESTAMPING_TX_SOFTWARE;
+      }
+      if (setsockopt(*psock, SOL_SOCKET, SO_TIMESTAMPING, &i, sizeof(i)) != 0)
+      {
+         port->portmode &= ~ECT_PORTMODE_TIMESTAMP;
+      }
+   }
+   /* low latency options for busy polling, the privileges they need are optional */
+   if ((r == 0) && (port->waitmode == ECT_WAIT_BUSYPOLL))
+   {
+      i = EC_BUSYPOLLTIME;
+      setsockopt(*psock, SOL_SOCKET, SO_BUSY_POLL, &i, sizeof(i));
+      if (!xsk->umem)
+      {
+         i = 1;
+         setsockopt(*psock, SOL_PACKET, PACKET_QDISC_BYPASS, &i, sizeof(i));
+      }
+   }
+   /* a thread sleeping in ppoll() is woken through the eventfd of its rx
+    * buffer when another thread reads and stores its frame */
+   if ((r == 0) && ((port->waitmode == ECT_WAIT_POLL) || (port->waitmode == ECT_WAIT_HYBRID)))
+   {
+      for (i = 0; i < EC_MAXBUF; i++)
+      {
+         (*stack->rxwait)[i].evfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+      }
    }
-   ec_setupheader(&(port->txbuf2));
    if (r == 0) rval = 1;
 
    return rval;
 }
 
+/** Basic setup to connect NIC to socket, or to the transport selected with
+ * ecx_portt.transport. The configuration members of ecx_portt are read here,
+ * a port that is not static has to be zeroed before they are set, zero
+ * selects the defaults of all of them.
+ * @param[in] port        = port context struct
+ * @param[in] ifname      = Name of NIC device, f.e. "eth0"
+ * @param[in] secondary   = if >0 then use secondary stack instead of primary
+ * @return >0 if succeeded
+ */
+int ecx_setupnic(ecx_portt *port, const char *ifname, int secondary)
+{
+   if (!ecx_setupport(port, secondary))
+   {
+      return 0;
+   }
+   if (port->transport && port->transport->setup)
+   {
+      return port->transport->setup(port, ifname, secondary);
+   }
+
+   return ecx_rawsetup(port, ifname, secondary);
+}
+
+/** Close the eventfds of the rx buffers of a stack.
+ * @param[in] stack       = stack of rx buffers
+ */
+static void ecx_closeevfd(ec_stackT *stack)
+{
+   int i;
+
+   for (i = 0; i < EC_MAXBUF; i++)
+   {
+      if ((*stack->rxwait)[i].evfd >= 0)
+      {
+         close((*stack->rxwait)[i].evfd);
+         (*stack->rxwait)[i].evfd = -1;
+      }
+   }
+}
+
 /** Close sockets used
  * @param[in] port        = port context struct
  * @return 0
  */
-int ecx_closenic(ecx_portt *port)
+static int ecx_rawclose(ecx_portt *port)
 {
+   ecx_closeevfd(&(port->stack));
+   if (port->redport)
+   {
+      ecx_closeevfd(&(port->redport->stack));
+   }
+   if (port->xsk.umem)
+   {
+      ecx_xdp_close(&(port->xsk));
+   }
+   if ((port->redport) && (port->redport->xsk.umem))
+   {
+      ecx_xdp_close(&(port->redport->xsk));
+   }
+   if (port->ringmap)
+   {
+      if (port->txring.base)
+      {
+         pthread_mutex_destroy(&(port->txring.mutex));
+      }
+      munmap(port->ringmap, port->ringmapsize);
+      port->ringmap = NULL;
+      port->rxring.base = NULL;
+      port->txring.base = NULL;
+   }
    if (port->sockhandle >= 0)
       close(port->sockhandle);
+   if ((port->redport) && (port->redport->ringmap))
+   {
+      if (port->redport->txring.base)
+      {
+         pthread_mutex_destroy(&(port->redport->txring.mutex));
+      }
+      munmap(port->redport->ringmap, port->redport->ringmapsize);
+      port->redport->ringmap = NULL;
+      port->redport->rxring.base = NULL;
+      port->redport->txring.base = NULL;
+   }
    if ((port->redport) && (port->redport->sockhandle >= 0))
       close(port->redport->sockhandle);
 
    return 0;
 }
 
+/** Close the sockets or the transport of the port.
+ * @param[in] port        = port context struct
+ * @return 0
+ */
+int ecx_closenic(ecx_portt *port)
+{
+   if (port->transport && port->transport->close)
+   {
+      return port->transport->close(port);
+   }
+
+   return ecx_rawclose(port);
+}
+
 /** Fill buffer with ethernet header structure.
  * Destination MAC is always broadcast.
  * Ethertype is always ETH_P_ECAT.
@@ -211,78 +715,489 @@ void ec_setupheader(void *p)
    bp->etype = htons(ETH_P_ECAT);
 }
 
-/** Get new frame identifier index and allocate corresponding rx buffer.
+/** Claim the first free index in [lo, hi] of the index bitmap.
  * @param[in] port        = port context struct
- * @return new index.
+ * @param[in] lo          = first index to search
+ * @param[in] hi          = last index to search
+ * @return claimed index or -1 if none is free.
  */
-uint8 ecx_getindex(ecx_portt *port)
+static int ecx_claimindex(ecx_portt *port, int lo, int hi)
 {
-   uint8 idx;
-   uint8 cnt;
+   int w, bit;
+   uint64 word, mask;
+
+   for (w = lo / 64; w <= hi / 64; w++)
+   {
+      mask = ~(uint64)0;
+      if (w == lo / 64)
+      {
+         mask &= ~(uint64)0 << (lo % 64);
+      }
+      if ((w == hi / 64) && ((hi % 64) != 63))
+      {
+         mask &= ((uint64)1 << ((hi % 64) + 1)) - 1;
+      }
+      word = __atomic_load_n(&(port->idxfree[w]), __ATOMIC_ACQUIRE);
+      while (word & mask)
+      {
+         bit = __builtin_ctzll(word & mask);
+         /* on failure word is reloaded and the search repeated */
+         if (__atomic_compare_exchange_n(&(port->idxfree[w]), &word, word & ~((uint64)1 << bit),
+                                         FALSE, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+         {
+            return (w * 64) + bit;
+         }
+      }
+   }
+
+   return -1;
+}
 
-   pthread_mutex_lock( &(port->getindex_mutex) );
+/** Get new frame identifier index from a partition of the index pool and
+ * allocate corresponding rx buffer. Lock free, free indexes are kept in a
+ * bitmap and claimed with a CAS. The search starts after the last used index
+ * of the partition so recently released indexes are not reused at once, late
+ * frames of a timed out index then find it unused.
+ * @param[in] port        = port context struct
+ * @param[in] part        = index partition, see ec_idxpart. Without reserved
+ * indexes EC_IDXPART_RT shares the pool of EC_IDXPART_BE.
+ * @return new index or -1 if all indexes of the partition are in use.
+ */
+int ecx_getindex_part(ecx_portt *port, int part)
+{
+   int idx, start, first, last, inuse, maxinuse;
+   ec_idxpartT *idxpart;
 
-   idx = port->lastidx + 1;
-   /* index can't be larger than buffer array */
-   if (idx >= EC_MAXBUF)
+   if ((part != EC_IDXPART_RT) || (port->idxpart[EC_IDXPART_RT].nr == 0))
    {
-      idx = 0;
+      part = EC_IDXPART_BE;
    }
-   cnt = 0;
-   /* try to find unused index */
-   while ((port->rxbufstat[idx] != EC_BUF_EMPTY) && (cnt < EC_MAXBUF))
+   idxpart = &(port->idxpart[part]);
+   first = idxpart->first;
+   last = first + idxpart->nr - 1;
+   start = __atomic_load_n(&(idxpart->lastidx), __ATOMIC_RELAXED) + 1;
+   if (start > last)
    {
-      idx++;
-      cnt++;
-      if (idx >= EC_MAXBUF)
-      {
-         idx = 0;
-      }
+      start = first;
+   }
+   idx = ecx_claimindex(port, start, last);
+   if ((idx < 0) && (start > first))
+   {
+      idx = ecx_claimindex(port, first, start - 1);
+   }
+   if (idx < 0)
+   {
+      __atomic_add_fetch(&(idxpart->exhausted), 1, __ATOMIC_RELAXED);
+      __atomic_add_fetch(&(port->idxexhausted), 1, __ATOMIC_RELAXED);
+      return -1;
    }
    port->rxbufstat[idx] = EC_BUF_ALLOC;
    if (port->redstate != ECT_RED_NONE)
       port->redport->rxbufstat[idx] = EC_BUF_ALLOC;
-   port->lastidx = idx;
-
-   pthread_mutex_unlock( &(port->getindex_mutex) );
+   __atomic_store_n(&(idxpart->lastidx), idx, __ATOMIC_RELAXED);
+   inuse = __atomic_add_fetch(&(idxpart->inuse), 1, __ATOMIC_RELAXED);
+   maxinuse = __atomic_load_n(&(idxpart->maxinuse), __ATOMIC_RELAXED);
+   while ((inuse > maxinuse) &&
+          !__atomic_compare_exchange_n(&(idxpart->maxinuse), &maxinuse, inuse,
+                                       FALSE, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
 
    return idx;
 }
 
-/** Set rx buffer status.
+/** Get new frame identifier index from the best effort partition of the
+ * index pool and allocate corresponding rx buffer.
+ * @param[in] port        = port context struct
+ * @return new index or -1 if all indexes are in use.
+ */
+int ecx_getindex(ecx_portt *port)
+{
+   return ecx_getindex_part(port, EC_IDXPART_BE);
+}
+
+/** Set rx buffer status. Setting EC_BUF_EMPTY returns the index to its
+ * partition of the pool.
  * @param[in] port        = port context struct
  * @param[in] idx      = index in buffer array
  * @param[in] bufstat  = status to set
  */
 void ecx_setbufstat(ecx_portt *port, uint8 idx, int bufstat)
 {
+   uint64 bit, word;
+   int part;
+
    port->rxbufstat[idx] = bufstat;
    if (port->redstate != ECT_RED_NONE)
       port->redport->rxbufstat[idx] = bufstat;
+   if ((bufstat == EC_BUF_EMPTY) && (idx < port->bufnr))
+   {
+      bit = (uint64)1 << (idx % 64);
+      word = __atomic_fetch_or(&(port->idxfree[idx / 64]), bit, __ATOMIC_RELEASE);
+      /* only count indexes that were allocated */
+      if (!(word & bit))
+      {
+         part = (idx < port->rtbufnr) ? EC_IDXPART_RT : EC_IDXPART_BE;
+         __atomic_sub_fetch(&(port->idxpart[part].inuse), 1, __ATOMIC_RELAXED);
+      }
+   }
 }
 
-/** Transmit buffer over socket (non blocking).
+/** Get the software timestamps of the last frame of an index. Call it before
+ * the index is released. Requires ECT_PORTMODE_TIMESTAMP, in redundant mode
+ * the receive time of the secondary socket is used if the primary socket got
+ * no frame.
  * @param[in] port        = port context struct
- * @param[in] idx         = index in tx buffer array
- * @param[in] stacknumber  = 0=Primary 1=Secondary stack
- * @return socket send result
+ * @param[in] idx         = index in buffer array
+ * @param[out] frametime  = timestamps of frame, 0 if not available
  */
-int ecx_outframe(ecx_portt *port, uint8 idx, int stacknumber)
+void ecx_getframetime(ecx_portt *port, uint8 idx, ec_frametimet *frametime)
 {
-   int lp, rval;
-   ec_stackT *stack;
-
-   if (!stacknumber)
+   ecx_txtsdrain(port);
+   frametime->tx = port->txtime[idx];
+   frametime->rx = port->rxtime[idx];
+   if ((frametime->rx == 0) && (port->redstate != ECT_RED_NONE))
    {
-      stack = &(port->stack);
+      frametime->rx = port->redport->rxtime[idx];
    }
-   else
-   {
+}
+
+/** Snapshot of the traffic counters of a port. The counters are updated lock
+ * free by all threads using the port, every counter is read atomically but
+ * the snapshot is not taken at one instant. Take two snapshots and subtract
+ * them for the traffic in between, the counters wrap around at 2^32.
+ * @param[in]  port        = port context struct
+ * @param[out] stats       = traffic counters
+ */
+void ecx_getportstats(ecx_portt *port, ec_portstatT *stats)
+{
+   stats->txframes = __atomic_load_n(&(port->txframes), __ATOMIC_RELAXED);
+   stats->redtxframes = __atomic_load_n(&(port->redtxframes), __ATOMIC_RELAXED);
+   stats->rxframes = __atomic_load_n(&(port->rxframes), __ATOMIC_RELAXED);
+   stats->foreign = __atomic_load_n(&(port->foreign), __ATOMIC_RELAXED);
+   stats->stale = __atomic_load_n(&(port->stale), __ATOMIC_RELAXED);
+   stats->timeouts = __atomic_load_n(&(port->timeouts), __ATOMIC_RELAXED);
+   stats->retries = __atomic_load_n(&(port->retries), __ATOMIC_RELAXED);
+   stats->redrepairs = __atomic_load_n(&(port->redrepairs), __ATOMIC_RELAXED);
+   stats->idxexhausted = __atomic_load_n(&(port->idxexhausted), __ATOMIC_RELAXED);
+}
+
+#ifdef EC_TRACE
+/** Write a record to the trace ring of a port. Each writer claims its own
+ * slot, the oldest records are overwritten.
+ * @param[in] port        = port context struct
+ * @param[in] trace       = record to write, seq and time are filled in
+ */
+static void ecx_tracewrite(ecx_portt *port, ec_tracerect *trace)
+{
+   ec_tracerect *rec;
+   struct timespec ts;
+   uint32 pos;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   trace->time = ((int64)ts.tv_sec * 1000000000) + ts.tv_nsec;
+   pos = __atomic_fetch_add(&(port->tracehead), 1, __ATOMIC_RELAXED);
+   rec = &(port->trace[pos & (EC_TRACESIZE - 1)]);
+   /* mark the slot as being written before touching the fields */
+   __atomic_store_n(&(rec->seq), 0, __ATOMIC_RELAXED);
+   __atomic_thread_fence(__ATOMIC_RELEASE);
+   rec->time = trace->time;
+   rec->type = trace->type;
+   rec->idx = trace->idx;
+   rec->cmd = trace->cmd;
+   rec->stack = trace->stack;
+   rec->adp = trace->adp;
+   rec->ado = trace->ado;
+   rec->length = trace->length;
+   rec->wkc = trace->wkc;
+   rec->datagrams = trace->datagrams;
+   rec->reserved = 0;
+   __atomic_store_n(&(rec->seq), pos + 1, __ATOMIC_RELEASE);
+}
+
+/** Write a record to the trace ring of a port. Safe to call from any thread.
+ * The fields are stored as given, see the EC_TRACE_xxx types for their use.
+ * @param[in] port        = port context struct
+ * @param[in] type        = record type, EC_TRACE_xxx
+ * @param[in] idx         = frame index
+ * @param[in] cmd         = EtherCAT command
+ * @param[in] adp         = ADP
+ * @param[in] ado         = ADO
+ * @param[in] length      = length in bytes
+ * @param[in] wkc         = workcounter
+ */
+void ecx_trace(ecx_portt *port, uint8 type, uint8 idx, uint8 cmd, uint16 adp, uint16 ado,
+               uint16 length, uint16 wkc)
+{
+   ec_tracerect trace;
+
+   memset(&trace, 0, sizeof(trace));
+   trace.type = type;
+   trace.idx = idx;
+   trace.cmd = cmd;
+   trace.adp = adp;
+   trace.ado = ado;
+   trace.length = length;
+   trace.wkc = wkc;
+   ecx_tracewrite(port, &trace);
+}
+
+/** Write a frame record to the trace ring with the fields of the first
+ * datagram of the frame.
+ * @param[in] port        = port context struct
+ * @param[in] type        = EC_TRACE_TX or EC_TRACE_RX
+ * @param[in] idx         = frame index
+ * @param[in] stacknumber = 0=Primary 1=Secondary stack
+ * @param[in] frame       = EtherCAT frame, without Ethernet header
+ * @param[in] wkc         = workcounter
+ */
+static void ecx_traceframe(ecx_portt *port, uint8 type, uint8 idx, int stacknumber,
+                           const uint8 *frame, int wkc)
+{
+   ec_tracerect trace;
+   const ec_comt *datagramP;
+   uint16 dlength;
+   int pos;
+
+   datagramP = (const ec_comt *)frame;
+   memset(&trace, 0, sizeof(trace));
+   trace.type = type;
+   trace.idx = idx;
+   trace.cmd = datagramP->command;
+   trace.stack = (uint8)stacknumber;
+   trace.adp = etohs(datagramP->ADP);
+   trace.ado = etohs(datagramP->ADO);
+   trace.length = etohs(datagramP->elength) & 0x07ff;
+   trace.wkc = (uint16)wkc;
+   /* count the datagrams, the frame length excludes the elength word */
+   pos = 0;
+   do
+   {
+      dlength = etohs(((const ec_comt *)(frame + pos))->dlength);
+      pos += EC_HEADERSIZE - EC_ELENGTHSIZE + (dlength & 0x07ff) + EC_WKCSIZE;
+      trace.datagrams++;
+   } while ((dlength & EC_DATAGRAMFOLLOWS) &&
+            (pos + (int)EC_HEADERSIZE - EC_ELENGTHSIZE <= trace.length));
+   ecx_tracewrite(port, &trace);
+}
+
+/** Copy the trace ring of a port, oldest record first. Records that are
+ * overwritten or still being written while copying are left out.
+ * @param[in]  port        = port context struct
+ * @param[out] rec         = array receiving the records
+ * @param[in]  max         = size of rec, EC_TRACESIZE for the whole ring
+ * @return number of records copied
+ */
+int ecx_trace_snapshot(ecx_portt *port, ec_tracerect *rec, int max)
+{
+   uint32 head, pos;
+   ec_tracerect *slot;
+   int n;
+
+   head = __atomic_load_n(&(port->tracehead), __ATOMIC_ACQUIRE);
+   if (max > EC_TRACESIZE)
+   {
+      max = EC_TRACESIZE;
+   }
+   pos = (head > (uint32)max) ? head - max : 0;
+   n = 0;
+   for (; pos != head; pos++)
+   {
+      slot = &(port->trace[pos & (EC_TRACESIZE - 1)]);
+      if (__atomic_load_n(&(slot->seq), __ATOMIC_ACQUIRE) != pos + 1)
+      {
+         continue;
+      }
+      rec[n] = *slot;
+      /* keep the record only if nobody started to overwrite it meanwhile */
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      if (__atomic_load_n(&(slot->seq), __ATOMIC_RELAXED) == pos + 1)
+      {
+         rec[n].seq = pos + 1;
+         n++;
+      }
+   }
+
+   return n;
+}
+
+/** Save the trace ring of a port to a binary file, a ec_traceheadert
+ * followed by the records. Decode it with the tracetool example. The records
+ * are copied to a heap buffer, so the function is reentrant.
+ * @param[in] port        = port context struct
+ * @param[in] filename    = file to write
+ * @return number of records saved, -1 on error
+ */
+int ecx_trace_save(ecx_portt *port, const char *filename)
+{
+   ec_tracerect *rec;
+   ec_traceheadert header;
+   FILE *fp;
+   int n, rval;
+
+   rec = malloc(EC_TRACESIZE * sizeof(ec_tracerect));
+   if (rec == NULL)
+   {
+      return -1;
+   }
+   fp = fopen(filename, "wb");
+   if (fp == NULL)
+   {
+      free(rec);
+      return -1;
+   }
+   n = ecx_trace_snapshot(port, rec, EC_TRACESIZE);
+   header.magic = EC_TRACEMAGIC;
+   header.version = EC_TRACEVERSION;
+   header.recsize = sizeof(ec_tracerect);
+   header.count = n;
+   rval = n;
+   if ((fwrite(&header, sizeof(header), 1, fp) != 1) ||
+       (fwrite(rec, sizeof(ec_tracerect), n, fp) != (size_t)n))
+   {
+      rval = -1;
+   }
+   if (fclose(fp) != 0)
+   {
+      rval = -1;
+   }
+   free(rec);
+
+   return rval;
+}
+#endif
+
+/** Forget the transmit timestamp of an index before its frame is sent again.
+ * AF_XDP has no kernel timestamps, the time is taken here instead.
+ * @param[in] port        = port context struct
+ * @param[in] idx         = index in tx buffer array
+ */
+static void ecx_txstamp(ecx_portt *port, uint8 idx)
+{
+   if (port->portmode & ECT_PORTMODE_TIMESTAMP)
+   {
+      port->txtime[idx] = port->xsk.umem ? ecx_realtime() : 0;
+   }
+}
+
+/** Receive timestamp of a frame read from the AF_XDP socket, taken in user
+ * space as there is no kernel timestamp.
+ * @param[in] port        = port context struct
+ * @return time in ns since 1970-01-01, 0 if not enabled
+ */
+static int64 ecx_xdptime(ecx_portt *port)
+{
+   return (port->portmode & ECT_PORTMODE_TIMESTAMP) ? ecx_realtime() : 0;
+}
+
+/** Hand a frame to the transmit path of a stack. Without a transmit ring
+ * this is a plain send(). With a transmit ring or AF_XDP socket the frame is
+ * copied into the next free slot and the kernel is only kicked if requested,
+ * so several frames can be queued and transmitted with one syscall.
+ * @param[in] stack       = stack of socket
+ * @param[in] buf         = frame to transmit
+ * @param[in] len         = length of frame
+ * @param[in] kick        = TRUE to start transmission of queued frames
+ * @return socket send result
+ */
+static int ecx_txpkt(ec_stackT *stack, const void *buf, int len, boolean kick)
+{
+   struct tpacket2_hdr *hdr;
+   uint32 slot;
+   int sock, rval;
+   ec_ringT *txring;
+
+   sock = *stack->sock;
+   txring = stack->txring;
+   if (stack->xsk->umem)
+   {
+      return ecx_xdp_send(stack->xsk, sock, buf, len, kick);
+   }
+   if (!txring->base)
+   {
+      return send(sock, buf, len, 0);
+   }
+   /* the kernel stops at the first slot that is not ready, so a slot must
+    * not be reserved by one sender while another fills an earlier one */
+   rval = -1;
+   pthread_mutex_lock(&(txring->mutex));
+   slot = txring->head % txring->framenr;
+   hdr = (struct tpacket2_hdr *)(txring->base + (slot * txring->framesize));
+   if (__atomic_load_n(&(hdr->tp_status), __ATOMIC_ACQUIRE) != TP_STATUS_AVAILABLE)
+   {
+      /* ring is full, let the kernel drain it and try once more */
+      send(sock, NULL, 0, MSG_DONTWAIT);
+   }
+   if (__atomic_load_n(&(hdr->tp_status), __ATOMIC_ACQUIRE) == TP_STATUS_AVAILABLE)
+   {
+      memcpy((uint8 *)hdr + TPACKET2_HDRLEN - sizeof(struct sockaddr_ll), buf, len);
+      hdr->tp_len = len;
+      __atomic_store_n(&(hdr->tp_status), TP_STATUS_SEND_REQUEST, __ATOMIC_RELEASE);
+      txring->head++;
+      rval = len;
+   }
+   pthread_mutex_unlock(&(txring->mutex));
+   /* kick after the unlock, all earlier slots are ready by now */
+   if (kick && (rval > 0) && (send(sock, NULL, 0, MSG_DONTWAIT) == -1))
+   {
+      return -1;
+   }
+
+   return rval;
+}
+
+/** Start transmission of all frames queued in the transmit ring of a stack.
+ * @param[in] stack       = stack of socket
+ */
+static void ecx_txkickstack(ec_stackT *stack)
+{
+   if (stack->xsk->umem)
+   {
+      ecx_xdp_kick(stack->xsk, *stack->sock);
+   }
+   else if (stack->txring->base)
+   {
+      send(*stack->sock, NULL, 0, MSG_DONTWAIT);
+   }
+}
+
+/** Start transmission of all frames queued in the transmit rings.
+ * @param[in] port        = port context struct
+ */
+static void ecx_txkick(ecx_portt *port)
+{
+   ecx_txkickstack(&(port->stack));
+   if (port->redstate != ECT_RED_NONE)
+   {
+      ecx_txkickstack(&(port->redport->stack));
+   }
+}
+
+/** Transmit buffer over socket, optionally only queue it in the transmit ring.
+ * @param[in] port        = port context struct
+ * @param[in] idx         = index in tx buffer array
+ * @param[in] stacknumber = 0=Primary 1=Secondary stack
+ * @param[in] kick        = FALSE to leave frame queued until ecx_txkick()
+ * @return socket send result
+ */
+static int ecx_txframe(ecx_portt *port, uint8 idx, int stacknumber, boolean kick)
+{
+   int lp, rval;
+   ec_stackT *stack;
+
+   if (!stacknumber)
+   {
+      stack = &(port->stack);
+   }
+   else
+   {
       stack = &(port->redport->stack);
    }
    lp = (*stack->txbuflength)[idx];
+   if (!stacknumber)
+   {
+      ecx_txstamp(port, idx);
+   }
    (*stack->rxbufstat)[idx] = EC_BUF_TX;
-   rval = send(*stack->sock, (*stack->txbuf)[idx], lp, 0);
+   rval = ecx_txpkt(stack, (*stack->txbuf)[idx], lp, kick);
    if (rval == -1)
    {
       (*stack->rxbufstat)[idx] = EC_BUF_EMPTY;
@@ -293,51 +1208,462 @@ int ecx_outframe(ecx_portt *port, uint8 idx, int stacknumber)
 
 /** Transmit buffer over socket (non blocking).
  * @param[in] port        = port context struct
- * @param[in] idx = index in tx buffer array
+ * @param[in] idx         = index in tx buffer array
+ * @param[in] stacknumber  = 0=Primary 1=Secondary stack
  * @return socket send result
  */
-int ecx_outframe_red(ecx_portt *port, uint8 idx)
+static int ecx_rawoutframe(ecx_portt *port, uint8 idx, int stacknumber)
+{
+   return ecx_txframe(port, idx, stacknumber, TRUE);
+}
+
+/** Transmit buffer over the transport of the port, with the built in
+ * transport optionally only queue it in the transmit ring.
+ * @param[in] port        = port context struct
+ * @param[in] idx         = index in tx buffer array
+ * @param[in] stacknumber = 0=Primary 1=Secondary stack
+ * @param[in] kick        = FALSE to leave frame queued until ecx_txkick()
+ * @return send result
+ */
+static int ecx_outframe_kick(ecx_portt *port, uint8 idx, int stacknumber, boolean kick)
+{
+   if (!stacknumber)
+   {
+      __atomic_add_fetch(&(port->txframes), 1, __ATOMIC_RELAXED);
+   }
+   else
+   {
+      __atomic_add_fetch(&(port->redtxframes), 1, __ATOMIC_RELAXED);
+   }
+#ifdef EC_TRACE
+   ecx_traceframe(port, EC_TRACE_TX, idx, stacknumber, &(port->txbuf[idx][ETH_HEADERSIZE]), 0);
+#endif
+   if (port->transport && port->transport->outframe)
+   {
+      return port->transport->outframe(port, idx, stacknumber);
+   }
+
+   return ecx_txframe(port, idx, stacknumber, kick);
+}
+
+/** Transmit buffer over socket (non blocking).
+ * @param[in] port        = port context struct
+ * @param[in] idx         = index in tx buffer array
+ * @param[in] stacknumber  = 0=Primary 1=Secondary stack
+ * @return socket send result
+ */
+int ecx_outframe(ecx_portt *port, uint8 idx, int stacknumber)
+{
+   return ecx_outframe_kick(port, idx, stacknumber, TRUE);
+}
+
+/** Transmit the dummy frame for an index over the secondary socket.
+ * @param[in] port        = port context struct
+ * @param[in] idx         = index in tx buffer array
+ * @param[in] kick        = FALSE to leave frame queued until ecx_txkick()
+ */
+static void ecx_outframe_sec(ecx_portt *port, uint8 idx, boolean kick)
 {
    ec_comt *datagramP;
    ec_etherheadert *ehp;
+
+   pthread_mutex_lock( &(port->tx_mutex) );
+   ehp = (ec_etherheadert *)&(port->txbuf2);
+   /* use dummy frame for secondary socket transmit (BRD) */
+   datagramP = (ec_comt*)&(port->txbuf2[ETH_HEADERSIZE]);
+   /* write index to frame */
+   datagramP->index = idx;
+   /* rewrite MAC source address 1 to secondary */
+   ehp->sa1 = htons(secMAC[1]);
+   /* transmit over secondary socket */
+   port->redport->rxbufstat[idx] = EC_BUF_TX;
+   __atomic_add_fetch(&(port->redtxframes), 1, __ATOMIC_RELAXED);
+#ifdef EC_TRACE
+   ecx_traceframe(port, EC_TRACE_TX, idx, 1, &(port->txbuf2[ETH_HEADERSIZE]), 0);
+#endif
+   if (ecx_txpkt(&(port->redport->stack), &(port->txbuf2), port->txbuflength2, kick) == -1)
+   {
+      port->redport->rxbufstat[idx] = EC_BUF_EMPTY;
+   }
+   pthread_mutex_unlock( &(port->tx_mutex) );
+}
+
+/** Transmit buffer over primary socket and, in redundant mode, the dummy
+ * frame over the secondary socket.
+ * @param[in] port        = port context struct
+ * @param[in] idx         = index in tx buffer array
+ * @param[in] kick        = FALSE to leave frames queued until ecx_txkick()
+ * @return socket send result
+ */
+static int ecx_outframe_red_kick(ecx_portt *port, uint8 idx, boolean kick)
+{
+   ec_etherheadert *ehp;
    int rval;
 
-   ehp = (ec_etherheadert *)&(port->txbuf[idx]);
-   /* rewrite MAC source address 1 to primary */
-   ehp->sa1 = htons(priMAC[1]);
-   /* transmit over primary socket*/
-   rval = ecx_outframe(port, idx, 0);
-   if (port->redstate != ECT_RED_NONE)
+   ehp = (ec_etherheadert *)&(port->txbuf[idx]);
+   /* rewrite MAC source address 1 to primary */
+   ehp->sa1 = htons(priMAC[1]);
+   /* transmit over primary socket*/
+   rval = ecx_outframe_kick(port, idx, 0, kick);
+   if (port->redstate != ECT_RED_NONE)
+   {
+      ecx_outframe_sec(port, idx, kick);
+   }
+
+   return rval;
+}
+
+/** Transmit buffer over socket (non blocking).
+ * @param[in] port        = port context struct
+ * @param[in] idx = index in tx buffer array
+ * @return socket send result
+ */
+int ecx_outframe_red(ecx_portt *port, uint8 idx)
+{
+   return ecx_outframe_red_kick(port, idx, TRUE);
+}
+
+/** Transmit a batch of buffers over the primary socket with one sendmmsg().
+ * In redundant mode the dummy frames follow over the secondary socket.
+ * @param[in] port        = port context struct
+ * @param[in] idx         = array of indexes in tx buffer array
+ * @param[in] n           = number of indexes, max EC_MAXBUF
+ * @return number of frames transmitted
+ */
+static int ecx_outframe_red_mmsg(ecx_portt *port, const uint8 *idx, int n)
+{
+   struct mmsghdr msg[EC_MAXBUF];
+   struct iovec iov[EC_MAXBUF];
+   ec_etherheadert *ehp;
+   int i, cnt;
+
+   memset(msg, 0, n * sizeof(msg[0]));
+   for (i = 0; i < n; i++)
+   {
+      ehp = (ec_etherheadert *)&(port->txbuf[idx[i]]);
+      /* rewrite MAC source address 1 to primary */
+      ehp->sa1 = htons(priMAC[1]);
+      ecx_txstamp(port, idx[i]);
+      port->rxbufstat[idx[i]] = EC_BUF_TX;
+      iov[i].iov_base = &(port->txbuf[idx[i]]);
+      iov[i].iov_len = port->txbuflength[idx[i]];
+      msg[i].msg_hdr.msg_iov = &iov[i];
+      msg[i].msg_hdr.msg_iovlen = 1;
+   }
+   cnt = sendmmsg(port->sockhandle, msg, n, 0);
+   if (cnt < 0)
+   {
+      cnt = 0;
+   }
+   __atomic_add_fetch(&(port->txframes), cnt, __ATOMIC_RELAXED);
+#ifdef EC_TRACE
+   for (i = 0; i < cnt; i++)
+   {
+      ecx_traceframe(port, EC_TRACE_TX, idx[i], 0, &(port->txbuf[idx[i]][ETH_HEADERSIZE]), 0);
+   }
+#endif
+   /* frames the kernel did not take are not in flight */
+   for (i = cnt; i < n; i++)
+   {
+      port->rxbufstat[idx[i]] = EC_BUF_EMPTY;
+   }
+   if (port->redstate != ECT_RED_NONE)
+   {
+      for (i = 0; i < n; i++)
+      {
+         ecx_outframe_sec(port, idx[i], TRUE);
+      }
+   }
+
+   return cnt;
+}
+
+/** Transmit a batch of buffers over socket (non blocking). With transmit
+ * rings all frames are queued first and then handed to the kernel with a
+ * single syscall per socket. With ECT_PORTMODE_MMSG they are sent with one
+ * sendmmsg(), otherwise they are sent one by one.
+ * @param[in] port        = port context struct
+ * @param[in] idx         = array of indexes in tx buffer array
+ * @param[in] n           = number of indexes
+ * @return number of frames transmitted
+ */
+int ecx_outframe_red_batch(ecx_portt *port, const uint8 *idx, int n)
+{
+   int i, cnt;
+
+   if ((port->portmode & ECT_PORTMODE_MMSG) && (n <= EC_MAXBUF) &&
+       !port->txring.base && !port->xsk.umem &&
+       !(port->transport && port->transport->outframe))
+   {
+      return ecx_outframe_red_mmsg(port, idx, n);
+   }
+   cnt = 0;
+   for (i = 0; i < n; i++)
+   {
+      if (ecx_outframe_red_kick(port, idx[i], FALSE) != -1)
+      {
+         cnt++;
+      }
+   }
+   ecx_txkick(port);
+
+   return cnt;
+}
+
+/** Non blocking read of socket. Put frame in temporary buffer.
+ * @param[in] port        = port context struct
+ * @param[in] stacknumber = 0=primary 1=secondary stack
+ * @param[out] rxtime     = receive timestamp, 0 if not available
+ * @return >0 if frame is available and read
+ */
+static int ecx_recvpkt(ecx_portt *port, int stacknumber, int64 *rxtime)
+{
+   int lp, bytesrx;
+   ec_stackT *stack;
+
+   if (!stacknumber)
+   {
+      stack = &(port->stack);
+   }
+   else
+   {
+      stack = &(port->redport->stack);
+   }
+   lp = sizeof(port->tempinbuf);
+   bytesrx = ecx_recvts(*stack->sock, (*stack->tempbuf), lp, 0, rxtime);
+   port->tempinbufs = bytesrx;
+
+   return (bytesrx > 0);
+}
+
+/** Non blocking read of all available frames of a socket with one
+ * recvmmsg(). Frames are put in the recvmmsg() buffers of the stack.
+ * @param[in] port        = port context struct
+ * @param[in] stacknumber = 0=primary 1=secondary stack
+ * @param[out] rxtime     = receive timestamps of the frames, 0 if not available
+ * @return number of frames read
+ */
+static int ecx_recvmpkt(ecx_portt *port, int stacknumber, int64 *rxtime)
+{
+   struct mmsghdr msg[EC_MMSGFRAMES];
+   struct iovec iov[EC_MMSGFRAMES];
+   uint8 cbuf[EC_MMSGFRAMES][EC_CMSGSIZE];
+   ec_stackT *stack;
+   int i, n;
+
+   if (!stacknumber)
+   {
+      stack = &(port->stack);
+   }
+   else
+   {
+      stack = &(port->redport->stack);
+   }
+   memset(msg, 0, sizeof(msg));
+   for (i = 0; i < EC_MMSGFRAMES; i++)
+   {
+      iov[i].iov_base = &(*stack->mmsgbuf)[i];
+      iov[i].iov_len = sizeof(ec_bufT);
+      msg[i].msg_hdr.msg_iov = &iov[i];
+      msg[i].msg_hdr.msg_iovlen = 1;
+      msg[i].msg_hdr.msg_control = cbuf[i];
+      msg[i].msg_hdr.msg_controllen = sizeof(cbuf[i]);
+   }
+   n = recvmmsg(*stack->sock, msg, EC_MMSGFRAMES, MSG_DONTWAIT, NULL);
+   for (i = 0; i < n; i++)
+   {
+      rxtime[i] = ecx_cmsgtime(&(msg[i].msg_hdr));
+   }
+
+   return (n > 0) ? n : 0;
+}
+
+/** Receive timestamp of a frame in a ring slot.
+ * @param[in] hdr         = ring slot
+ * @return time in ns since 1970-01-01
+ */
+static int64 ecx_ringtime(struct tpacket2_hdr *hdr)
+{
+   return ((int64)hdr->tp_sec * 1000000000) + hdr->tp_nsec;
+}
+
+/** Non blocking read of receive ring. The frame is left in the ring slot
+ * until it is released with ecx_ringrelease().
+ * @param[in] ring        = receive ring
+ * @param[out] rxtime     = receive timestamp of frame
+ * @return pointer to received frame or NULL if ring is empty
+ */
+static uint8 *ecx_ringpeek(ec_ringT *ring, int64 *rxtime)
+{
+   struct tpacket2_hdr *hdr;
+
+   hdr = (struct tpacket2_hdr *)(ring->base + ((ring->head % ring->framenr) * ring->framesize));
+   if (!(__atomic_load_n(&(hdr->tp_status), __ATOMIC_ACQUIRE) & TP_STATUS_USER))
+   {
+      return NULL;
+   }
+   *rxtime = ecx_ringtime(hdr);
+
+   return (uint8 *)hdr + hdr->tp_mac;
+}
+
+/** Hand the frame slot at the head of the receive ring back to the kernel.
+ * @param[in] ring        = receive ring
+ */
+static void ecx_ringrelease(ec_ringT *ring)
+{
+   struct tpacket2_hdr *hdr;
+
+   hdr = (struct tpacket2_hdr *)(ring->base + ((ring->head % ring->framenr) * ring->framesize));
+   __atomic_store_n(&(hdr->tp_status), TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+   ring->head++;
+}
+
+/** Wake the threads sleeping on an rx buffer, on its futex in
+ * ECT_PORTMODE_DISPATCH or in ppoll() on its eventfd.
+ * @param[in] stack       = stack of rx buffer
+ * @param[in] idx         = index of rx buffer
+ */
+static void ecx_rxwake(ec_stackT *stack, uint8 idx)
+{
+   ec_rxwaitT *rxwait;
+
+   rxwait = &(*stack->rxwait)[idx];
+   __atomic_add_fetch(&(rxwait->seq), 1, __ATOMIC_SEQ_CST);
+   if (__atomic_load_n(&(rxwait->waiters), __ATOMIC_SEQ_CST) > 0)
+   {
+      syscall(SYS_futex, &(rxwait->seq), FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+   }
+   if ((__atomic_load_n(&(rxwait->pollers), __ATOMIC_SEQ_CST) > 0) && (rxwait->evfd >= 0))
+   {
+      eventfd_write(rxwait->evfd, 1);
+   }
+}
+
+/** Claim the frame slot at the head of the receive ring. Several threads can
+ * claim slots at the same time, each slot is claimed only once.
+ * @param[in] ring        = receive ring
+ * @return claimed slot or NULL if ring is empty
+ */
+static struct tpacket2_hdr *ecx_ringclaim(ec_ringT *ring)
+{
+   struct tpacket2_hdr *hdr;
+   uint32 head;
+
+   head = __atomic_load_n(&(ring->head), __ATOMIC_ACQUIRE);
+   do
+   {
+      hdr = (struct tpacket2_hdr *)(ring->base + ((head % ring->framenr) * ring->framesize));
+      if (!(__atomic_load_n(&(hdr->tp_status), __ATOMIC_ACQUIRE) & TP_STATUS_USER))
+      {
+         return NULL;
+      }
+   } while (!__atomic_compare_exchange_n(&(ring->head), &head, head + 1, FALSE,
+                                         __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+   return hdr;
+}
+
+/** Store a received frame in the rx buffer of its index.
+ * @param[in] port        = port context struct
+ * @param[in] stack       = stack the frame was received on
+ * @param[in] idx         = requested index of frame
+ * @param[in] frame       = received frame including ethernet header
+ * @param[in] rxtime      = receive timestamp of frame, 0 if not available
+ * @return Workcounter if the frame has the requested index, otherwise
+ * EC_OTHERFRAME.
+ */
+static int ecx_rxframe(ecx_portt *port, ec_stackT *stack, uint8 idx, uint8 *frame, int64 rxtime)
+{
+   uint16  l;
+   int     rval, bufstat;
+   uint8   idxf;
+   ec_etherheadert *ehp;
+   ec_comt *ecp;
+   ec_bufT *rxbuf;
+
+   rval = EC_OTHERFRAME;
+   ehp =(ec_etherheadert*)(frame);
+   /* check if it is an EtherCAT frame */
+   if (ehp->etype == htons(ETH_P_ECAT))
    {
-      pthread_mutex_lock( &(port->tx_mutex) );
-      ehp = (ec_etherheadert *)&(port->txbuf2);
-      /* use dummy frame for secondary socket transmit (BRD) */
-      datagramP = (ec_comt*)&(port->txbuf2[ETH_HEADERSIZE]);
-      /* write index to frame */
-      datagramP->index = idx;
-      /* rewrite MAC source address 1 to secondary */
-      ehp->sa1 = htons(secMAC[1]);
-      /* transmit over secondary socket */
-      port->redport->rxbufstat[idx] = EC_BUF_TX;
-      if (send(port->redport->sockhandle, &(port->txbuf2), port->txbuflength2 , 0) == -1)
+      ecp =(ec_comt*)(&frame[ETH_HEADERSIZE]);
+      l = etohs(ecp->elength) & 0x0fff;
+      idxf = ecp->index;
+      /* found index equals requested index ? */
+      if (idxf == idx)
+      {
+         rxbuf = &(*stack->rxbuf)[idx];
+         /* yes, put it in the buffer array (strip ethernet header) */
+         memcpy(rxbuf, &frame[ETH_HEADERSIZE], (*stack->txbuflength)[idx] - ETH_HEADERSIZE);
+         /* return WKC */
+         rval = ((*rxbuf)[l] + ((uint16)((*rxbuf)[l + 1]) << 8));
+         /* mark as completed */
+         (*stack->rxbufstat)[idx] = EC_BUF_COMPLETE;
+         /* store MAC source word 1 for redundant routing info */
+         (*stack->rxsa)[idx] = ntohs(ehp->sa1);
+         (*stack->rxtime)[idx] = rxtime;
+      }
+      else
       {
-         port->redport->rxbufstat[idx] = EC_BUF_EMPTY;
+         /* check if index exist and someone is waiting for it */
+         if ((idxf < port->bufnr) &&
+             __atomic_load_n(&(*stack->rxbufstat)[idxf], __ATOMIC_ACQUIRE) == EC_BUF_TX)
+         {
+            rxbuf = &(*stack->rxbuf)[idxf];
+            /* put it in the buffer array (strip ethernet header) */
+            memcpy(rxbuf, &frame[ETH_HEADERSIZE], (*stack->txbuflength)[idxf] - ETH_HEADERSIZE);
+            (*stack->rxsa)[idxf] = ntohs(ehp->sa1);
+            (*stack->rxtime)[idxf] = rxtime;
+            /* mark as received unless the owner gave up meanwhile, the buffer
+             * is complete before the owner sees it */
+            bufstat = EC_BUF_TX;
+            if (__atomic_compare_exchange_n(&(*stack->rxbufstat)[idxf], &bufstat, EC_BUF_RCVD,
+                                            FALSE, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+            {
+               ecx_rxwake(stack, idxf);
+            }
+         }
+         else if (idxf < port->bufnr)
+         {
+            /* nobody waits for the index, late or duplicate frame */
+            __atomic_add_fetch(&(port->stale), 1, __ATOMIC_RELAXED);
+         }
+         else
+         {
+            /* index not in the pool, frame of someone else */
+            __atomic_add_fetch(&(port->foreign), 1, __ATOMIC_RELAXED);
+         }
       }
-      pthread_mutex_unlock( &(port->tx_mutex) );
+   }
+   else
+   {
+      __atomic_add_fetch(&(port->foreign), 1, __ATOMIC_RELAXED);
    }
 
    return rval;
 }
 
-/** Non blocking read of socket. Put frame in temporary buffer.
+/** Non blocking lock free drain of all frames available on a stack for
+ * ECT_PORTMODE_DISPATCH. Frames are read into a local buffer or claimed from
+ * the receive ring, so several threads can drain the same socket and each
+ * frame is published into its rx buffer by the thread that read it. The
+ * AF_XDP and recvmmsg() buffers are shared, they are drained by one thread
+ * at a time and the others return at once instead of blocking.
  * @param[in] port        = port context struct
+ * @param[in] idx         = requested index of frame
  * @param[in] stacknumber = 0=primary 1=secondary stack
- * @return >0 if frame is available and read
+ * @return Workcounter if the frame with the requested index was read,
+ * otherwise EC_NOFRAME or EC_OTHERFRAME.
  */
-static int ecx_recvpkt(ecx_portt *port, int stacknumber)
+static int ecx_drain(ecx_portt *port, uint8 idx, int stacknumber)
 {
-   int lp, bytesrx;
+   int rval, wkc, i, n;
    ec_stackT *stack;
+   ec_bufT buf;
+   uint8 *frame;
+   struct tpacket2_hdr *hdr;
+   int64 rxtime[EC_MMSGFRAMES];
 
    if (!stacknumber)
    {
@@ -347,11 +1673,77 @@ static int ecx_recvpkt(ecx_portt *port, int stacknumber)
    {
       stack = &(port->redport->stack);
    }
-   lp = sizeof(port->tempinbuf);
-   bytesrx = recv(*stack->sock, (*stack->tempbuf), lp, 0);
-   port->tempinbufs = bytesrx;
+   rval = EC_NOFRAME;
+   if (stack->xsk->umem || (!stack->rxring->base && (port->portmode & ECT_PORTMODE_MMSG)))
+   {
+      if (pthread_mutex_trylock(&(port->rx_mutex)) == 0)
+      {
+         do
+         {
+            n = 0;
+            if (stack->xsk->umem)
+            {
+               frame = ecx_xdp_peek(stack->xsk);
+               if (frame)
+               {
+                  wkc = ecx_rxframe(port, stack, idx, frame, ecx_xdptime(port));
+                  ecx_xdp_release(stack->xsk);
+                  if ((wkc != EC_OTHERFRAME) || (rval == EC_NOFRAME))
+                  {
+                     rval = wkc;
+                  }
+                  n = 1;
+               }
+            }
+            else
+            {
+               n = ecx_recvmpkt(port, stacknumber, rxtime);
+               for (i = 0; i < n; i++)
+               {
+                  wkc = ecx_rxframe(port, stack, idx, (*stack->mmsgbuf)[i], rxtime[i]);
+                  if ((wkc != EC_OTHERFRAME) || (rval == EC_NOFRAME))
+                  {
+                     rval = wkc;
+                  }
+               }
+            }
+         } while (n > 0);
+         pthread_mutex_unlock(&(port->rx_mutex));
+      }
+      return rval;
+   }
+   do
+   {
+      frame = NULL;
+      hdr = NULL;
+      if (stack->rxring->base)
+      {
+         hdr = ecx_ringclaim(stack->rxring);
+         if (hdr)
+         {
+            frame = (uint8 *)hdr + hdr->tp_mac;
+            rxtime[0] = ecx_ringtime(hdr);
+         }
+      }
+      else if (ecx_recvts(*stack->sock, buf, sizeof(buf), MSG_DONTWAIT, &rxtime[0]) > 0)
+      {
+         frame = buf;
+      }
+      if (frame)
+      {
+         wkc = ecx_rxframe(port, stack, idx, frame, rxtime[0]);
+         if ((wkc != EC_OTHERFRAME) || (rval == EC_NOFRAME))
+         {
+            rval = wkc;
+         }
+         if (hdr)
+         {
+            __atomic_store_n(&(hdr->tp_status), TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+         }
+      }
+   } while (frame);
 
-   return (bytesrx > 0);
+   return rval;
 }
 
 /** Non blocking receive frame function. Uses RX buffer and index to combine
@@ -359,26 +1751,32 @@ static int ecx_recvpkt(ecx_portt *port, int stacknumber)
  * are out-of-order all frames are stored in their respective indexed buffer.
  * If a frame was placed in the buffer previously, the function retrieves it
  * from that buffer index without calling ec_recvpkt. If the requested index
- * is not already in the buffer it calls ec_recvpkt to fetch it. There are
+ * is not already in the buffer it calls ec_recvpkt to fetch it, or takes the
+ * next frame straight out of the receive ring when that is used. There are
  * three options now, 1 no frame read, so exit. 2 frame read but other
  * than requested index, store in buffer and exit. 3 frame read with matching
  * index, store in buffer, set completed flag in buffer status and exit.
  *
+ * With ECT_PORTMODE_MMSG all frames available on the socket are drained with
+ * one recvmmsg() and stored in their indexed buffers, so waiting for the
+ * other frames of a process data cycle finds them without another syscall.
+ *
+ * With ECT_PORTMODE_DISPATCH the rx mutex is not taken, see ecx_drain().
+ *
  * @param[in] port        = port context struct
  * @param[in] idx         = requested index of frame
  * @param[in] stacknumber = 0=primary 1=secondary stack
  * @return Workcounter if a frame is found with corresponding index, otherwise
  * EC_NOFRAME or EC_OTHERFRAME.
  */
-int ecx_inframe(ecx_portt *port, uint8 idx, int stacknumber)
+static int ecx_rawinframe(ecx_portt *port, uint8 idx, int stacknumber)
 {
    uint16  l;
-   int     rval;
-   uint8   idxf;
-   ec_etherheadert *ehp;
-   ec_comt *ecp;
+   int     rval, wkc, i, n;
    ec_stackT *stack;
    ec_bufT *rxbuf;
+   uint8 *frame;
+   int64 rxtime[EC_MMSGFRAMES];
 
    if (!stacknumber)
    {
@@ -391,7 +1789,8 @@ int ecx_inframe(ecx_portt *port, uint8 idx, int stacknumber)
    rval = EC_NOFRAME;
    rxbuf = &(*stack->rxbuf)[idx];
    /* check if requested index is already in buffer ? */
-   if ((idx < EC_MAXBUF) && ((*stack->rxbufstat)[idx] == EC_BUF_RCVD))
+   if ((idx < port->bufnr) &&
+       (__atomic_load_n(&(*stack->rxbufstat)[idx], __ATOMIC_ACQUIRE) == EC_BUF_RCVD))
    {
       l = (*rxbuf)[0] + ((uint16)((*rxbuf)[1] & 0x0f) << 8);
       /* return WKC */
@@ -399,51 +1798,55 @@ int ecx_inframe(ecx_portt *port, uint8 idx, int stacknumber)
       /* mark as completed */
       (*stack->rxbufstat)[idx] = EC_BUF_COMPLETE;
    }
+   else if (port->portmode & ECT_PORTMODE_DISPATCH)
+   {
+      rval = ecx_drain(port, idx, stacknumber);
+   }
    else
    {
       pthread_mutex_lock(&(port->rx_mutex));
-      /* non blocking call to retrieve frame from socket */
-      if (ecx_recvpkt(port, stacknumber))
+      frame = NULL;
+      if (stack->xsk->umem)
+      {
+         /* frame is read in place from the AF_XDP UMEM */
+         frame = ecx_xdp_peek(stack->xsk);
+         rxtime[0] = ecx_xdptime(port);
+      }
+      else if (stack->rxring->base)
       {
-         rval = EC_OTHERFRAME;
-         ehp =(ec_etherheadert*)(stack->tempbuf);
-         /* check if it is an EtherCAT frame */
-         if (ehp->etype == htons(ETH_P_ECAT))
+         /* frame is read in place from the receive ring */
+         frame = ecx_ringpeek(stack->rxring, &rxtime[0]);
+      }
+      else if (port->portmode & ECT_PORTMODE_MMSG)
+      {
+         /* drain socket, keep WKC of the requested frame if it was among them */
+         n = ecx_recvmpkt(port, stacknumber, rxtime);
+         for (i = 0; i < n; i++)
          {
-            ecp =(ec_comt*)(&(*stack->tempbuf)[ETH_HEADERSIZE]);
-            l = etohs(ecp->elength) & 0x0fff;
-            idxf = ecp->index;
-            /* found index equals requested index ? */
-            if (idxf == idx)
-            {
-               /* yes, put it in the buffer array (strip ethernet header) */
-               memcpy(rxbuf, &(*stack->tempbuf)[ETH_HEADERSIZE], (*stack->txbuflength)[idx] - ETH_HEADERSIZE);
-               /* return WKC */
-               rval = ((*rxbuf)[l] + ((uint16)((*rxbuf)[l + 1]) << 8));
-               /* mark as completed */
-               (*stack->rxbufstat)[idx] = EC_BUF_COMPLETE;
-               /* store MAC source word 1 for redundant routing info */
-               (*stack->rxsa)[idx] = ntohs(ehp->sa1);
-            }
-            else
+            wkc = ecx_rxframe(port, stack, idx, (*stack->mmsgbuf)[i], rxtime[i]);
+            if ((wkc != EC_OTHERFRAME) || (rval == EC_NOFRAME))
             {
-               /* check if index exist and someone is waiting for it */
-               if (idxf < EC_MAXBUF && (*stack->rxbufstat)[idxf] == EC_BUF_TX)
-               {
-                  rxbuf = &(*stack->rxbuf)[idxf];
-                  /* put it in the buffer array (strip ethernet header) */
-                  memcpy(rxbuf, &(*stack->tempbuf)[ETH_HEADERSIZE], (*stack->txbuflength)[idxf] - ETH_HEADERSIZE);
-                  /* mark as received */
-                  (*stack->rxbufstat)[idxf] = EC_BUF_RCVD;
-                  (*stack->rxsa)[idxf] = ntohs(ehp->sa1);
-               }
-               else
-               {
-                  /* strange things happened */
-               }
+               rval = wkc;
             }
          }
       }
+      /* non blocking call to retrieve frame from socket */
+      else if (ecx_recvpkt(port, stacknumber, &rxtime[0]))
+      {
+         frame = *stack->tempbuf;
+      }
+      if (frame)
+      {
+         rval = ecx_rxframe(port, stack, idx, frame, rxtime[0]);
+         if (stack->xsk->umem)
+         {
+            ecx_xdp_release(stack->xsk);
+         }
+         else if (stack->rxring->base)
+         {
+            ecx_ringrelease(stack->rxring);
+         }
+      }
       pthread_mutex_unlock( &(port->rx_mutex) );
 
    }
@@ -452,6 +1855,251 @@ int ecx_inframe(ecx_portt *port, uint8 idx, int stacknumber)
    return rval;
 }
 
+/** Non blocking receive frame function of the transport of the port, see
+ * ecx_rawinframe() for the built in transport.
+ * @param[in] port        = port context struct
+ * @param[in] idx         = requested index of frame
+ * @param[in] stacknumber = 0=primary 1=secondary stack
+ * @return Workcounter if a frame is found with corresponding index, otherwise
+ * EC_NOFRAME or EC_OTHERFRAME.
+ */
+int ecx_inframe(ecx_portt *port, uint8 idx, int stacknumber)
+{
+   int wkc;
+
+   if (port->transport && port->transport->inframe)
+   {
+      wkc = port->transport->inframe(port, idx, stacknumber);
+   }
+   else
+   {
+      wkc = ecx_rawinframe(port, idx, stacknumber);
+   }
+   if (wkc > EC_NOFRAME)
+   {
+      __atomic_add_fetch(&(port->rxframes), 1, __ATOMIC_RELAXED);
+#ifdef EC_TRACE
+      ecx_traceframe(port, EC_TRACE_RX, idx, stacknumber,
+                     stacknumber ? port->redport->rxbuf[idx] : port->rxbuf[idx], wkc);
+#endif
+   }
+
+   return wkc;
+}
+
+/** Sleep until a frame may be available on the sockets, depending on the
+ * wait mode of the port. Returns at once in the spin modes and during the
+ * spin phase of ECT_WAIT_HYBRID. Another thread can read and store the
+ * frames waited for, it wakes the sleeper through the eventfd of the rx
+ * buffer, see ecx_rxwake().
+ * @param[in] port        = port context struct
+ * @param[in] idx         = indexes of the frames waited for
+ * @param[in] n           = number of indexes
+ * @param[in] stacks      = sockets to wait on, bit 0 primary, bit 1 secondary
+ * @param[in] timer       = absolute timeout
+ * @param[in] spintimer   = end of spin phase for ECT_WAIT_HYBRID
+ */
+static void ecx_waitrx(ecx_portt *port, const uint8 *idx, int n, int stacks,
+                       osal_timert *timer, osal_timert *spintimer)
+{
+   struct pollfd fds[2 + (2 * EC_MAXBUF)];
+   struct timespec now, ts;
+   int64 remain;
+   nfds_t nfds, nsock;
+   ec_stackT *stack[2];
+   ec_rxwaitT *rxwait;
+   eventfd_t count;
+   int i, s, nstack, stored;
+
+   /* frames of other transports do not arrive on the sockets */
+   if (((port->waitmode != ECT_WAIT_POLL) && (port->waitmode != ECT_WAIT_HYBRID)) ||
+       (port->transport && port->transport->inframe))
+   {
+      return;
+   }
+   if ((port->waitmode == ECT_WAIT_HYBRID) && !osal_timer_is_expired(spintimer))
+   {
+      return;
+   }
+   if (n > EC_MAXBUF)
+   {
+      n = EC_MAXBUF;
+   }
+   nfds = 0;
+   nstack = 0;
+   if (stacks & 1)
+   {
+      fds[nfds].fd = port->sockhandle;
+      fds[nfds].events = POLLIN;
+      nfds++;
+      stack[nstack++] = &(port->stack);
+   }
+   if ((stacks & 2) && (port->redstate != ECT_RED_NONE))
+   {
+      fds[nfds].fd = port->redport->sockhandle;
+      fds[nfds].events = POLLIN;
+      nfds++;
+      stack[nstack++] = &(port->redport->stack);
+   }
+   /* timer runs on the monotonic clock, see osal_timer_start() */
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   remain = ((int64)timer->stop_time.sec - now.tv_sec) * 1000000 +
+            (int64)timer->stop_time.usec - (now.tv_nsec / 1000);
+   if ((nfds == 0) || (remain <= 0))
+   {
+      return;
+   }
+   if (remain > EC_POLLSLICE)
+   {
+      remain = EC_POLLSLICE;
+   }
+   ts.tv_sec = remain / 1000000;
+   ts.tv_nsec = (remain % 1000000) * 1000;
+   /* register on the rx buffers, then recheck them, the thread storing a
+    * frame changes the state checked here before it looks for pollers, so
+    * no wake up is lost */
+   nsock = nfds;
+   stored = 0;
+   for (s = 0; s < nstack; s++)
+   {
+      for (i = 0; i < n; i++)
+      {
+         rxwait = &(*stack[s]->rxwait)[idx[i]];
+         __atomic_add_fetch(&(rxwait->pollers), 1, __ATOMIC_SEQ_CST);
+         if (__atomic_load_n(&(*stack[s]->rxbufstat)[idx[i]], __ATOMIC_SEQ_CST) != EC_BUF_TX)
+         {
+            stored = 1;
+         }
+         if (rxwait->evfd >= 0)
+         {
+            fds[nfds].fd = rxwait->evfd;
+            fds[nfds].events = POLLIN;
+            nfds++;
+         }
+      }
+   }
+   /* queued transmit timestamps wake ppoll() with POLLERR, consume them */
+   if (!stored && (ppoll(fds, nfds, &ts, NULL) > 0))
+   {
+      if ((stacks & 1) && (fds[0].revents & POLLERR))
+      {
+         ecx_txtsdrain(port);
+      }
+      for (i = nsock; i < (int)nfds; i++)
+      {
+         if (fds[i].revents & POLLIN)
+         {
+            eventfd_read(fds[i].fd, &count);
+         }
+      }
+   }
+   for (s = 0; s < nstack; s++)
+   {
+      for (i = 0; i < n; i++)
+      {
+         __atomic_sub_fetch(&((*stack[s]->rxwait)[idx[i]].pollers), 1, __ATOMIC_SEQ_CST);
+      }
+   }
+}
+
+/** Wait for a frame in ECT_PORTMODE_DISPATCH. Spinning threads drain the
+ * sockets themselves. Otherwise one waiter at a time becomes the receiver
+ * and sleeps on the sockets, the other waiters sleep on the futex of their
+ * rx buffer until the receiver publishes their frame or gives up the role.
+ * @param[in]     port        = port context struct
+ * @param[in]     idx         = requested index of frame
+ * @param[in]     stacks      = stacks missing a frame, bit 0 primary, bit 1 secondary
+ * @param[in]     timer       = absolute timeout
+ * @param[in]     spintimer   = end of spin phase for ECT_WAIT_HYBRID
+ * @param[in,out] leader      = >0 if this thread is the receiver
+ */
+static void ecx_waitdispatch(ecx_portt *port, uint8 idx, int stacks, osal_timert *timer,
+                             osal_timert *spintimer, int *leader)
+{
+   struct timespec now, ts;
+   int64 remain;
+   int expected;
+   uint32 seq;
+   ec_stackT *stack;
+   ec_rxwaitT *rxwait;
+
+   /* frames of other transports are not published by a receiver */
+   if (((port->waitmode != ECT_WAIT_POLL) && (port->waitmode != ECT_WAIT_HYBRID)) ||
+       (port->transport && port->transport->inframe))
+   {
+      return;
+   }
+   if ((port->waitmode == ECT_WAIT_HYBRID) && !osal_timer_is_expired(spintimer))
+   {
+      return;
+   }
+   if (!*leader)
+   {
+      expected = 0;
+      *leader = __atomic_compare_exchange_n(&(port->rxleader), &expected, 1, FALSE,
+                                            __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+   }
+   if (*leader)
+   {
+      ecx_waitrx(port, &idx, 1, stacks, timer, spintimer);
+      return;
+   }
+   if (stacks & 1)
+   {
+      stack = &(port->stack);
+   }
+   else
+   {
+      stack = &(port->redport->stack);
+   }
+   rxwait = &(*stack->rxwait)[idx];
+   seq = __atomic_load_n(&(rxwait->seq), __ATOMIC_SEQ_CST);
+   __atomic_add_fetch(&(rxwait->waiters), 1, __ATOMIC_SEQ_CST);
+   /* recheck after registering, publisher and receiver change seq after
+    * changing the state checked here, so no wake up is lost */
+   if ((__atomic_load_n(&(*stack->rxbufstat)[idx], __ATOMIC_SEQ_CST) == EC_BUF_TX) &&
+       (__atomic_load_n(&(port->rxleader), __ATOMIC_SEQ_CST) != 0))
+   {
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      remain = ((int64)timer->stop_time.sec - now.tv_sec) * 1000000 +
+               (int64)timer->stop_time.usec - (now.tv_nsec / 1000);
+      if (remain > EC_POLLSLICE)
+      {
+         remain = EC_POLLSLICE;
+      }
+      if (remain > 0)
+      {
+         ts.tv_sec = remain / 1000000;
+         ts.tv_nsec = (remain % 1000000) * 1000;
+         syscall(SYS_futex, &(rxwait->seq), FUTEX_WAIT_PRIVATE, seq, &ts, NULL, 0);
+      }
+   }
+   __atomic_sub_fetch(&(rxwait->waiters), 1, __ATOMIC_SEQ_CST);
+}
+
+/** Give up the receiver role of ECT_PORTMODE_DISPATCH and wake all sleeping
+ * waiters so one of them can take it over.
+ * @param[in] port        = port context struct
+ */
+static void ecx_dispatchrelease(ecx_portt *port)
+{
+   int i;
+
+   __atomic_store_n(&(port->rxleader), 0, __ATOMIC_SEQ_CST);
+   for (i = 0; i < EC_MAXBUF; i++)
+   {
+      if (__atomic_load_n(&(port->rxwait[i].waiters), __ATOMIC_SEQ_CST) > 0)
+      {
+         ecx_rxwake(&(port->stack), i);
+      }
+      if ((port->redstate != ECT_RED_NONE) &&
+          (__atomic_load_n(&(port->redport->rxwait[i].waiters), __ATOMIC_SEQ_CST) > 0))
+      {
+         ecx_rxwake(&(port->redport->stack), i);
+      }
+   }
+}
+
 /** Blocking redundant receive frame function. If redundant mode is not active then
  * it skips the secondary stack and redundancy functions. In redundant mode it waits
  * for both (primary and secondary) frames to come in. The result goes in an decision
@@ -466,14 +2114,17 @@ int ecx_inframe(ecx_portt *port, uint8 idx, int stacknumber)
  */
 static int ecx_waitinframe_red(ecx_portt *port, uint8 idx, osal_timert *timer)
 {
-   osal_timert timer2;
+   osal_timert timer2, spintimer;
    int wkc  = EC_NOFRAME;
    int wkc2 = EC_NOFRAME;
-   int primrx, secrx;
+   int primrx, secrx, stacks;
+   int leader = 0;
 
    /* if not in redundant mode then always assume secondary is OK */
    if (port->redstate == ECT_RED_NONE)
       wkc2 = 0;
+   if (port->waitmode == ECT_WAIT_HYBRID)
+      osal_timer_start(&spintimer, port->spintime);
    do
    {
       /* only read frame if not already in */
@@ -486,8 +2137,19 @@ static int ecx_waitinframe_red(ecx_portt *port, uint8 idx, osal_timert *timer)
          if (wkc2 <= EC_NOFRAME)
             wkc2 = ecx_inframe(port, idx, 1);
       }
+      /* sleep on the sockets still missing a frame, depending on wait mode */
+      stacks = ((wkc <= EC_NOFRAME) ? 1 : 0) | ((wkc2 <= EC_NOFRAME) ? 2 : 0);
+      if (stacks && (port->portmode & ECT_PORTMODE_DISPATCH))
+         ecx_waitdispatch(port, idx, stacks, timer, &spintimer, &leader);
+      else if (stacks)
+         ecx_waitrx(port, &idx, 1, stacks, timer, &spintimer);
    /* wait for both frames to arrive or timeout */
    } while (((wkc <= EC_NOFRAME) || (wkc2 <= EC_NOFRAME)) && !osal_timer_is_expired(timer));
+   if (leader)
+      ecx_dispatchrelease(port);
+   /* keep the error queue short, transmit timestamps of frames nobody asks for
+    * would take up the socket receive buffer */
+   ecx_txtsdrain(port);
    /* only do redundant functions when in redundant mode */
    if (port->redstate != ECT_RED_NONE)
    {
@@ -521,11 +2183,14 @@ static int ecx_waitinframe_red(ecx_portt *port, uint8 idx, osal_timert *timer)
          }
          osal_timer_start (&timer2, EC_TIMEOUTRET);
          /* resend secondary tx */
+         __atomic_add_fetch(&(port->redrepairs), 1, __ATOMIC_RELAXED);
          ecx_outframe(port, idx, 1);
          do
          {
             /* retrieve frame */
             wkc2 = ecx_inframe(port, idx, 1);
+            if (wkc2 <= EC_NOFRAME)
+               ecx_waitrx(port, &idx, 1, 2, &timer2, &spintimer);
          } while ((wkc2 <= EC_NOFRAME) && !osal_timer_is_expired(&timer2));
          if (wkc2 > EC_NOFRAME)
          {
@@ -535,6 +2200,13 @@ static int ecx_waitinframe_red(ecx_portt *port, uint8 idx, osal_timert *timer)
          }
       }
    }
+   if (wkc <= EC_NOFRAME)
+   {
+      __atomic_add_fetch(&(port->timeouts), 1, __ATOMIC_RELAXED);
+#ifdef EC_TRACE
+      ecx_traceframe(port, EC_TRACE_TIMEOUT, idx, 0, &(port->txbuf[idx][ETH_HEADERSIZE]), 0);
+#endif
+   }
 
    /* return WKC or EC_NOFRAME */
    return wkc;
@@ -547,7 +2219,7 @@ static int ecx_waitinframe_red(ecx_portt *port, uint8 idx, osal_timert *timer)
  * @return Workcounter if a frame is found with corresponding index, otherwise
  * EC_NOFRAME.
  */
-int ecx_waitinframe(ecx_portt *port, uint8 idx, int timeout)
+static int ecx_rawwaitinframe(ecx_portt *port, uint8 idx, int timeout)
 {
    int wkc;
    osal_timert timer;
@@ -558,6 +2230,81 @@ int ecx_waitinframe(ecx_portt *port, uint8 idx, int timeout)
    return wkc;
 }
 
+/** Blocking receive frame function of the transport of the port, see
+ * ecx_rawwaitinframe() for the built in transport.
+ * @param[in] port        = port context struct
+ * @param[in] idx       = requested index of frame
+ * @param[in] timeout   = timeout in us
+ * @return Workcounter if a frame is found with corresponding index, otherwise
+ * EC_NOFRAME.
+ */
+int ecx_waitinframe(ecx_portt *port, uint8 idx, int timeout)
+{
+   if (port->transport && port->transport->waitinframe)
+   {
+      return port->transport->waitinframe(port, idx, timeout);
+   }
+
+   return ecx_rawwaitinframe(port, idx, timeout);
+}
+
+/** Blocking receive of the first of several frames to arrive. Frames of the
+ * other indexes that arrive meanwhile are kept in their buffers. In redundant
+ * mode, in ECT_PORTMODE_DISPATCH mode and with a transport without non
+ * blocking receive the frames are received in order, the first index is
+ * waited for.
+ * @param[in]  port        = port context struct
+ * @param[in]  idx         = indexes of the frames
+ * @param[in]  n           = number of indexes
+ * @param[out] wkc         = workcounter of the frame received
+ * @param[in]  timeout     = timeout in us
+ * @return position in idx of the frame received, -1 if none arrived
+ */
+int ecx_waitinframe_any(ecx_portt *port, const uint8 *idx, int n, int *wkc, int timeout)
+{
+   osal_timert timer, spintimer;
+   int i;
+
+   *wkc = EC_NOFRAME;
+   if (n < 1)
+   {
+      return -1;
+   }
+   if ((port->redstate != ECT_RED_NONE) || (port->portmode & ECT_PORTMODE_DISPATCH) ||
+       (port->transport && !port->transport->inframe))
+   {
+      *wkc = ecx_waitinframe(port, idx[0], timeout);
+      return (*wkc > EC_NOFRAME) ? 0 : -1;
+   }
+   osal_timer_start(&timer, timeout);
+   if (port->waitmode == ECT_WAIT_HYBRID)
+      osal_timer_start(&spintimer, port->spintime);
+   do
+   {
+      for (i = 0; i < n; i++)
+      {
+         *wkc = ecx_inframe(port, idx[i], 0);
+         if (*wkc > EC_NOFRAME)
+         {
+            ecx_txtsdrain(port);
+            return i;
+         }
+      }
+      ecx_waitrx(port, idx, n, 1, &timer, &spintimer);
+   } while (!osal_timer_is_expired(&timer));
+   ecx_txtsdrain(port);
+   __atomic_add_fetch(&(port->timeouts), 1, __ATOMIC_RELAXED);
+#ifdef EC_TRACE
+   for (i = 0; i < n; i++)
+   {
+      ecx_traceframe(port, EC_TRACE_TIMEOUT, idx[i], 0, &(port->txbuf[idx[i]][ETH_HEADERSIZE]), 0);
+   }
+#endif
+   *wkc = EC_NOFRAME;
+
+   return -1;
+}
+
 /** Blocking send and receive frame function. Used for non processdata frames.
  * A datagram is build into a frame and transmitted via this function. It waits
  * for an answer and returns the workcounter. The function retries if time is
@@ -570,14 +2317,20 @@ int ecx_waitinframe(ecx_portt *port, uint8 idx, int timeout)
  * @param[in] timeout  = timeout in us
  * @return Workcounter or EC_NOFRAME
  */
-int ecx_srconfirm(ecx_portt *port, uint8 idx, int timeout)
+static int ecx_rawsrconfirm(ecx_portt *port, uint8 idx, int timeout)
 {
    int wkc = EC_NOFRAME;
+   boolean retry = FALSE;
    osal_timert timer1, timer2;
 
    osal_timer_start (&timer1, timeout);
    do
    {
+      if (retry)
+      {
+         __atomic_add_fetch(&(port->retries), 1, __ATOMIC_RELAXED);
+      }
+      retry = TRUE;
       /* tx frame on primary and if in redundant mode a dummy on secondary */
       ecx_outframe_red(port, idx);
       if (timeout < EC_TIMEOUTRET)
@@ -597,6 +2350,36 @@ int ecx_srconfirm(ecx_portt *port, uint8 idx, int timeout)
    return wkc;
 }
 
+/** Blocking send and receive frame function of the transport of the port, see
+ * ecx_rawsrconfirm() for the built in transport.
+ * @param[in] port        = port context struct
+ * @param[in] idx      = index of frame
+ * @param[in] timeout  = timeout in us
+ * @return Workcounter or EC_NOFRAME
+ */
+int ecx_srconfirm(ecx_portt *port, uint8 idx, int timeout)
+{
+   if (port->transport && port->transport->srconfirm)
+   {
+      return port->transport->srconfirm(port, idx, timeout);
+   }
+
+   return ecx_rawsrconfirm(port, idx, timeout);
+}
+
+/** Built in transport, PF_PACKET raw socket with the options of
+ * ecx_portt.portmode */
+const ec_transportT ecx_rawtransport =
+{
+   "raw",
+   ecx_rawsetup,
+   ecx_rawclose,
+   ecx_rawoutframe,
+   ecx_rawinframe,
+   ecx_rawwaitinframe,
+   ecx_rawsrconfirm
+};
+
 #ifdef EC_VER1
 int ec_setupnic(const char *ifname, int secondary)
 {
@@ -608,11 +2391,26 @@ int ec_closenic(void)
    return ecx_closenic(&ecx_port);
 }
 
-uint8 ec_getindex(void)
+int ec_getindex(void)
 {
    return ecx_getindex(&ecx_port);
 }
 
+int ec_getindex_part(int part)
+{
+   return ecx_getindex_part(&ecx_port, part);
+}
+
+void ec_getframetime(uint8 idx, ec_frametimet *frametime)
+{
+   ecx_getframetime(&ecx_port, idx, frametime);
+}
+
+void ec_getportstats(ec_portstatT *stats)
+{
+   ecx_getportstats(&ecx_port, stats);
+}
+
 void ec_setbufstat(uint8 idx, int bufstat)
 {
    ecx_setbufstat(&ecx_port, idx, bufstat);
@@ -628,6 +2426,11 @@ int ec_outframe_red(uint8 idx)
    return ecx_outframe_red(&ecx_port, idx);
 }
 
+int ec_outframe_red_batch(const uint8 *idx, int n)
+{
+   return ecx_outframe_red_batch(&ecx_port, idx, n);
+}
+
 int ec_inframe(uint8 idx, int stacknumber)
 {
    return ecx_inframe(&ecx_port, idx, stacknumber);
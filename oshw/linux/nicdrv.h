@@ -16,7 +16,228 @@ extern "C"
 {
 #endif
 
+#include <stddef.h>
 #include <pthread.h>
+#include "nicdrv_xdp.h"
+
+/** Port I/O modes, may be combined. Set ecx_portt.portmode before
+ * ecx_setupnic() to select them, unsupported modes are cleared again. */
+enum
+{
+   /** one recv() per received frame */
+   ECT_PORTMODE_DEFAULT = 0x00,
+   /** receive frames through a mmap'd PACKET_RX_RING */
+   ECT_PORTMODE_RXRING  = 0x01,
+   /** transmit frames through a mmap'd PACKET_TX_RING */
+   ECT_PORTMODE_TXRING  = 0x02,
+   /** receive and transmit frames through an AF_XDP socket, rings are not used */
+   ECT_PORTMODE_XDP     = 0x04,
+   /** with ECT_PORTMODE_XDP, force generic (SKB) XDP mode, f.e. for veth */
+   ECT_PORTMODE_XDPSKB  = 0x08,
+   /** batch frames with sendmmsg() and recvmmsg() where rings are not used */
+   ECT_PORTMODE_MMSG    = 0x10,
+   /** lock free receive, frames are published into their rx buffer by
+    * whichever thread reads them and sleeping waiters are woken per index */
+   ECT_PORTMODE_DISPATCH = 0x20,
+   /** software transmit and receive timestamps with SO_TIMESTAMPING, see
+    * ecx_getframetime(). With AF_XDP they are taken in user space. */
+   ECT_PORTMODE_TIMESTAMP = 0x40
+};
+
+/** number of frames drained with one recvmmsg() */
+#define EC_MMSGFRAMES   16
+
+/** Receive wait strategies. Set ecx_portt.waitmode before ecx_setupnic(). */
+enum
+{
+   /** spin on non blocking receive until frame arrives or timeout */
+   ECT_WAIT_SPIN     = 0,
+   /** spin with SO_BUSY_POLL and PACKET_QDISC_BYPASS set on the sockets */
+   ECT_WAIT_BUSYPOLL = 1,
+   /** sleep in ppoll() until a frame arrives or the deadline passes */
+   ECT_WAIT_POLL     = 2,
+   /** spin for ecx_portt.spintime us, then sleep in ppoll() */
+   ECT_WAIT_HYBRID   = 3
+};
+
+/** SO_BUSY_POLL time in us for ECT_WAIT_BUSYPOLL */
+#define EC_BUSYPOLLTIME 50
+/** max time in us of one ppoll(), bounds the wake up delay when another
+ * thread received the frame that is waited for */
+#define EC_POLLSLICE    1000
+
+/** mmap'd packet ring shared with the kernel */
+typedef struct
+{
+   /** first frame slot of the ring, NULL if ring is not used */
+   uint8       *base;
+   /** size of one frame slot in bytes */
+   int         framesize;
+   /** number of frame slots */
+   int         framenr;
+   /** next frame slot to use, modulo framenr */
+   uint32      head;
+   /** transmit ring only, held while a slot is filled so slots become ready
+    * in ring order */
+   pthread_mutex_t mutex;
+} ec_ringT;
+
+/** waiters on one rx buffer */
+typedef struct
+{
+   /** futex word, changed whenever a waiter has to recheck the rx buffer */
+   uint32      seq;
+   /** number of threads sleeping on seq, ECT_PORTMODE_DISPATCH */
+   int         waiters;
+   /** number of threads sleeping in ppoll() on evfd, ECT_WAIT_POLL and
+    * ECT_WAIT_HYBRID */
+   int         pollers;
+   /** eventfd signalled when another thread stores the frame, -1 if none */
+   int         evfd;
+} ec_rxwaitT;
+
+/** partition of the frame index pool with its occupancy counters */
+typedef struct
+{
+   /** first index of partition */
+   int         first;
+   /** number of indexes in partition */
+   int         nr;
+   /** last used index */
+   int         lastidx;
+   /** number of indexes allocated */
+   int         inuse;
+   /** highest number of indexes allocated at the same time */
+   int         maxinuse;
+   /** number of allocations that failed as all indexes were in use */
+   uint32      exhausted;
+} ec_idxpartT;
+
+/** Traffic counters of a port, see ecx_getportstats() */
+typedef struct
+{
+   /** frames transmitted on the primary port */
+   uint32      txframes;
+   /** frames transmitted on the secondary port, dummy frames and resends */
+   uint32      redtxframes;
+   /** frames received for their index, on either port */
+   uint32      rxframes;
+   /** frames received that are not EtherCAT frames of the index pool */
+   uint32      foreign;
+   /** EtherCAT frames received for an index nobody waits for, like late
+    * answers of frames that timed out */
+   uint32      stale;
+   /** waits for a frame that timed out */
+   uint32      timeouts;
+   /** frames transmitted again by ecx_srconfirm() after a timeout */
+   uint32      retries;
+   /** frames resent over the secondary port to repair a broken ring */
+   uint32      redrepairs;
+   /** ecx_getindex() calls that failed as all indexes were in use */
+   uint32      idxexhausted;
+} ec_portstatT;
+
+/** Trace record types, see ec_tracerect */
+enum
+{
+   /** frame transmitted, fields of the first datagram, length of the frame
+    * and number of datagrams */
+   EC_TRACE_TX = 1,
+   /** frame received for its index, fields of the first datagram and wkc
+    * of the last one */
+   EC_TRACE_RX,
+   /** wait for the frame of an index timed out */
+   EC_TRACE_TIMEOUT,
+   /** mailbox written, adp is the slave, cmd the mailbox type, idx the
+    * mailbox counter, length the mailbox data length */
+   EC_TRACE_MBXTX,
+   /** mailbox read, fields as for EC_TRACE_MBXTX */
+   EC_TRACE_MBXRX,
+   /** state requested by ecx_writestate(), adp is the slave, cmd the state */
+   EC_TRACE_STATEREQ,
+   /** state found by ecx_statecheck(), adp is the slave, cmd the AL status,
+    * ado the AL status code */
+   EC_TRACE_STATE
+};
+
+/** number of records in the trace ring of a port, power of 2 */
+#ifndef EC_TRACESIZE
+#define EC_TRACESIZE    4096
+#endif
+
+/** magic number of a trace file, "ECTR" */
+#define EC_TRACEMAGIC   0x52544345
+/** version of the trace file format */
+#define EC_TRACEVERSION 1
+
+/** Fixed size binary trace record, see ecx_trace() */
+typedef struct
+{
+   /** monotonic time in ns */
+   int64       time;
+   /** position in the ring + 1, 0 while the record is written */
+   uint32      seq;
+   /** record type, see EC_TRACE_xxx */
+   uint8       type;
+   /** frame index */
+   uint8       idx;
+   /** EtherCAT command */
+   uint8       cmd;
+   /** 0 = primary, 1 = secondary port */
+   uint8       stack;
+   /** ADP of the datagram, low word of the logical address */
+   uint16      adp;
+   /** ADO of the datagram, high word of the logical address */
+   uint16      ado;
+   /** length in bytes */
+   uint16      length;
+   /** workcounter */
+   uint16      wkc;
+   /** number of datagrams in the frame */
+   uint16      datagrams;
+   uint16      reserved;
+} ec_tracerect;
+
+/** Header of a trace file written by ecx_trace_save(), followed by count
+ * records in the order they were written */
+typedef struct
+{
+   /** EC_TRACEMAGIC */
+   uint32      magic;
+   /** EC_TRACEVERSION */
+   uint32      version;
+   /** size of a record, sizeof(ec_tracerect) */
+   uint32      recsize;
+   /** number of records */
+   uint32      count;
+} ec_traceheadert;
+
+typedef struct ecx_port ecx_portt;
+
+/** Transport operations of a port. Set ecx_portt.transport before
+ * ecx_setupnic() to use another transport than the built in raw socket,
+ * operations left NULL use the raw socket implementation. The generic
+ * waitinframe and srconfirm are built on the outframe and inframe of the
+ * transport, so a transport needs at least those two. The frame buffers,
+ * index pool and buffer states of the port are shared by all transports.
+ */
+typedef struct
+{
+   /** name of transport */
+   const char *name;
+   /** open transport, called after the port state is set up */
+   int (*setup)(ecx_portt *port, const char *ifname, int secondary);
+   /** close transport */
+   int (*close)(ecx_portt *port);
+   /** transmit frame of index, see ecx_outframe() */
+   int (*outframe)(ecx_portt *port, uint8 idx, int stacknumber);
+   /** non blocking receive of frame of index, see ecx_inframe() */
+   int (*inframe)(ecx_portt *port, uint8 idx, int stacknumber);
+   /** blocking receive of frame of index, see ecx_waitinframe() */
+   int (*waitinframe)(ecx_portt *port, uint8 idx, int timeout);
+   /** blocking transmit and receive of frame of index, see ecx_srconfirm() */
+   int (*srconfirm)(ecx_portt *port, uint8 idx, int timeout);
+} ec_transportT;
 
 /** pointer structure to Tx and Rx stacks */
 typedef struct
@@ -35,6 +256,18 @@ typedef struct
    int         (*rxbufstat)[EC_MAXBUF];
    /** received MAC source address (middle word) */
    int         (*rxsa)[EC_MAXBUF];
+   /** receive timestamps */
+   int64       (*rxtime)[EC_MAXBUF];
+   /** receive ring */
+   ec_ringT    *rxring;
+   /** transmit ring */
+   ec_ringT    *txring;
+   /** AF_XDP socket */
+   ec_xskT     *xsk;
+   /** recvmmsg() receive buffers */
+   ec_bufT     (*mmsgbuf)[EC_MMSGFRAMES];
+   /** rx buffer waiters */
+   ec_rxwaitT  (*rxwait)[EC_MAXBUF];
 } ec_stackT;
 
 /** pointer structure to buffers for redundant port */
@@ -48,12 +281,32 @@ typedef struct
    int rxbufstat[EC_MAXBUF];
    /** rx MAC source address */
    int rxsa[EC_MAXBUF];
+   /** rx software timestamps in ns, 0 if not available */
+   int64 rxtime[EC_MAXBUF];
    /** temporary rx buffer */
    ec_bufT tempinbuf;
+   /** recvmmsg() receive buffers */
+   ec_bufT mmsgbuf[EC_MMSGFRAMES];
+   /** rx buffer waiters */
+   ec_rxwaitT rxwait[EC_MAXBUF];
+   /** receive ring */
+   ec_ringT rxring;
+   /** transmit ring */
+   ec_ringT txring;
+   /** mmap'd area of socket rings */
+   void *ringmap;
+   /** size of mmap'd area */
+   size_t ringmapsize;
+   /** AF_XDP socket state */
+   ec_xskT xsk;
 } ecx_redportt;
 
-/** pointer structure to buffers, vars and mutexes for port instantiation */
-typedef struct
+/** pointer structure to buffers, vars and mutexes for port instantiation.
+ * The members portmode, waitmode, spintime, bufnr, rtbufnr, transport and
+ * transportdata configure the port, they are read by ecx_setupnic(). Zero
+ * the struct before setting them, f.e. with memset(), zero selects the
+ * defaults. */
+struct ecx_port
 {
    ec_stackT   stack;
    int         sockhandle;
@@ -63,31 +316,98 @@ typedef struct
    int rxbufstat[EC_MAXBUF];
    /** rx MAC source address */
    int rxsa[EC_MAXBUF];
+   /** rx software timestamps in ns, 0 if not available */
+   int64 rxtime[EC_MAXBUF];
    /** temporary rx buffer */
    ec_bufT tempinbuf;
    /** temporary rx buffer status */
    int tempinbufs;
+   /** recvmmsg() receive buffers */
+   ec_bufT mmsgbuf[EC_MMSGFRAMES];
+   /** rx buffer waiters */
+   ec_rxwaitT rxwait[EC_MAXBUF];
+   /** >0 if a thread waits on the sockets for ECT_PORTMODE_DISPATCH */
+   int rxleader;
    /** transmit buffers */
    ec_bufT txbuf[EC_MAXBUF];
    /** transmit buffer lengths */
    int txbuflength[EC_MAXBUF];
+   /** tx software timestamps in ns, 0 if not available */
+   int64 txtime[EC_MAXBUF];
    /** temporary tx buffer */
    ec_bufT txbuf2;
    /** temporary tx buffer length */
    int txbuflength2;
    /** last used frame index */
    uint8 lastidx;
+   /** number of frame indexes in the pool, set before ecx_setupnic(),
+    * 0 or more than EC_MAXBUF selects EC_MAXBUF */
+   int bufnr;
+   /** number of frame indexes reserved for EC_IDXPART_RT, set before
+    * ecx_setupnic(), 0 to share the whole pool */
+   int rtbufnr;
+   /** frame index pool partitions, see ec_idxpart */
+   ec_idxpartT idxpart[EC_IDXPARTS];
+   /** free frame indexes, one bit per index */
+   uint64 idxfree[(EC_MAXBUF + 63) / 64];
+   /** number of ecx_getindex() calls that failed as all indexes were in use */
+   uint32 idxexhausted;
+   /** number of frames transmitted on the primary port */
+   uint32 txframes;
+   /** number of frames transmitted on the secondary port */
+   uint32 redtxframes;
+   /** number of frames received for their index */
+   uint32 rxframes;
+   /** number of frames received that are not EtherCAT frames of the pool */
+   uint32 foreign;
+   /** number of frames received for an index nobody waits for */
+   uint32 stale;
+   /** number of waits for a frame that timed out */
+   uint32 timeouts;
+   /** number of frames transmitted again by ecx_srconfirm() */
+   uint32 retries;
+   /** number of frames resent over the secondary port to repair the ring */
+   uint32 redrepairs;
    /** current redundancy state */
    int redstate;
    /** pointer to redundancy port and buffers */
    ecx_redportt *redport;
-   pthread_mutex_t getindex_mutex;
+   /** requested I/O mode, see ECT_PORTMODE_xxx, set before ecx_setupnic(),
+    * unknown bits are cleared */
+   int portmode;
+   /** receive wait strategy, see ECT_WAIT_xxx, set before ecx_setupnic(),
+    * unknown strategies select ECT_WAIT_SPIN */
+   int waitmode;
+   /** spin time in us before sleeping for ECT_WAIT_HYBRID, set before
+    * ecx_setupnic() */
+   int spintime;
+   /** receive ring */
+   ec_ringT rxring;
+   /** transmit ring */
+   ec_ringT txring;
+   /** mmap'd area of socket rings */
+   void *ringmap;
+   /** size of mmap'd area */
+   size_t ringmapsize;
+   /** AF_XDP socket state */
+   ec_xskT xsk;
+#ifdef EC_TRACE
+   /** records written to the trace ring */
+   uint32 tracehead;
+   /** trace ring, see ecx_trace() */
+   ec_tracerect trace[EC_TRACESIZE];
+#endif
+   /** transport, set before ecx_setupnic(), NULL for the built in raw socket */
+   const ec_transportT *transport;
+   /** private data of the transport, NULL if it has none */
+   void *transportdata;
    pthread_mutex_t tx_mutex;
    pthread_mutex_t rx_mutex;
-} ecx_portt;
+};
 
 extern const uint16 priMAC[3];
 extern const uint16 secMAC[3];
+extern const ec_transportT ecx_rawtransport;
 
 #ifdef EC_VER1
 extern ecx_portt     ecx_port;
@@ -96,9 +416,13 @@ extern ecx_redportt  ecx_redport;
 int ec_setupnic(const char * ifname, int secondary);
 int ec_closenic(void);
 void ec_setbufstat(uint8 idx, int bufstat);
-uint8 ec_getindex(void);
+int ec_getindex(void);
+int ec_getindex_part(int part);
+void ec_getframetime(uint8 idx, ec_frametimet *frametime);
+void ec_getportstats(ec_portstatT *stats);
 int ec_outframe(uint8 idx, int sock);
 int ec_outframe_red(uint8 idx);
+int ec_outframe_red_batch(const uint8 *idx, int n);
 int ec_waitinframe(uint8 idx, int timeout);
 int ec_srconfirm(uint8 idx,int timeout);
 #endif
@@ -107,11 +431,22 @@ void ec_setupheader(void *p);
 int ecx_setupnic(ecx_portt *port, const char * ifname, int secondary);
 int ecx_closenic(ecx_portt *port);
 void ecx_setbufstat(ecx_portt *port, uint8 idx, int bufstat);
-uint8 ecx_getindex(ecx_portt *port);
+int ecx_getindex(ecx_portt *port);
+int ecx_getindex_part(ecx_portt *port, int part);
+void ecx_getframetime(ecx_portt *port, uint8 idx, ec_frametimet *frametime);
+void ecx_getportstats(ecx_portt *port, ec_portstatT *stats);
 int ecx_outframe(ecx_portt *port, uint8 idx, int sock);
 int ecx_outframe_red(ecx_portt *port, uint8 idx);
+int ecx_outframe_red_batch(ecx_portt *port, const uint8 *idx, int n);
 int ecx_waitinframe(ecx_portt *port, uint8 idx, int timeout);
+int ecx_waitinframe_any(ecx_portt *port, const uint8 *idx, int n, int *wkc, int timeout);
 int ecx_srconfirm(ecx_portt *port, uint8 idx,int timeout);
+#ifdef EC_TRACE
+void ecx_trace(ecx_portt *port, uint8 type, uint8 idx, uint8 cmd, uint16 adp, uint16 ado,
+               uint16 length, uint16 wkc);
+int ecx_trace_snapshot(ecx_portt *port, ec_tracerect *rec, int max);
+int ecx_trace_save(ecx_portt *port, const char *filename);
+#endif
 
 #ifdef __cplusplus
 }
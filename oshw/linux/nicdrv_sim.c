@@ -0,0 +1,1116 @@
+/*
+ * Licensed under the GNU General Public License version 2 with exceptions. See
+ * LICENSE file in the project root for full license information
+ */
+
+/** \file
+ * \brief
+ * In process EtherCAT slave simulator for the Linux RAW socket driver.
+ *
+ * A line of simulated slaves is kept in memory and every frame sent on the
+ * port is processed by them in place and returned at once, so the master can
+ * be run and measured without a NIC, without a network namespace and without
+ * scheduling noise of a peer. Select it with
+ *
+ *    ecx_sim_create(&sim, 1000, 4, 4);
+ *    port.transport = &ecx_simtransport;
+ *    port.transportdata = &sim;
+ *    ecx_init(&context, "sim");
+ *
+ * Each slave has its own register and process data memory. Modeled are all
+ * datagram types with their working counter rules, station addresses, the SII
+ * EEPROM interface, SyncManagers and bit granular FMMUs, the AL state machine
+ * with its error flag and status code and the DC receive time latches, local
+ * and system time with offset and delay. Slaves are connected in a line, they
+ * have no mailbox. In OP the outputs written by the master are copied to the
+ * inputs of the slave after the datagram is processed, so they are read back
+ * in the next cycle.
+ *
+ * The generated SII describes a slave with the given number of output and
+ * input bytes, SyncManager 0 outputs and SyncManager 1 inputs. It can be
+ * replaced per slave with ecx_sim_setsii(). ecx_sim_process() does not depend
+ * on the port and can be used to serve frames from another source.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <pthread.h>
+
+#include "oshw.h"
+#include "osal.h"
+#include "nicdrv_sim.h"
+
+/** size of datagram header without the EtherCAT frame header */
+#define EC_SIM_DGHEADER    (int)(EC_HEADERSIZE - EC_ELENGTHSIZE)
+/** system time differences above this many ns are ignored by drift control */
+#define EC_SIM_DCMAXDIFF   1000000
+/** difference between the local clocks of neighbouring slaves in ns */
+#define EC_SIM_CLOCKSTEP   1000003
+
+static uint16 ecx_sim_get16(const uint8 *p)
+{
+   return (uint16)(p[0] | (p[1] << 8));
+}
+
+static uint32 ecx_sim_get32(const uint8 *p)
+{
+   return (uint32)ecx_sim_get16(p) | ((uint32)ecx_sim_get16(p + 2) << 16);
+}
+
+static uint64 ecx_sim_get64(const uint8 *p)
+{
+   return (uint64)ecx_sim_get32(p) | ((uint64)ecx_sim_get32(p + 4) << 32);
+}
+
+static void ecx_sim_put16(uint8 *p, uint16 v)
+{
+   p[0] = (uint8)v;
+   p[1] = (uint8)(v >> 8);
+}
+
+static void ecx_sim_put32(uint8 *p, uint32 v)
+{
+   ecx_sim_put16(p, (uint16)v);
+   ecx_sim_put16(p + 2, (uint16)(v >> 16));
+}
+
+static void ecx_sim_put64(uint8 *p, uint64 v)
+{
+   ecx_sim_put32(p, (uint32)v);
+   ecx_sim_put32(p + 4, (uint32)(v >> 32));
+}
+
+/** Host clock all slave clocks are derived from.
+ * @return monotonic time in ns
+ */
+static int64 ecx_sim_now(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (int64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/** Local time of slave when a frame sent at now passes it.
+ * @param[in] sim = simulator
+ * @param[in] p   = slave position, 0 = first
+ * @param[in] now = host time the frame was sent
+ * @return local time in ns
+ */
+static int64 ecx_sim_localtime(ec_simT *sim, int p, int64 now)
+{
+   return now + sim->slave[p].arrival + sim->slave[p].clockofs;
+}
+
+/** Registers the master can not write.
+ * @param[in] adr = register address
+ * @return TRUE if read only
+ */
+static boolean ecx_sim_rdonly(int adr)
+{
+   return (adr < ECT_REG_STADR) ||
+          ((adr >= ECT_REG_DLSTAT) && (adr < ECT_REG_DLSTAT + 2)) ||
+          ((adr >= ECT_REG_ALSTAT) && (adr < ECT_REG_ALSTAT + 6)) ||
+          ((adr >= ECT_REG_DCTIME0) && (adr < ECT_REG_DCSYSOFFSET));
+}
+
+/** Add PDO category to generated SII. Bytes are mapped in 32 bit entries
+ * and 8 bit entries for the rest, 255 entries per PDO.
+ * @param[out] b          = SII image
+ * @param[in]  pos        = byte position of category
+ * @param[in]  cat        = category, ECT_SII_PDO for TxPDO or ECT_SII_PDO + 1 for RxPDO
+ * @param[in]  pdoindex   = index of first PDO
+ * @param[in]  entryindex = object index of entries of first PDO
+ * @param[in]  sm         = SyncManager of PDOs
+ * @param[in]  bytes      = mapped bytes
+ * @return byte position after category
+ */
+static int ecx_sim_mkpdo(uint8 *b, int pos, uint16 cat, uint16 pdoindex,
+                         uint16 entryindex, uint8 sm, int bytes)
+{
+   int start, n32, n8, ne, e, pdo;
+   uint8 bits;
+
+   if (bytes <= 0)
+   {
+      return pos;
+   }
+   start = pos;
+   pos += 4;
+   n32 = bytes / 4;
+   n8 = bytes % 4;
+   pdo = 0;
+   while ((n32 + n8) > 0)
+   {
+      ne = n32 + n8;
+      if (ne > 255)
+      {
+         ne = 255;
+      }
+      ecx_sim_put16(b + pos, (uint16)(pdoindex + pdo));
+      b[pos + 2] = (uint8)ne;
+      b[pos + 3] = sm;
+      pos += 8;
+      for (e = 1; e <= ne; e++)
+      {
+         if (n32)
+         {
+            bits = 32;
+            n32--;
+         }
+         else
+         {
+            bits = 8;
+            n8--;
+         }
+         ecx_sim_put16(b + pos, (uint16)(entryindex + pdo));
+         b[pos + 2] = (uint8)e;
+         b[pos + 4] = (bits == 32) ? 0x07 : 0x05;
+         b[pos + 5] = bits;
+         pos += 8;
+      }
+      pdo++;
+   }
+   ecx_sim_put16(b + start, cat);
+   ecx_sim_put16(b + start + 2, (uint16)((pos - start - 4) / 2));
+
+   return pos;
+}
+
+/** Generate SII of a slave with one buffered SyncManager, FMMU and PDO
+ * category per direction, SM0 for outputs and SM1 for inputs.
+ * @param[out] sii     = buffer for SII image
+ * @param[in]  size    = size of buffer, at least EC_SIM_SIISIZE(obytes, ibytes)
+ * @param[in]  name    = device name, max 255 characters
+ * @param[in]  vendor  = vendor ID
+ * @param[in]  product = product code
+ * @param[in]  obytes  = output bytes
+ * @param[in]  ibytes  = input bytes
+ * @return size of SII image in bytes, 0 if buffer is too small
+ */
+int ecx_sim_gensii(uint8 *sii, int size, const char *name, uint32 vendor,
+                   uint32 product, int obytes, int ibytes)
+{
+   uint8 *b = sii;
+   uint8 crc;
+   int pos, l;
+
+   l = (int)strlen(name);
+   if ((obytes < 0) || (ibytes < 0) || (obytes + ibytes > EC_SIM_MEMSIZE - EC_SIM_PDRAM) ||
+       (l > 255) || (size < EC_SIM_SIISIZE(obytes, ibytes)))
+   {
+      return 0;
+   }
+   memset(b, 0, size);
+   ecx_sim_put32(b + (ECT_SII_MANUF << 1), vendor);
+   ecx_sim_put32(b + (ECT_SII_ID << 1), product);
+   ecx_sim_put32(b + (ECT_SII_REV << 1), 1);
+   ecx_sim_put16(b + (0x003f << 1), 1);
+   /* checksum of configuration area, CRC-8 polynomial x^8 + x^2 + x + 1 */
+   crc = 0xff;
+   for (pos = 0; pos < 14; pos++)
+   {
+      crc ^= b[pos];
+      for (l = 0; l < 8; l++)
+      {
+         crc = (crc & 0x80) ? (uint8)((crc << 1) ^ 0x07) : (uint8)(crc << 1);
+      }
+   }
+   b[14] = crc;
+   l = (int)strlen(name);
+   pos = ECT_SII_START << 1;
+   /* strings, name is string 1 */
+   ecx_sim_put16(b + pos, ECT_SII_STRING);
+   ecx_sim_put16(b + pos + 2, (uint16)((l + 3) / 2));
+   b[pos + 4] = 1;
+   b[pos + 5] = (uint8)l;
+   memcpy(b + pos + 6, name, l);
+   pos += 4 + ((l + 3) & ~1);
+   /* general */
+   ecx_sim_put16(b + pos, ECT_SII_GENERAL);
+   ecx_sim_put16(b + pos + 2, 16);
+   b[pos + 4 + 3] = 1;
+   pos += 4 + 32;
+   /* FMMU0 outputs, FMMU1 inputs */
+   ecx_sim_put16(b + pos, ECT_SII_FMMU);
+   ecx_sim_put16(b + pos + 2, 2);
+   b[pos + 4] = 1;
+   b[pos + 5] = 2;
+   b[pos + 6] = 0xff;
+   b[pos + 7] = 0xff;
+   pos += 8;
+   /* SM0 outputs, SM1 inputs, both buffered */
+   ecx_sim_put16(b + pos, ECT_SII_SM);
+   ecx_sim_put16(b + pos + 2, 8);
+   ecx_sim_put16(b + pos + 4, EC_SIM_PDRAM);
+   ecx_sim_put16(b + pos + 6, (uint16)obytes);
+   b[pos + 8] = 0x64;
+   b[pos + 10] = 1;
+   b[pos + 11] = 3;
+   ecx_sim_put16(b + pos + 12, (uint16)(EC_SIM_PDRAM + obytes));
+   ecx_sim_put16(b + pos + 14, (uint16)ibytes);
+   b[pos + 16] = 0x20;
+   b[pos + 18] = 1;
+   b[pos + 19] = 4;
+   pos += 20;
+   pos = ecx_sim_mkpdo(b, pos, ECT_SII_PDO, 0x1a00, 0x6000, 1, ibytes);
+   pos = ecx_sim_mkpdo(b, pos, ECT_SII_PDO + 1, 0x1600, 0x7000, 0, obytes);
+   ecx_sim_put16(b + pos, 0xffff);
+   pos += 2;
+   /* EEPROM size in KiBit - 1 */
+   ecx_sim_put16(b + (0x003e << 1), (uint16)((pos * 8 + 1023) / 1024 - 1));
+
+   return pos;
+}
+
+/** Put slave in power on state.
+ * @param[in] sim = simulator
+ * @param[in] p   = slave position
+ */
+static void ecx_sim_reset(ec_simT *sim, int p)
+{
+   ec_simslaveT *sl = &sim->slave[p];
+   uint16 dlstat;
+
+   memset(sl->mem, 0, sizeof(sl->mem));
+   sl->nfmmu = 0;
+   sl->mem[ECT_REG_TYPE] = 0x11;
+   sl->mem[ECT_REG_TYPE + 4] = EC_SIM_FMMUS;
+   sl->mem[ECT_REG_TYPE + 5] = EC_SIM_SMS;
+   sl->mem[ECT_REG_TYPE + 6] = (EC_SIM_MEMSIZE - EC_SIM_PDRAM) >> 10;
+   sl->mem[ECT_REG_PORTDES] = 0x0f;
+   /* DC with 64 bit system time */
+   ecx_sim_put16(sl->mem + ECT_REG_ESCSUP, 0x000c);
+   /* port 0 in use, port 1 to next slave or closed, port 2 and 3 closed */
+   dlstat = 0x0010 | 0x0200 | 0x1000 | 0x4000;
+   if (p < sim->slavecount - 1)
+   {
+      dlstat |= 0x0020 | 0x0800;
+   }
+   else
+   {
+      dlstat |= 0x0400;
+   }
+   ecx_sim_put16(sl->mem + ECT_REG_DLSTAT, dlstat);
+   ecx_sim_put16(sl->mem + ECT_REG_ALSTAT, EC_STATE_INIT);
+   sl->mem[ECT_REG_PDICTL] = 0x04;
+   ecx_sim_put16(sl->mem + ECT_REG_EEPSTAT, EC_ESTAT_R64);
+}
+
+/** Handle write of AL control, change state if the transition is valid,
+ * set error flag and status code if not.
+ * @param[in] sl = slave
+ */
+static void ecx_sim_alctl(ec_simslaveT *sl)
+{
+   uint16 ctl, stat, req, cur;
+   boolean ok;
+
+   ctl = ecx_sim_get16(sl->mem + ECT_REG_ALCTL);
+   stat = ecx_sim_get16(sl->mem + ECT_REG_ALSTAT);
+   req = ctl & 0x0f;
+   cur = stat & 0x0f;
+   if (ctl & EC_STATE_ACK)
+   {
+      stat &= ~EC_STATE_ERROR;
+   }
+   /* with pending error only a lower state is accepted */
+   if ((req != EC_STATE_NONE) && (!(stat & EC_STATE_ERROR) || (req < cur)))
+   {
+      switch (req)
+      {
+         case EC_STATE_INIT:
+            ok = TRUE;
+            break;
+         case EC_STATE_PRE_OP:
+            ok = (cur != EC_STATE_BOOT);
+            break;
+         case EC_STATE_BOOT:
+            ok = (cur == EC_STATE_INIT) || (cur == EC_STATE_BOOT);
+            break;
+         case EC_STATE_SAFE_OP:
+            ok = (cur == EC_STATE_PRE_OP) || (cur == EC_STATE_SAFE_OP) ||
+                 (cur == EC_STATE_OPERATIONAL);
+            break;
+         case EC_STATE_OPERATIONAL:
+            ok = (cur == EC_STATE_SAFE_OP) || (cur == EC_STATE_OPERATIONAL);
+            break;
+         default:
+            ok = FALSE;
+            break;
+      }
+      if (ok)
+      {
+         stat = (stat & EC_STATE_ERROR) | req;
+      }
+      else
+      {
+         stat |= EC_STATE_ERROR;
+         /* invalid requested state change */
+         ecx_sim_put16(sl->mem + ECT_REG_ALSTATCODE, 0x0011);
+      }
+   }
+   if (!(stat & EC_STATE_ERROR))
+   {
+      ecx_sim_put16(sl->mem + ECT_REG_ALSTATCODE, 0);
+   }
+   ecx_sim_put16(sl->mem + ECT_REG_ALSTAT, stat);
+}
+
+/** Execute EEPROM command, completes at once.
+ * @param[in] sl = slave
+ */
+static void ecx_sim_eeprom(ec_simslaveT *sl)
+{
+   uint32 adr;
+   int i, b;
+
+   adr = ecx_sim_get32(sl->mem + ECT_REG_EEPADR) << 1;
+   switch (ecx_sim_get16(sl->mem + ECT_REG_EEPCTL) & 0x0700)
+   {
+      case EC_ECMD_READ & 0x0700:
+         for (i = 0; i < 8; i++)
+         {
+            b = (int)adr + i;
+            sl->mem[ECT_REG_EEPDAT + i] = (b < sl->siisize) ? sl->sii[b] : 0xff;
+         }
+         break;
+      case EC_ECMD_WRITE & 0x0700:
+         if ((int)adr + 1 < sl->siisize)
+         {
+            sl->sii[adr] = sl->mem[ECT_REG_EEPDAT];
+            sl->sii[adr + 1] = sl->mem[ECT_REG_EEPDAT + 1];
+         }
+         break;
+      default:
+         break;
+   }
+   ecx_sim_put16(sl->mem + ECT_REG_EEPSTAT, EC_ESTAT_R64);
+}
+
+/** Latch the receive times of the ports, as a frame sent at now passes the
+ * line forward through port 0 and returns through port 1.
+ * @param[in] sim = simulator
+ * @param[in] p   = slave position
+ * @param[in] now = host time the frame was sent
+ */
+static void ecx_sim_dclatch(ec_simT *sim, int p, int64 now)
+{
+   ec_simslaveT *sl = &sim->slave[p];
+   ec_simslaveT *last;
+   int64 t;
+
+   t = ecx_sim_localtime(sim, p, now);
+   ecx_sim_put32(sl->mem + ECT_REG_DCTIME0, (uint32)t);
+   ecx_sim_put32(sl->mem + ECT_REG_DCTIME1, 0);
+   if (p < sim->slavecount - 1)
+   {
+      /* the frame passes the slaves after this one and returns without processing */
+      last = &sim->slave[sim->slavecount - 1];
+      t = now + 2 * last->arrival + last->delay - sim->slave[p + 1].arrival + sl->clockofs;
+      ecx_sim_put32(sl->mem + ECT_REG_DCTIME1, (uint32)t);
+   }
+   ecx_sim_put64(sl->mem + ECT_REG_DCSOF, (uint64)ecx_sim_localtime(sim, p, now));
+}
+
+/** System time of slave, local time plus offset.
+ * @param[in] sim = simulator
+ * @param[in] p   = slave position
+ * @param[in] now = host time the frame was sent
+ * @return system time in ns
+ */
+static uint64 ecx_sim_systime(ec_simT *sim, int p, int64 now)
+{
+   return (uint64)ecx_sim_localtime(sim, p, now) +
+          ecx_sim_get64(sim->slave[p].mem + ECT_REG_DCSYSOFFSET);
+}
+
+/** Handle write of system time, as the distribution of the reference clock
+ * with FRMW/ARMW. The difference is stored and a part of it is corrected.
+ * @param[in] sim   = simulator
+ * @param[in] p     = slave position
+ * @param[in] value = written system time, lower 32 bit
+ * @param[in] now   = host time the frame was sent
+ */
+static void ecx_sim_dcwrite(ec_simT *sim, int p, uint32 value, int64 now)
+{
+   ec_simslaveT *sl = &sim->slave[p];
+   int32 diff;
+   uint32 mag;
+
+   diff = (int32)(value + ecx_sim_get32(sl->mem + ECT_REG_DCSYSDELAY) -
+                  (uint32)ecx_sim_systime(sim, p, now));
+   mag = (diff < 0) ? (uint32)(-(int64)diff) : (uint32)diff;
+   /* bit 31 set when the local copy is smaller than the received time */
+   ecx_sim_put32(sl->mem + ECT_REG_DCSYSDIFF, (diff > 0) ? (mag | 0x80000000) : mag);
+   if (mag < EC_SIM_DCMAXDIFF)
+   {
+      ecx_sim_put64(sl->mem + ECT_REG_DCSYSOFFSET,
+                    ecx_sim_get64(sl->mem + ECT_REG_DCSYSOFFSET) + (uint64)(int64)(diff / 4));
+   }
+}
+
+/** Decode the active FMMUs from the registers.
+ * @param[in] sl = slave
+ */
+static void ecx_sim_fmmus(ec_simslaveT *sl)
+{
+   ec_simfmmuT *f;
+   uint8 *r;
+   uint16 len;
+   int i;
+
+   sl->nfmmu = 0;
+   for (i = 0; i < EC_SIM_FMMUS; i++)
+   {
+      r = sl->mem + ECT_REG_FMMU0 + (i * sizeof(ec_fmmut));
+      len = ecx_sim_get16(r + 4);
+      if ((r[12] & 0x01) && (r[11] & 0x03) && len)
+      {
+         f = &sl->fmmu[sl->nfmmu];
+         f->lstart = (uint64)ecx_sim_get32(r) * 8 + (r[6] & 0x07);
+         f->lend = ((uint64)ecx_sim_get32(r) + len - 1) * 8 + (r[7] & 0x07) + 1;
+         f->pstart = (uint32)ecx_sim_get16(r + 8) * 8 + (r[10] & 0x07);
+         f->type = r[11] & 0x03;
+         if (f->lend > f->lstart)
+         {
+            sl->nfmmu++;
+         }
+      }
+   }
+}
+
+/** Write to slave memory from datagram, with the side effects of registers.
+ * @param[in] sim  = simulator
+ * @param[in] p    = slave position
+ * @param[in] ado  = physical address
+ * @param[in] data = datagram data
+ * @param[in] len  = length of data
+ * @param[in] now  = host time the frame was sent
+ */
+static void ecx_sim_write(ec_simT *sim, int p, int ado, const uint8 *data, int len, int64 now)
+{
+   ec_simslaveT *sl = &sim->slave[p];
+   int end, i;
+   uint16 oldadr, newadr;
+
+   end = ado + len;
+   if (end > EC_SIM_MEMSIZE)
+   {
+      end = EC_SIM_MEMSIZE;
+   }
+   if (ado >= EC_SIM_PDRAM)
+   {
+      if (end > ado)
+      {
+         memcpy(sl->mem + ado, data, end - ado);
+      }
+      return;
+   }
+   oldadr = ecx_sim_get16(sl->mem + ECT_REG_STADR);
+   for (i = ado; i < end; i++)
+   {
+      if (!ecx_sim_rdonly(i))
+      {
+         sl->mem[i] = data[i - ado];
+      }
+   }
+   if ((ado <= ECT_REG_STADR + 1) && (end > ECT_REG_STADR))
+   {
+      newadr = ecx_sim_get16(sl->mem + ECT_REG_STADR);
+      if (sim->adrmap[oldadr] == p + 1)
+      {
+         sim->adrmap[oldadr] = 0;
+      }
+      sim->adrmap[newadr] = (uint16)(p + 1);
+   }
+   if ((ado <= ECT_REG_ALCTL) && (end > ECT_REG_ALCTL))
+   {
+      ecx_sim_alctl(sl);
+   }
+   if ((ado <= ECT_REG_EEPCTL + 1) && (end > ECT_REG_EEPCTL + 1))
+   {
+      ecx_sim_eeprom(sl);
+   }
+   if ((ado < ECT_REG_FMMU0 + EC_SIM_FMMUS * (int)sizeof(ec_fmmut)) && (end > ECT_REG_FMMU0))
+   {
+      ecx_sim_fmmus(sl);
+   }
+   if ((ado <= ECT_REG_DCTIME0) && (end > ECT_REG_DCTIME0))
+   {
+      ecx_sim_dclatch(sim, p, now);
+   }
+   if ((ado <= ECT_REG_DCSYSTIME) && (end >= ECT_REG_DCSYSTIME + 4))
+   {
+      ecx_sim_dcwrite(sim, p, ecx_sim_get32(data + ECT_REG_DCSYSTIME - ado), now);
+   }
+}
+
+/** Read from slave memory into datagram.
+ * @param[in]  sim   = simulator
+ * @param[in]  p     = slave position
+ * @param[in]  ado   = physical address
+ * @param[out] data  = datagram data
+ * @param[in]  len   = length of data
+ * @param[in]  merge = TRUE to OR into the data as with broadcast reads
+ * @param[in]  now   = host time the frame was sent
+ */
+static void ecx_sim_read(ec_simT *sim, int p, int ado, uint8 *data, int len,
+                         boolean merge, int64 now)
+{
+   ec_simslaveT *sl = &sim->slave[p];
+   int end, i;
+
+   end = ado + len;
+   if (end > EC_SIM_MEMSIZE)
+   {
+      end = EC_SIM_MEMSIZE;
+   }
+   if ((ado < ECT_REG_DCSYSTIME + 8) && (end > ECT_REG_DCSYSTIME))
+   {
+      ecx_sim_put64(sl->mem + ECT_REG_DCSYSTIME, ecx_sim_systime(sim, p, now));
+   }
+   if (!merge)
+   {
+      if (end > ado)
+      {
+         memcpy(data, sl->mem + ado, end - ado);
+      }
+   }
+   else
+   {
+      for (i = ado; i < end; i++)
+      {
+         data[i - ado] |= sl->mem[i];
+      }
+   }
+}
+
+/** Physical datagram addressed to one slave, or one slave of a broadcast.
+ * @param[in]     sim  = simulator
+ * @param[in]     p    = slave position
+ * @param[in]     cmd  = datagram command
+ * @param[in]     ado  = physical address
+ * @param[in,out] data = datagram data
+ * @param[in]     len  = length of data
+ * @param[in]     now  = host time the frame was sent
+ * @return working counter increment
+ */
+static int ecx_sim_phys(ec_simT *sim, int p, uint8 cmd, int ado, uint8 *data, int len, int64 now)
+{
+   uint8 wdata[EC_BUFSIZE];
+
+   switch (cmd)
+   {
+      case EC_CMD_APRD:
+      case EC_CMD_FPRD:
+         ecx_sim_read(sim, p, ado, data, len, FALSE, now);
+         return 1;
+      case EC_CMD_BRD:
+         ecx_sim_read(sim, p, ado, data, len, TRUE, now);
+         return 1;
+      case EC_CMD_APWR:
+      case EC_CMD_FPWR:
+      case EC_CMD_BWR:
+         ecx_sim_write(sim, p, ado, data, len, now);
+         return 1;
+      default:
+         /* read and write, the slave writes the data as it arrived */
+         memcpy(wdata, data, len);
+         ecx_sim_read(sim, p, ado, data, len, (cmd == EC_CMD_BRW), now);
+         ecx_sim_write(sim, p, ado, wdata, len, now);
+         return 3;
+   }
+}
+
+/** Read or write the part of a logical datagram mapped by an FMMU.
+ * @param[in]     sl     = slave
+ * @param[in]     f      = FMMU
+ * @param[in]     dstart = first logical bit of datagram
+ * @param[in]     dend   = logical bit after datagram
+ * @param[in,out] data   = datagram data
+ * @param[in]     write  = TRUE to write to the slave, FALSE to read
+ * @return TRUE if the FMMU maps part of the datagram
+ */
+static boolean ecx_sim_fmmucopy(ec_simslaveT *sl, const ec_simfmmuT *f, uint64 dstart,
+                                uint64 dend, uint8 *data, boolean write)
+{
+   uint64 lo, hi, b;
+   uint32 pb, db, n;
+
+   lo = (f->lstart > dstart) ? f->lstart : dstart;
+   hi = (f->lend < dend) ? f->lend : dend;
+   if (lo >= hi)
+   {
+      return FALSE;
+   }
+   pb = f->pstart + (uint32)(lo - f->lstart);
+   db = (uint32)(lo - dstart);
+   if (((lo | hi | pb) & 0x07) == 0)
+   {
+      n = (uint32)(hi - lo) >> 3;
+      if ((pb >> 3) + n > EC_SIM_MEMSIZE)
+      {
+         n = (pb >> 3) < EC_SIM_MEMSIZE ? EC_SIM_MEMSIZE - (pb >> 3) : 0;
+      }
+      if (write)
+      {
+         memcpy(sl->mem + (pb >> 3), data + (db >> 3), n);
+      }
+      else
+      {
+         memcpy(data + (db >> 3), sl->mem + (pb >> 3), n);
+      }
+      return TRUE;
+   }
+   for (b = lo; (b < hi) && (pb < EC_SIM_MEMSIZE * 8); b++, pb++, db++)
+   {
+      if (write)
+      {
+         sl->mem[pb >> 3] = (uint8)((sl->mem[pb >> 3] & ~(1 << (pb & 7))) |
+                                    (((data[db >> 3] >> (db & 7)) & 1) << (pb & 7)));
+      }
+      else
+      {
+         data[db >> 3] = (uint8)((data[db >> 3] & ~(1 << (db & 7))) |
+                                 (((sl->mem[pb >> 3] >> (pb & 7)) & 1) << (db & 7)));
+      }
+   }
+   return TRUE;
+}
+
+/** Slave application, copy the outputs SyncManager to the inputs SyncManager.
+ * @param[in] sl = slave
+ */
+static void ecx_sim_app(ec_simslaveT *sl)
+{
+   uint8 *sm;
+   int i, out, in, outlen, inlen;
+
+   out = in = -1;
+   outlen = inlen = 0;
+   for (i = 0; i < EC_SIM_SMS; i++)
+   {
+      sm = sl->mem + ECT_REG_SM0 + (i * sizeof(ec_smt));
+      /* enabled buffered SyncManagers only, mailboxes are skipped */
+      if (!(sm[6] & 0x01) || (sm[4] & 0x03))
+      {
+         continue;
+      }
+      if (((sm[4] & 0x0c) == 0x04) && (out < 0))
+      {
+         out = ecx_sim_get16(sm);
+         outlen = ecx_sim_get16(sm + 2);
+      }
+      else if (((sm[4] & 0x0c) == 0x00) && (in < 0))
+      {
+         in = ecx_sim_get16(sm);
+         inlen = ecx_sim_get16(sm + 2);
+      }
+   }
+   if ((out >= 0) && (in >= 0) &&
+       (out + outlen <= EC_SIM_MEMSIZE) && (in + inlen <= EC_SIM_MEMSIZE))
+   {
+      memmove(sl->mem + in, sl->mem + out, (outlen < inlen) ? outlen : inlen);
+   }
+}
+
+/** Logical datagram passing one slave.
+ * @param[in]     sim  = simulator
+ * @param[in]     p    = slave position
+ * @param[in]     cmd  = datagram command
+ * @param[in]     lad  = logical address
+ * @param[in,out] data = datagram data
+ * @param[in]     len  = length of data
+ * @return working counter increment
+ */
+static int ecx_sim_logical(ec_simT *sim, int p, uint8 cmd, uint32 lad, uint8 *data, int len)
+{
+   ec_simslaveT *sl = &sim->slave[p];
+   uint64 dstart, dend;
+   boolean rd, wr;
+   int i;
+
+   rd = wr = FALSE;
+   dstart = (uint64)lad * 8;
+   dend = dstart + (uint64)len * 8;
+   for (i = 0; i < sl->nfmmu; i++)
+   {
+      if ((cmd != EC_CMD_LRD) && (sl->fmmu[i].type & 0x02))
+      {
+         wr |= ecx_sim_fmmucopy(sl, &sl->fmmu[i], dstart, dend, data, TRUE);
+      }
+   }
+   for (i = 0; i < sl->nfmmu; i++)
+   {
+      if ((cmd != EC_CMD_LWR) && (sl->fmmu[i].type & 0x01))
+      {
+         rd |= ecx_sim_fmmucopy(sl, &sl->fmmu[i], dstart, dend, data, FALSE);
+      }
+   }
+   if (wr && ((ecx_sim_get16(sl->mem + ECT_REG_ALSTAT) & 0x0f) == EC_STATE_OPERATIONAL))
+   {
+      ecx_sim_app(sl);
+   }
+   if (cmd == EC_CMD_LRW)
+   {
+      return (rd ? 1 : 0) + (wr ? 2 : 0);
+   }
+   return (rd || wr) ? 1 : 0;
+}
+
+/** Process one datagram by all slaves.
+ * @param[in]     sim = simulator
+ * @param[in,out] dg  = datagram, starting with the command
+ * @param[in]     len = length of datagram data
+ * @param[in]     now = host time the frame was sent
+ * @return working counter of datagram
+ */
+static int ecx_sim_datagram(ec_simT *sim, uint8 *dg, int len, int64 now)
+{
+   uint8 cmd, *data;
+   uint16 adp, ado;
+   int wkc, n, p, i;
+
+   cmd = dg[0];
+   adp = ecx_sim_get16(dg + 2);
+   ado = ecx_sim_get16(dg + 4);
+   data = dg + EC_SIM_DGHEADER;
+   wkc = ecx_sim_get16(data + len);
+   n = sim->slavecount;
+   switch (cmd)
+   {
+      case EC_CMD_APRD:
+      case EC_CMD_APWR:
+      case EC_CMD_APRW:
+      case EC_CMD_FPRD:
+      case EC_CMD_FPWR:
+      case EC_CMD_FPRW:
+         if ((cmd == EC_CMD_APRD) || (cmd == EC_CMD_APWR) || (cmd == EC_CMD_APRW))
+         {
+            /* each slave increments the position, the one seeing 0 is addressed */
+            p = (uint16)(0 - adp);
+            ecx_sim_put16(dg + 2, (uint16)(adp + n));
+         }
+         else
+         {
+            p = sim->adrmap[adp] - 1;
+         }
+         if ((p >= 0) && (p < n))
+         {
+            wkc += ecx_sim_phys(sim, p, cmd, ado, data, len, now);
+         }
+         break;
+      case EC_CMD_ARMW:
+      case EC_CMD_FRMW:
+         if (cmd == EC_CMD_ARMW)
+         {
+            p = (uint16)(0 - adp);
+            ecx_sim_put16(dg + 2, (uint16)(adp + n));
+         }
+         else
+         {
+            p = sim->adrmap[adp] - 1;
+         }
+         /* addressed slave reads, all others write */
+         for (i = 0; i < n; i++)
+         {
+            if (i == p)
+            {
+               ecx_sim_read(sim, i, ado, data, len, FALSE, now);
+            }
+            else
+            {
+               ecx_sim_write(sim, i, ado, data, len, now);
+            }
+            wkc++;
+         }
+         break;
+      case EC_CMD_BRD:
+      case EC_CMD_BWR:
+      case EC_CMD_BRW:
+         for (i = 0; i < n; i++)
+         {
+            wkc += ecx_sim_phys(sim, i, cmd, ado, data, len, now);
+         }
+         ecx_sim_put16(dg + 2, (uint16)(adp + n));
+         break;
+      case EC_CMD_LRD:
+      case EC_CMD_LWR:
+      case EC_CMD_LRW:
+         for (i = 0; i < n; i++)
+         {
+            wkc += ecx_sim_logical(sim, i, cmd, ecx_sim_get32(dg + 2), data, len);
+         }
+         break;
+      default:
+         break;
+   }
+   ecx_sim_put16(data + len, (uint16)wkc);
+
+   return wkc;
+}
+
+/** Process an EtherCAT frame by the simulated slaves, in place.
+ * @param[in]     sim    = simulator
+ * @param[in,out] frame  = EtherCAT frame, starting after the ethernet header
+ * @param[in]     length = length of frame
+ * @return working counter of last datagram or EC_NOFRAME if it is no valid frame
+ */
+int ecx_sim_process(ec_simT *sim, uint8 *frame, int length)
+{
+   int pos, dlength, wkc;
+   boolean more;
+   int64 now;
+
+   if ((length < (int)(EC_HEADERSIZE + EC_WKCSIZE)) || ((frame[1] >> 4) != 0x01))
+   {
+      return EC_NOFRAME;
+   }
+   wkc = EC_NOFRAME;
+   now = ecx_sim_now();
+   pthread_mutex_lock(&sim->mutex);
+   pos = EC_ELENGTHSIZE;
+   do
+   {
+      if (pos + EC_SIM_DGHEADER + (int)EC_WKCSIZE > length)
+      {
+         break;
+      }
+      dlength = ecx_sim_get16(frame + pos + 6);
+      more = (dlength & EC_DATAGRAMFOLLOWS) != 0;
+      dlength &= 0x07ff;
+      if (pos + EC_SIM_DGHEADER + dlength + (int)EC_WKCSIZE > length)
+      {
+         break;
+      }
+      wkc = ecx_sim_datagram(sim, frame + pos, dlength, now);
+      pos += EC_SIM_DGHEADER + dlength + EC_WKCSIZE;
+   } while (more);
+   pthread_mutex_unlock(&sim->mutex);
+
+   return wkc;
+}
+
+/** Replace the SII EEPROM image of a slave.
+ * @param[in] sim   = simulator
+ * @param[in] slave = slave number, 1 = first
+ * @param[in] sii   = SII image, copied
+ * @param[in] size  = size of image in bytes
+ * @return 1 on success, 0 on failure
+ */
+int ecx_sim_setsii(ec_simT *sim, int slave, const uint8 *sii, int size)
+{
+   ec_simslaveT *sl;
+   uint8 *buf;
+
+   if ((slave < 1) || (slave > sim->slavecount) || (size <= 0))
+   {
+      return 0;
+   }
+   buf = (uint8 *)malloc(size);
+   if (buf == NULL)
+   {
+      return 0;
+   }
+   memcpy(buf, sii, size);
+   sl = &sim->slave[slave - 1];
+   pthread_mutex_lock(&sim->mutex);
+   free(sl->sii);
+   sl->sii = buf;
+   sl->siisize = size;
+   pthread_mutex_unlock(&sim->mutex);
+
+   return 1;
+}
+
+/** Set the processing delay of a slave, it shifts the DC receive times of
+ * the slaves after it and adds to ec_simT.linedelay.
+ * @param[in] sim   = simulator
+ * @param[in] slave = slave number, 1 = first
+ * @param[in] delay = processing delay in ns
+ * @return 1 on success, 0 on failure
+ */
+int ecx_sim_setdelay(ec_simT *sim, int slave, int delay)
+{
+   ec_simslaveT *last;
+   int p;
+
+   if ((slave < 1) || (slave > sim->slavecount) || (delay < 0))
+   {
+      return 0;
+   }
+   pthread_mutex_lock(&sim->mutex);
+   sim->slave[slave - 1].delay = delay;
+   for (p = slave; p < sim->slavecount; p++)
+   {
+      sim->slave[p].arrival = sim->slave[p - 1].arrival + sim->slave[p - 1].delay;
+   }
+   /* forward through all slaves, back through all but the last */
+   last = &sim->slave[sim->slavecount - 1];
+   sim->linedelay = 2 * last->arrival + last->delay;
+   pthread_mutex_unlock(&sim->mutex);
+
+   return 1;
+}
+
+/** Create a line of simulated slaves in INIT, all with the same generated SII.
+ * @param[out] sim        = simulator
+ * @param[in]  slavecount = number of slaves
+ * @param[in]  obytes     = output bytes of each slave
+ * @param[in]  ibytes     = input bytes of each slave
+ * @return 1 on success, 0 on failure
+ */
+int ecx_sim_create(ec_simT *sim, int slavecount, int obytes, int ibytes)
+{
+   uint8 *sii;
+   int p, size, rval;
+
+   memset(sim, 0, sizeof(*sim));
+   if ((slavecount < 1) || (slavecount > 0xfffe) || (obytes < 0) || (ibytes < 0) ||
+       (obytes + ibytes > EC_SIM_MEMSIZE - EC_SIM_PDRAM))
+   {
+      return 0;
+   }
+   pthread_mutex_init(&sim->mutex, NULL);
+   sim->linedelay = (int64)(2 * slavecount - 1) * EC_SIM_FWDDELAY;
+   sim->slave = (ec_simslaveT *)calloc(slavecount, sizeof(ec_simslaveT));
+   sim->adrmap = (uint16 *)calloc(0x10000, sizeof(uint16));
+   sii = (uint8 *)malloc(EC_SIM_SIISIZE(obytes, ibytes));
+   rval = 0;
+   if (sim->slave && sim->adrmap && sii)
+   {
+      sim->slavecount = slavecount;
+      /* product code tells layouts apart, slaves with the same are configured alike */
+      size = ecx_sim_gensii(sii, EC_SIM_SIISIZE(obytes, ibytes), "SOEM simulated slave",
+                            EC_SIM_VENDOR, ((uint32)obytes << 16) | (uint32)ibytes,
+                            obytes, ibytes);
+      rval = 1;
+      for (p = 0; p < slavecount; p++)
+      {
+         sim->slave[p].clockofs = (int64)(p + 1) * EC_SIM_CLOCKSTEP;
+         sim->slave[p].delay = EC_SIM_FWDDELAY;
+         sim->slave[p].arrival = (int64)p * EC_SIM_FWDDELAY;
+         ecx_sim_reset(sim, p);
+         /* serial number */
+         ecx_sim_put32(sii + ((ECT_SII_REV + 2) << 1), (uint32)(p + 1));
+         rval &= ecx_sim_setsii(sim, p + 1, sii, size);
+      }
+   }
+   free(sii);
+   if (!rval)
+   {
+      ecx_sim_destroy(sim);
+   }
+
+   return rval;
+}
+
+/** Free all resources of the simulator.
+ * @param[in] sim = simulator
+ */
+void ecx_sim_destroy(ec_simT *sim)
+{
+   int p;
+
+   if (sim->slave)
+   {
+      for (p = 0; p < sim->slavecount; p++)
+      {
+         free(sim->slave[p].sii);
+      }
+   }
+   free(sim->slave);
+   free(sim->adrmap);
+   pthread_mutex_destroy(&sim->mutex);
+   memset(sim, 0, sizeof(*sim));
+}
+
+/** Clock of the software frame timestamps, see ecx_getframetime().
+ * @return realtime in ns
+ */
+static int64 ecx_sim_realtime(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_REALTIME, &ts);
+   return (int64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/** Open the simulator transport, port.transportdata points to the simulator.
+ * There is no secondary port.
+ */
+static int ecx_sim_setup(ecx_portt *port, const char *ifname, int secondary)
+{
+   (void)ifname;
+   return (!secondary && port->transportdata) ? 1 : 0;
+}
+
+static int ecx_sim_close(ecx_portt *port)
+{
+   (void)port;
+   return 0;
+}
+
+/** Transmit frame of index, the slaves process it and it is returned at once
+ * in the rx buffer of the index.
+ */
+static int ecx_sim_outframe(ecx_portt *port, uint8 idx, int stacknumber)
+{
+   ec_simT *sim = (ec_simT *)port->transportdata;
+   ec_etherheadert *ehp;
+   int len;
+
+   if (stacknumber || (idx >= port->bufnr))
+   {
+      return -1;
+   }
+   len = port->txbuflength[idx];
+   ehp = (ec_etherheadert *)port->txbuf[idx];
+   if (port->portmode & ECT_PORTMODE_TIMESTAMP)
+   {
+      port->txtime[idx] = ecx_sim_realtime();
+   }
+   port->rxbufstat[idx] = EC_BUF_TX;
+   memcpy(port->rxbuf[idx], &port->txbuf[idx][ETH_HEADERSIZE], len - ETH_HEADERSIZE);
+   ecx_sim_process(sim, port->rxbuf[idx], len - ETH_HEADERSIZE);
+   port->rxsa[idx] = ntohs(ehp->sa1);
+   port->rxtime[idx] = (port->portmode & ECT_PORTMODE_TIMESTAMP) ? ecx_sim_realtime() : 0;
+   __atomic_store_n(&port->rxbufstat[idx], EC_BUF_RCVD, __ATOMIC_RELEASE);
+
+   return len;
+}
+
+/** Non blocking receive of frame of index, returns its WKC once it was
+ * processed by ecx_sim_outframe().
+ */
+static int ecx_sim_inframe(ecx_portt *port, uint8 idx, int stacknumber)
+{
+   uint16 l;
+   int rval;
+
+   rval = EC_NOFRAME;
+   if (!stacknumber && (idx < port->bufnr) &&
+       (__atomic_load_n(&port->rxbufstat[idx], __ATOMIC_ACQUIRE) == EC_BUF_RCVD))
+   {
+      l = port->rxbuf[idx][0] + ((uint16)(port->rxbuf[idx][1] & 0x0f) << 8);
+      rval = port->rxbuf[idx][l] + ((uint16)port->rxbuf[idx][l + 1] << 8);
+      port->rxbufstat[idx] = EC_BUF_COMPLETE;
+   }
+
+   return rval;
+}
+
+/** In process slave simulator, see ecx_sim_create(). */
+const ec_transportT ecx_simtransport =
+{
+   "sim",
+   ecx_sim_setup,
+   ecx_sim_close,
+   ecx_sim_outframe,
+   ecx_sim_inframe,
+   NULL,
+   NULL
+};
@@ -0,0 +1,100 @@
+/*
+ * Licensed under the GNU General Public License version 2 with exceptions. See
+ * LICENSE file in the project root for full license information
+ */
+
+/** \file
+ * \brief
+ * Headerfile for nicdrv_sim.c
+ */
+
+#ifndef _nicdrv_simh_
+#define _nicdrv_simh_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <pthread.h>
+#include "nicdrv.h"
+
+/** size of the register and process data memory of a simulated slave */
+#define EC_SIM_MEMSIZE     0x2000
+/** start of the process data memory of a simulated slave */
+#define EC_SIM_PDRAM       0x1000
+/** number of FMMUs of a simulated slave */
+#define EC_SIM_FMMUS       8
+/** number of SyncManagers of a simulated slave */
+#define EC_SIM_SMS         8
+/** default processing delay of one simulated slave in ns */
+#define EC_SIM_FWDDELAY    500
+/** vendor ID in the generated SII of simulated slaves */
+#define EC_SIM_VENDOR      0x00000a5e
+/** buffer size needed by ecx_sim_gensii() */
+#define EC_SIM_SIISIZE(obytes, ibytes) (512 + 16 * ((obytes) + (ibytes)))
+
+/** active FMMU of a simulated slave, decoded from its registers */
+typedef struct
+{
+   /** first logical bit */
+   uint64      lstart;
+   /** logical bit after the last mapped bit */
+   uint64      lend;
+   /** first physical bit */
+   uint32      pstart;
+   /** 1 = read, 2 = write, 3 = read/write */
+   uint8       type;
+} ec_simfmmuT;
+
+/** simulated slave */
+typedef struct
+{
+   /** register and process data memory */
+   uint8       mem[EC_SIM_MEMSIZE];
+   /** SII EEPROM image */
+   uint8       *sii;
+   /** size of SII image in bytes */
+   int         siisize;
+   /** offset of the local clock to the host clock in ns */
+   int64       clockofs;
+   /** processing delay in ns */
+   int         delay;
+   /** time in ns a frame takes from the master to this slave */
+   int64       arrival;
+   /** active FMMUs */
+   ec_simfmmuT fmmu[EC_SIM_FMMUS];
+   /** number of active FMMUs */
+   int         nfmmu;
+} ec_simslaveT;
+
+/** simulated line of slaves, see ecx_sim_create() */
+typedef struct
+{
+   /** number of slaves */
+   int          slavecount;
+   /** slaves in line order */
+   ec_simslaveT *slave;
+   /** position + 1 of the slave by configured station address, 0 if none */
+   uint16       *adrmap;
+   /** time in ns a frame takes through the line and back to the master */
+   int64        linedelay;
+   /** serializes frame processing */
+   pthread_mutex_t mutex;
+} ec_simT;
+
+int ecx_sim_create(ec_simT *sim, int slavecount, int obytes, int ibytes);
+void ecx_sim_destroy(ec_simT *sim);
+int ecx_sim_setsii(ec_simT *sim, int slave, const uint8 *sii, int size);
+int ecx_sim_setdelay(ec_simT *sim, int slave, int delay);
+int ecx_sim_gensii(uint8 *sii, int size, const char *name, uint32 vendor,
+                   uint32 product, int obytes, int ibytes);
+int ecx_sim_process(ec_simT *sim, uint8 *frame, int length);
+
+extern const ec_transportT ecx_simtransport;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,459 @@
+/*
+ * Licensed under the GNU General Public License version 2 with exceptions. See
+ * LICENSE file in the project root for full license information
+ */
+
+/** \file
+ * \brief
+ * EtherCAT AF_XDP transport for the Linux RAW socket driver.
+ *
+ * Instead of a PF_PACKET socket the NIC is driven through an AF_XDP socket.
+ * A small XDP program, loaded with the plain bpf() syscall so no extra
+ * libraries are needed, redirects all frames with the EtherCAT ethertype on
+ * rx queue 0 to the socket. Every other frame is passed to the normal network
+ * stack. Received and transmitted frames live in a UMEM shared with the
+ * kernel. Polling the receive ring is a memory read, only transmit needs a
+ * syscall to kick the kernel.
+ *
+ * Native (driver) XDP mode is tried first, generic (SKB) mode is used if the
+ * driver has no XDP support or if it is forced by the caller, f.e. for a veth
+ * pair. The NIC should be configured for one rx queue, as EtherCAT frames
+ * arriving on other queues are not redirected. Kernel 5.9 or newer is needed
+ * for bpf link based XDP attachment.
+ *
+ * The functions are used by nicdrv.c when ECT_PORTMODE_XDP is requested.
+ */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <linux/if_link.h>
+#include <linux/if_xdp.h>
+#include <linux/bpf.h>
+#include <pthread.h>
+
+#include "oshw.h"
+#include "osal.h"
+
+#ifndef AF_XDP
+#define AF_XDP 44
+#endif
+#ifndef SOL_XDP
+#define SOL_XDP 283
+#endif
+
+/** size of the XSKMAP, only rx queue 0 is used */
+#define EC_XDP_MAXQUEUES   1
+
+/** Wrapper for the bpf syscall, not provided by libc.
+ * @param[in] cmd         = bpf command
+ * @param[in] attr        = command attributes
+ * @return syscall result
+ */
+static int ecx_bpf(int cmd, union bpf_attr *attr)
+{
+   return syscall(__NR_bpf, cmd, attr, sizeof(*attr));
+}
+
+/** Load the XDP program that redirects EtherCAT frames to the XSKMAP.
+ * @param[in] mapfd       = XSKMAP file descriptor
+ * @return program file descriptor or -1
+ */
+static int ecx_xdp_loadprog(int mapfd)
+{
+   union bpf_attr attr;
+   struct bpf_insn prog[] =
+   {
+      /* r2 = ctx->data_end, r3 = ctx->data */
+      { BPF_LDX | BPF_MEM | BPF_W, BPF_REG_2, BPF_REG_1, offsetof(struct xdp_md, data_end), 0 },
+      { BPF_LDX | BPF_MEM | BPF_W, BPF_REG_3, BPF_REG_1, offsetof(struct xdp_md, data), 0 },
+      /* pass frames shorter than an ethernet header */
+      { BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_4, BPF_REG_3, 0, 0 },
+      { BPF_ALU64 | BPF_ADD | BPF_K, BPF_REG_4, 0, 0, ETH_HEADERSIZE },
+      { BPF_JMP | BPF_JGT | BPF_X, BPF_REG_4, BPF_REG_2, 8, 0 },
+      /* pass frames that are not EtherCAT */
+      { BPF_LDX | BPF_MEM | BPF_H, BPF_REG_4, BPF_REG_3, 12, 0 },
+      { BPF_JMP | BPF_JNE | BPF_K, BPF_REG_4, 0, 6, htons(ETH_P_ECAT) },
+      /* return bpf_redirect_map(xskmap, ctx->rx_queue_index, XDP_PASS) */
+      { BPF_LDX | BPF_MEM | BPF_W, BPF_REG_2, BPF_REG_1, offsetof(struct xdp_md, rx_queue_index), 0 },
+      { BPF_LD | BPF_DW | BPF_IMM, BPF_REG_1, BPF_PSEUDO_MAP_FD, 0, mapfd },
+      { 0, 0, 0, 0, 0 },
+      { BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_3, 0, 0, XDP_PASS },
+      { BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_redirect_map },
+      { BPF_JMP | BPF_EXIT, 0, 0, 0, 0 },
+      /* return XDP_PASS */
+      { BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_0, 0, 0, XDP_PASS },
+      { BPF_JMP | BPF_EXIT, 0, 0, 0, 0 }
+   };
+
+   memset(&attr, 0, sizeof(attr));
+   attr.prog_type = BPF_PROG_TYPE_XDP;
+   attr.insns = (uint64)(uintptr_t)prog;
+   attr.insn_cnt = sizeof(prog) / sizeof(prog[0]);
+   attr.license = (uint64)(uintptr_t)"GPL";
+
+   return ecx_bpf(BPF_PROG_LOAD, &attr);
+}
+
+/** Map one of the AF_XDP rings into user space.
+ * @param[in]  sock       = AF_XDP socket
+ * @param[out] ring       = ring to set up
+ * @param[in]  off        = ring offsets reported by the kernel
+ * @param[in]  n          = number of descriptors
+ * @param[in]  descsize   = size of one descriptor
+ * @param[in]  pgoff      = mmap page offset selecting the ring
+ * @return >0 if succeeded
+ */
+static int ecx_xdp_mapring(int sock, ec_xskringT *ring, const struct xdp_ring_offset *off,
+                           uint32 n, size_t descsize, off_t pgoff)
+{
+   uint8 *p;
+
+   ring->mapsize = off->desc + n * descsize;
+   p = mmap(NULL, ring->mapsize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, sock, pgoff);
+   if (p == MAP_FAILED)
+   {
+      return 0;
+   }
+   ring->map = p;
+   ring->producer = (uint32 *)(p + off->producer);
+   ring->consumer = (uint32 *)(p + off->consumer);
+   ring->desc = p + off->desc;
+   ring->mask = n - 1;
+
+   return 1;
+}
+
+/** Unmap one of the AF_XDP rings.
+ * @param[in] ring        = ring to release
+ */
+static void ecx_xdp_unmapring(ec_xskringT *ring)
+{
+   if (ring->map)
+   {
+      munmap(ring->map, ring->mapsize);
+      ring->map = NULL;
+   }
+}
+
+/** Register UMEM, create and map the rings and bind the socket to the NIC.
+ * @param[in] xsk         = AF_XDP socket state
+ * @param[in] sock        = AF_XDP socket
+ * @param[in] ifindex     = index of NIC
+ * @param[in] skbmode     = if >0 then force copy mode
+ * @return >0 if succeeded
+ */
+static int ecx_xdp_setupsock(ec_xskT *xsk, int sock, int ifindex, int skbmode)
+{
+   int i;
+   uint32 n;
+   uint64 *fill;
+   socklen_t optlen;
+   struct xdp_umem_reg umemreg;
+   struct xdp_mmap_offsets off;
+   struct sockaddr_xdp sxdp;
+
+   /* UMEM, rx frames first followed by tx frames */
+   xsk->umemsize = (EC_XDP_RXFRAMES + EC_XDP_TXFRAMES) * EC_XDP_FRAMESIZE;
+   xsk->umem = mmap(NULL, xsk->umemsize, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+   if (xsk->umem == MAP_FAILED)
+   {
+      xsk->umem = NULL;
+      return 0;
+   }
+   memset(&umemreg, 0, sizeof(umemreg));
+   umemreg.addr = (uint64)(uintptr_t)xsk->umem;
+   umemreg.len = xsk->umemsize;
+   umemreg.chunk_size = EC_XDP_FRAMESIZE;
+   umemreg.headroom = 0;
+   if (setsockopt(sock, SOL_XDP, XDP_UMEM_REG, &umemreg, sizeof(umemreg)) != 0)
+   {
+      return 0;
+   }
+   n = EC_XDP_RXFRAMES;
+   if ((setsockopt(sock, SOL_XDP, XDP_UMEM_FILL_RING, &n, sizeof(n)) != 0) ||
+       (setsockopt(sock, SOL_XDP, XDP_RX_RING, &n, sizeof(n)) != 0))
+   {
+      return 0;
+   }
+   n = EC_XDP_TXFRAMES;
+   if ((setsockopt(sock, SOL_XDP, XDP_UMEM_COMPLETION_RING, &n, sizeof(n)) != 0) ||
+       (setsockopt(sock, SOL_XDP, XDP_TX_RING, &n, sizeof(n)) != 0))
+   {
+      return 0;
+   }
+   optlen = sizeof(off);
+   if (getsockopt(sock, SOL_XDP, XDP_MMAP_OFFSETS, &off, &optlen) != 0)
+   {
+      return 0;
+   }
+   if (!ecx_xdp_mapring(sock, &(xsk->rx), &off.rx, EC_XDP_RXFRAMES,
+                        sizeof(struct xdp_desc), XDP_PGOFF_RX_RING) ||
+       !ecx_xdp_mapring(sock, &(xsk->tx), &off.tx, EC_XDP_TXFRAMES,
+                        sizeof(struct xdp_desc), XDP_PGOFF_TX_RING) ||
+       !ecx_xdp_mapring(sock, &(xsk->fq), &off.fr, EC_XDP_RXFRAMES,
+                        sizeof(uint64), XDP_UMEM_PGOFF_FILL_RING) ||
+       !ecx_xdp_mapring(sock, &(xsk->cq), &off.cr, EC_XDP_TXFRAMES,
+                        sizeof(uint64), XDP_UMEM_PGOFF_COMPLETION_RING))
+   {
+      return 0;
+   }
+   /* hand all rx frames to the kernel */
+   fill = xsk->fq.desc;
+   for (i = 0; i < EC_XDP_RXFRAMES; i++)
+   {
+      fill[i] = (uint64)i * EC_XDP_FRAMESIZE;
+   }
+   __atomic_store_n(xsk->fq.producer, EC_XDP_RXFRAMES, __ATOMIC_RELEASE);
+   for (i = 0; i < EC_XDP_TXFRAMES; i++)
+   {
+      xsk->txfree[i] = (uint64)(EC_XDP_RXFRAMES + i) * EC_XDP_FRAMESIZE;
+   }
+   xsk->ntxfree = EC_XDP_TXFRAMES;
+   memset(&sxdp, 0, sizeof(sxdp));
+   sxdp.sxdp_family = AF_XDP;
+   sxdp.sxdp_ifindex = ifindex;
+   sxdp.sxdp_queue_id = 0;
+   sxdp.sxdp_flags = skbmode ? XDP_COPY : 0;
+
+   return (bind(sock, (struct sockaddr *)&sxdp, sizeof(sxdp)) == 0);
+}
+
+/** Create the XSKMAP holding the socket, load the XDP program and attach it
+ * to the NIC.
+ * @param[in] xsk         = AF_XDP socket state
+ * @param[in] sock        = AF_XDP socket
+ * @param[in] ifindex     = index of NIC
+ * @param[in] skbmode     = if >0 then use generic XDP, otherwise try native XDP first
+ * @return >0 if succeeded
+ */
+static int ecx_xdp_attach(ec_xskT *xsk, int sock, int ifindex, int skbmode)
+{
+   uint32 key;
+   union bpf_attr attr;
+
+   /* XSKMAP with the socket on queue 0 */
+   memset(&attr, 0, sizeof(attr));
+   attr.map_type = BPF_MAP_TYPE_XSKMAP;
+   attr.key_size = sizeof(uint32);
+   attr.value_size = sizeof(int);
+   attr.max_entries = EC_XDP_MAXQUEUES;
+   xsk->mapfd = ecx_bpf(BPF_MAP_CREATE, &attr);
+   if (xsk->mapfd < 0)
+   {
+      return 0;
+   }
+   key = 0;
+   memset(&attr, 0, sizeof(attr));
+   attr.map_fd = xsk->mapfd;
+   attr.key = (uint64)(uintptr_t)&key;
+   attr.value = (uint64)(uintptr_t)&sock;
+   if (ecx_bpf(BPF_MAP_UPDATE_ELEM, &attr) != 0)
+   {
+      return 0;
+   }
+   xsk->progfd = ecx_xdp_loadprog(xsk->mapfd);
+   if (xsk->progfd < 0)
+   {
+      return 0;
+   }
+   /* attach program, native mode first unless generic mode is requested */
+   memset(&attr, 0, sizeof(attr));
+   attr.link_create.prog_fd = xsk->progfd;
+   attr.link_create.target_ifindex = ifindex;
+   attr.link_create.attach_type = BPF_XDP;
+   if (!skbmode)
+   {
+      attr.link_create.flags = XDP_FLAGS_DRV_MODE;
+      xsk->linkfd = ecx_bpf(BPF_LINK_CREATE, &attr);
+   }
+   if (xsk->linkfd < 0)
+   {
+      attr.link_create.flags = XDP_FLAGS_SKB_MODE;
+      xsk->linkfd = ecx_bpf(BPF_LINK_CREATE, &attr);
+   }
+
+   return (xsk->linkfd >= 0);
+}
+
+/** Create AF_XDP socket, UMEM and rings, and attach the XDP program to the NIC.
+ * @param[out] xsk        = AF_XDP socket state
+ * @param[in]  ifindex    = index of NIC
+ * @param[in]  skbmode    = if >0 then use generic XDP, otherwise try native XDP first
+ * @return socket handle or -1 if AF_XDP is not available
+ */
+int ecx_xdp_setup(ec_xskT *xsk, int ifindex, int skbmode)
+{
+   int sock;
+
+   memset(xsk, 0, sizeof(*xsk));
+   xsk->progfd = -1;
+   xsk->mapfd = -1;
+   xsk->linkfd = -1;
+   pthread_mutex_init(&(xsk->tx_mutex), NULL);
+   sock = socket(AF_XDP, SOCK_RAW, 0);
+   if (sock < 0)
+   {
+      return -1;
+   }
+   if (!ecx_xdp_setupsock(xsk, sock, ifindex, skbmode) ||
+       !ecx_xdp_attach(xsk, sock, ifindex, skbmode))
+   {
+      ecx_xdp_close(xsk);
+      close(sock);
+      return -1;
+   }
+
+   return sock;
+}
+
+/** Detach XDP program and release UMEM, rings and the transmit mutex. The
+ * socket itself is closed by the caller.
+ * @param[in] xsk         = AF_XDP socket state
+ */
+void ecx_xdp_close(ec_xskT *xsk)
+{
+   if (xsk->linkfd >= 0)
+   {
+      close(xsk->linkfd);
+      xsk->linkfd = -1;
+   }
+   if (xsk->progfd >= 0)
+   {
+      close(xsk->progfd);
+      xsk->progfd = -1;
+   }
+   if (xsk->mapfd >= 0)
+   {
+      close(xsk->mapfd);
+      xsk->mapfd = -1;
+   }
+   ecx_xdp_unmapring(&(xsk->rx));
+   ecx_xdp_unmapring(&(xsk->tx));
+   ecx_xdp_unmapring(&(xsk->fq));
+   ecx_xdp_unmapring(&(xsk->cq));
+   if (xsk->umem)
+   {
+      munmap(xsk->umem, xsk->umemsize);
+      xsk->umem = NULL;
+   }
+   pthread_mutex_destroy(&(xsk->tx_mutex));
+}
+
+/** Take transmitted frames back from the completion ring. Must be called
+ * with tx_mutex locked.
+ * @param[in] xsk         = AF_XDP socket state
+ */
+static void ecx_xdp_reclaim(ec_xskT *xsk)
+{
+   uint32 cons, prod;
+   uint64 *comp;
+
+   comp = xsk->cq.desc;
+   cons = *xsk->cq.consumer;
+   prod = __atomic_load_n(xsk->cq.producer, __ATOMIC_ACQUIRE);
+   while ((cons != prod) && (xsk->ntxfree < EC_XDP_TXFRAMES))
+   {
+      xsk->txfree[xsk->ntxfree++] = comp[cons & xsk->cq.mask];
+      cons++;
+   }
+   __atomic_store_n(xsk->cq.consumer, cons, __ATOMIC_RELEASE);
+}
+
+/** Start transmission of all frames queued in the tx ring.
+ * @param[in] xsk         = AF_XDP socket state
+ * @param[in] sock        = AF_XDP socket
+ */
+void ecx_xdp_kick(ec_xskT *xsk, int sock)
+{
+   (void)xsk;
+   sendto(sock, NULL, 0, MSG_DONTWAIT, NULL, 0);
+}
+
+/** Copy a frame into a free UMEM tx frame and queue it in the tx ring.
+ * @param[in] xsk         = AF_XDP socket state
+ * @param[in] sock        = AF_XDP socket
+ * @param[in] buf         = frame to transmit
+ * @param[in] len         = length of frame
+ * @param[in] kick        = TRUE to start transmission of queued frames
+ * @return length of frame or -1 if the tx ring is full
+ */
+int ecx_xdp_send(ec_xskT *xsk, int sock, const void *buf, int len, int kick)
+{
+   struct xdp_desc *desc;
+   uint32 prod, cons;
+   uint64 addr;
+   int rval;
+
+   rval = -1;
+   pthread_mutex_lock(&(xsk->tx_mutex));
+   ecx_xdp_reclaim(xsk);
+   if (xsk->ntxfree == 0)
+   {
+      /* all frames in flight, let the kernel complete them */
+      ecx_xdp_kick(xsk, sock);
+      ecx_xdp_reclaim(xsk);
+   }
+   prod = *xsk->tx.producer;
+   cons = __atomic_load_n(xsk->tx.consumer, __ATOMIC_ACQUIRE);
+   if ((xsk->ntxfree > 0) && ((prod - cons) <= xsk->tx.mask) && (len <= EC_XDP_FRAMESIZE))
+   {
+      addr = xsk->txfree[--xsk->ntxfree];
+      memcpy(xsk->umem + addr, buf, len);
+      desc = &((struct xdp_desc *)xsk->tx.desc)[prod & xsk->tx.mask];
+      desc->addr = addr;
+      desc->len = len;
+      desc->options = 0;
+      __atomic_store_n(xsk->tx.producer, prod + 1, __ATOMIC_RELEASE);
+      rval = len;
+   }
+   pthread_mutex_unlock(&(xsk->tx_mutex));
+   if (kick && (rval > 0))
+   {
+      ecx_xdp_kick(xsk, sock);
+   }
+
+   return rval;
+}
+
+/** Non blocking read of the rx ring. The frame stays in the UMEM until it is
+ * released with ecx_xdp_release().
+ * @param[in] xsk         = AF_XDP socket state
+ * @return pointer to received frame or NULL if rx ring is empty
+ */
+uint8 *ecx_xdp_peek(ec_xskT *xsk)
+{
+   struct xdp_desc *desc;
+   uint32 cons;
+
+   cons = *xsk->rx.consumer;
+   if (cons == __atomic_load_n(xsk->rx.producer, __ATOMIC_ACQUIRE))
+   {
+      return NULL;
+   }
+   desc = &((struct xdp_desc *)xsk->rx.desc)[cons & xsk->rx.mask];
+
+   return xsk->umem + desc->addr;
+}
+
+/** Release the frame at the head of the rx ring and give its UMEM frame
+ * back to the kernel through the fill ring.
+ * @param[in] xsk         = AF_XDP socket state
+ */
+void ecx_xdp_release(ec_xskT *xsk)
+{
+   struct xdp_desc *desc;
+   uint32 cons, prod;
+
+   cons = *xsk->rx.consumer;
+   desc = &((struct xdp_desc *)xsk->rx.desc)[cons & xsk->rx.mask];
+   prod = *xsk->fq.producer;
+   ((uint64 *)xsk->fq.desc)[prod & xsk->fq.mask] = desc->addr & ~((uint64)EC_XDP_FRAMESIZE - 1);
+   __atomic_store_n(xsk->fq.producer, prod + 1, __ATOMIC_RELEASE);
+   __atomic_store_n(xsk->rx.consumer, cons + 1, __ATOMIC_RELEASE);
+}
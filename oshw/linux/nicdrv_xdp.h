@@ -0,0 +1,86 @@
+/*
+ * Licensed under the GNU General Public License version 2 with exceptions. See
+ * LICENSE file in the project root for full license information
+ */
+
+/** \file
+ * \brief
+ * Headerfile for nicdrv_xdp.c
+ */
+
+#ifndef _nicdrv_xdph_
+#define _nicdrv_xdph_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stddef.h>
+#include <pthread.h>
+
+/** number of frames in the UMEM used for receive */
+#define EC_XDP_RXFRAMES    64
+/** number of frames in the UMEM used for transmit */
+#define EC_XDP_TXFRAMES    64
+/** size of one UMEM frame */
+#define EC_XDP_FRAMESIZE   2048
+
+/** one of the four AF_XDP rings, mapped from the kernel */
+typedef struct
+{
+   /** producer index shared with the kernel */
+   uint32      *producer;
+   /** consumer index shared with the kernel */
+   uint32      *consumer;
+   /** ring descriptors, struct xdp_desc for rx/tx and uint64 for fill/completion */
+   void        *desc;
+   /** number of descriptors - 1 */
+   uint32      mask;
+   /** start of mapping */
+   void        *map;
+   /** size of mapping */
+   size_t      mapsize;
+} ec_xskringT;
+
+/** AF_XDP socket with its UMEM, rings and XDP program */
+typedef struct
+{
+   /** UMEM area holding all rx and tx frames, NULL if AF_XDP is not used */
+   uint8       *umem;
+   /** size of UMEM area */
+   size_t      umemsize;
+   /** receive ring */
+   ec_xskringT rx;
+   /** transmit ring */
+   ec_xskringT tx;
+   /** fill ring, returns rx frames to the kernel */
+   ec_xskringT fq;
+   /** completion ring, returns tx frames from the kernel */
+   ec_xskringT cq;
+   /** UMEM addresses of tx frames not in use */
+   uint64      txfree[EC_XDP_TXFRAMES];
+   /** number of entries in txfree */
+   int         ntxfree;
+   /** XDP program redirecting EtherCAT frames to the socket */
+   int         progfd;
+   /** XSKMAP used by the XDP program */
+   int         mapfd;
+   /** bpf link attaching the program to the NIC */
+   int         linkfd;
+   /** protects tx ring and txfree */
+   pthread_mutex_t tx_mutex;
+} ec_xskT;
+
+int ecx_xdp_setup(ec_xskT *xsk, int ifindex, int skbmode);
+void ecx_xdp_close(ec_xskT *xsk);
+int ecx_xdp_send(ec_xskT *xsk, int sock, const void *buf, int len, int kick);
+void ecx_xdp_kick(ec_xskT *xsk, int sock);
+uint8 *ecx_xdp_peek(ec_xskT *xsk);
+void ecx_xdp_release(ec_xskT *xsk);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
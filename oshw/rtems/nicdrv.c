@@ -133,6 +133,7 @@ int ecx_setupnic(ecx_portt *port, const char *ifname, int secondary)
       port->sockhandle        = -1;
       port->lastidx           = 0;
       port->redstate          = ECT_RED_NONE;
+      port->txframes          = 0;
       port->stack.sock        = &(port->sockhandle);
       port->stack.txbuf       = &(port->txbuf);
       port->stack.txbuflength = &(port->txbuflength);
@@ -258,12 +259,12 @@ void ec_setupheader(void *p)
 
 /** Get new frame identifier index and allocate corresponding rx buffer.
  * @param[in] port        = port context struct
- * @return new index.
+ * @return new index or -1 if all indexes are in use.
  */
-uint8 ecx_getindex(ecx_portt *port)
+int ecx_getindex(ecx_portt *port)
 {
-   uint8 idx;
-   uint8 cnt;
+   int idx;
+   int cnt;
 
    pthread_mutex_lock( &(port->getindex_mutex) );
 
@@ -284,16 +285,50 @@ uint8 ecx_getindex(ecx_portt *port)
          idx = 0;
       }
    }
-   port->rxbufstat[idx] = EC_BUF_ALLOC;
-   if (port->redstate != ECT_RED_NONE)
-      port->redport->rxbufstat[idx] = EC_BUF_ALLOC;
-   port->lastidx = idx;
+   if (port->rxbufstat[idx] != EC_BUF_EMPTY)
+   {
+      /* all indexes are in use */
+      idx = -1;
+   }
+   else
+   {
+      port->rxbufstat[idx] = EC_BUF_ALLOC;
+      if (port->redstate != ECT_RED_NONE)
+         port->redport->rxbufstat[idx] = EC_BUF_ALLOC;
+      port->lastidx = idx;
+   }
 
    pthread_mutex_unlock( &(port->getindex_mutex) );
 
    return idx;
 }
 
+/** Get new frame identifier index from a partition of the index pool. This
+ * port has one shared pool, the partition is ignored.
+ * @param[in] port        = port context struct
+ * @param[in] part        = index partition, see ec_idxpart
+ * @return new index or -1 if all indexes are in use.
+ */
+int ecx_getindex_part(ecx_portt *port, int part)
+{
+   (void)part;
+   return ecx_getindex(port);
+}
+
+/** Get the software timestamps of the last frame of an index. This port does
+ * not take timestamps, they are reported as not available.
+ * @param[in] port        = port context struct
+ * @param[in] idx         = index in buffer array
+ * @param[out] frametime  = timestamps of frame
+ */
+void ecx_getframetime(ecx_portt *port, uint8 idx, ec_frametimet *frametime)
+{
+   (void)port;
+   (void)idx;
+   frametime->tx = 0;
+   frametime->rx = 0;
+}
+
 /** Set rx buffer status.
  * @param[in] port        = port context struct
  * @param[in] idx      = index in buffer array
@@ -320,6 +355,7 @@ int ecx_outframe(ecx_portt *port, uint8 idx, int stacknumber)
    if (!stacknumber)
    {
       stack = &(port->stack);
+      port->txframes++;
    }
    else
    {
@@ -376,6 +412,25 @@ int ecx_outframe_red(ecx_portt *port, uint8 idx)
    return rval;
 }
 
+/** Transmit a batch of buffers over socket (non blocking).
+ * Frames are handed to ecx_outframe_red() one by one.
+ * @param[in] port        = port context struct
+ * @param[in] idx         = array of indexes in tx buffer array
+ * @param[in] n           = number of indexes
+ * @return number of frames transmitted
+ */
+int ecx_outframe_red_batch(ecx_portt *port, const uint8 *idx, int n)
+{
+   int i;
+
+   for (i = 0; i < n; i++)
+   {
+      ecx_outframe_red(port, idx[i]);
+   }
+
+   return n;
+}
+
 /** Non blocking read of socket. Put frame in temporary buffer.
  * @param[in] port        = port context struct
  * @param[in] stacknumber = 0=primary 1=secondary stack
@@ -609,6 +664,49 @@ int ecx_waitinframe(ecx_portt *port, uint8 idx, int timeout)
    return wkc;
 }
 
+/** Blocking receive of the first of several frames to arrive. Frames of the
+ * other indexes that arrive meanwhile are kept in their buffers. In redundant
+ * mode the frames are received in order, the first index is waited for.
+ * @param[in]  port        = port context struct
+ * @param[in]  idx         = indexes of the frames
+ * @param[in]  n           = number of indexes
+ * @param[out] wkc         = workcounter of the frame received
+ * @param[in]  timeout     = timeout in us
+ * @return position in idx of the frame received, -1 if none arrived
+ */
+int ecx_waitinframe_any(ecx_portt *port, const uint8 *idx, int n, int *wkc, int timeout)
+{
+   osal_timert timer;
+   int i;
+
+   *wkc = EC_NOFRAME;
+   if (n < 1)
+   {
+      return -1;
+   }
+   /* redundant mode needs both frames of an index */
+   if (port->redstate != ECT_RED_NONE)
+   {
+      *wkc = ecx_waitinframe(port, idx[0], timeout);
+      return (*wkc > EC_NOFRAME) ? 0 : -1;
+   }
+   osal_timer_start(&timer, timeout);
+   do
+   {
+      for (i = 0; i < n; i++)
+      {
+         *wkc = ecx_inframe(port, idx[i], 0);
+         if (*wkc > EC_NOFRAME)
+         {
+            return i;
+         }
+      }
+   } while (!osal_timer_is_expired(&timer));
+   *wkc = EC_NOFRAME;
+
+   return -1;
+}
+
 /** Blocking send and receive frame function. Used for non processdata frames.
  * A datagram is build into a frame and transmitted via this function. It waits
  * for an answer and returns the workcounter. The function retries if time is
@@ -659,11 +757,21 @@ int ec_closenic(void)
    return ecx_closenic(&ecx_port);
 }
 
-uint8 ec_getindex(void)
+int ec_getindex(void)
 {
    return ecx_getindex(&ecx_port);
 }
 
+int ec_getindex_part(int part)
+{
+   return ecx_getindex_part(&ecx_port, part);
+}
+
+void ec_getframetime(uint8 idx, ec_frametimet *frametime)
+{
+   ecx_getframetime(&ecx_port, idx, frametime);
+}
+
 void ec_setbufstat(uint8 idx, int bufstat)
 {
    ecx_setbufstat(&ecx_port, idx, bufstat);
@@ -679,6 +787,11 @@ int ec_outframe_red(uint8 idx)
    return ecx_outframe_red(&ecx_port, idx);
 }
 
+int ec_outframe_red_batch(const uint8 *idx, int n)
+{
+   return ecx_outframe_red_batch(&ecx_port, idx, n);
+}
+
 int ec_inframe(uint8 idx, int stacknumber)
 {
    return ecx_inframe(&ecx_port, idx, stacknumber);
@@ -79,6 +79,8 @@ typedef struct
    uint8 lastidx;
    /** current redundancy state */
    int redstate;
+   /** number of frames transmitted on the primary port */
+   uint32 txframes;
    /** pointer to redundancy port and buffers */
    ecx_redportt *redport;
    pthread_mutex_t getindex_mutex;
@@ -96,9 +98,12 @@ extern ecx_redportt  ecx_redport;
 int ec_setupnic(const char * ifname, int secondary);
 int ec_closenic(void);
 void ec_setbufstat(uint8 idx, int bufstat);
-uint8 ec_getindex(void);
+int ec_getindex(void);
+int ec_getindex_part(int part);
+void ec_getframetime(uint8 idx, ec_frametimet *frametime);
 int ec_outframe(uint8 idx, int sock);
 int ec_outframe_red(uint8 idx);
+int ec_outframe_red_batch(const uint8 *idx, int n);
 int ec_waitinframe(uint8 idx, int timeout);
 int ec_srconfirm(uint8 idx,int timeout);
 #endif
@@ -107,10 +112,14 @@ void ec_setupheader(void *p);
 int ecx_setupnic(ecx_portt *port, const char * ifname, int secondary);
 int ecx_closenic(ecx_portt *port);
 void ecx_setbufstat(ecx_portt *port, uint8 idx, int bufstat);
-uint8 ecx_getindex(ecx_portt *port);
+int ecx_getindex(ecx_portt *port);
+int ecx_getindex_part(ecx_portt *port, int part);
+void ecx_getframetime(ecx_portt *port, uint8 idx, ec_frametimet *frametime);
 int ecx_outframe(ecx_portt *port, uint8 idx, int sock);
 int ecx_outframe_red(ecx_portt *port, uint8 idx);
+int ecx_outframe_red_batch(ecx_portt *port, const uint8 *idx, int n);
 int ecx_waitinframe(ecx_portt *port, uint8 idx, int timeout);
+int ecx_waitinframe_any(ecx_portt *port, const uint8 *idx, int n, int *wkc, int timeout);
 int ecx_srconfirm(ecx_portt *port, uint8 idx,int timeout);
 
 #ifdef __cplusplus
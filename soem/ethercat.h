@@ -22,5 +22,6 @@
 #include "ethercateoe.h"
 #include "ethercatconfig.h"
 #include "ethercatprint.h"
+#include "ethercatcyclic.h"
 
 #endif /* _EC_ETHERCAT_H */
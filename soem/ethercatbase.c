@@ -157,11 +157,15 @@ uint16 ecx_adddatagram(ecx_portt *port, void *frame, uint8 com, uint8 idx, boole
  */
 int ecx_BWR (ecx_portt *port, uint16 ADP, uint16 ADO, uint16 length, void *data, int timeout)
 {
-   uint8 idx;
+   int idx;
    int wkc;
 
    /* get fresh index */
-   idx = ecx_getindex (port);
+   idx = ecx_getindex(port);
+   if (idx < 0)
+   {
+      return EC_NOFRAME;
+   }
    /* setup datagram */
    ecx_setupdatagram (port, &(port->txbuf[idx]), EC_CMD_BWR, idx, ADP, ADO, length, data);
    /* send data and wait for answer */
@@ -184,11 +188,15 @@ int ecx_BWR (ecx_portt *port, uint16 ADP, uint16 ADO, uint16 length, void *data,
  */
 int ecx_BRD(ecx_portt *port, uint16 ADP, uint16 ADO, uint16 length, void *data, int timeout)
 {
-   uint8 idx;
+   int idx;
    int wkc;
 
    /* get fresh index */
    idx = ecx_getindex(port);
+   if (idx < 0)
+   {
+      return EC_NOFRAME;
+   }
    /* setup datagram */
    ecx_setupdatagram(port, &(port->txbuf[idx]), EC_CMD_BRD, idx, ADP, ADO, length, data);
    /* send data and wait for answer */
@@ -217,9 +225,13 @@ int ecx_BRD(ecx_portt *port, uint16 ADP, uint16 ADO, uint16 length, void *data,
 int ecx_APRD(ecx_portt *port, uint16 ADP, uint16 ADO, uint16 length, void *data, int timeout)
 {
    int wkc;
-   uint8 idx;
+   int idx;
 
    idx = ecx_getindex(port);
+   if (idx < 0)
+   {
+      return EC_NOFRAME;
+   }
    ecx_setupdatagram(port, &(port->txbuf[idx]), EC_CMD_APRD, idx, ADP, ADO, length, data);
    wkc = ecx_srconfirm(port, idx, timeout);
    if (wkc > 0)
@@ -245,9 +257,13 @@ int ecx_APRD(ecx_portt *port, uint16 ADP, uint16 ADO, uint16 length, void *data,
 int ecx_ARMW(ecx_portt *port, uint16 ADP, uint16 ADO, uint16 length, void *data, int timeout)
 {
    int wkc;
-   uint8 idx;
+   int idx;
 
    idx = ecx_getindex(port);
+   if (idx < 0)
+   {
+      return EC_NOFRAME;
+   }
    ecx_setupdatagram(port, &(port->txbuf[idx]), EC_CMD_ARMW, idx, ADP, ADO, length, data);
    wkc = ecx_srconfirm(port, idx, timeout);
    if (wkc > 0)
@@ -273,9 +289,13 @@ int ecx_ARMW(ecx_portt *port, uint16 ADP, uint16 ADO, uint16 length, void *data,
 int ecx_FRMW(ecx_portt *port, uint16 ADP, uint16 ADO, uint16 length, void *data, int timeout)
 {
    int wkc;
-   uint8 idx;
+   int idx;
 
    idx = ecx_getindex(port);
+   if (idx < 0)
+   {
+      return EC_NOFRAME;
+   }
    ecx_setupdatagram(port, &(port->txbuf[idx]), EC_CMD_FRMW, idx, ADP, ADO, length, data);
    wkc = ecx_srconfirm(port, idx, timeout);
    if (wkc > 0)
@@ -318,9 +338,13 @@ uint16 ecx_APRDw(ecx_portt *port, uint16 ADP, uint16 ADO, int timeout)
 int ecx_FPRD(ecx_portt *port, uint16 ADP, uint16 ADO, uint16 length, void *data, int timeout)
 {
    int wkc;
-   uint8 idx;
+   int idx;
 
    idx = ecx_getindex(port);
+   if (idx < 0)
+   {
+      return EC_NOFRAME;
+   }
    ecx_setupdatagram(port, &(port->txbuf[idx]), EC_CMD_FPRD, idx, ADP, ADO, length, data);
    wkc = ecx_srconfirm(port, idx, timeout);
    if (wkc > 0)
@@ -361,10 +385,14 @@ uint16 ecx_FPRDw(ecx_portt *port, uint16 ADP, uint16 ADO, int timeout)
  */
 int ecx_APWR(ecx_portt *port, uint16 ADP, uint16 ADO, uint16 length, void *data, int timeout)
 {
-   uint8 idx;
+   int idx;
    int wkc;
 
    idx = ecx_getindex(port);
+   if (idx < 0)
+   {
+      return EC_NOFRAME;
+   }
    ecx_setupdatagram(port, &(port->txbuf[idx]), EC_CMD_APWR, idx, ADP, ADO, length, data);
    wkc = ecx_srconfirm(port, idx, timeout);
    ecx_setbufstat(port, idx, EC_BUF_EMPTY);
@@ -399,9 +427,13 @@ int ecx_APWRw(ecx_portt *port, uint16 ADP, uint16 ADO, uint16 data, int timeout)
 int ecx_FPWR(ecx_portt *port, uint16 ADP, uint16 ADO, uint16 length, void *data, int timeout)
 {
    int wkc;
-   uint8 idx;
+   int idx;
 
    idx = ecx_getindex(port);
+   if (idx < 0)
+   {
+      return EC_NOFRAME;
+   }
    ecx_setupdatagram(port, &(port->txbuf[idx]), EC_CMD_FPWR, idx, ADP, ADO, length, data);
    wkc = ecx_srconfirm(port, idx, timeout);
    ecx_setbufstat(port, idx, EC_BUF_EMPTY);
@@ -434,10 +466,14 @@ int ecx_FPWRw(ecx_portt *port, uint16 ADP, uint16 ADO, uint16 data, int timeout)
  */
 int ecx_LRW(ecx_portt *port, uint32 LogAdr, uint16 length, void *data, int timeout)
 {
-   uint8 idx;
+   int idx;
    int wkc;
 
    idx = ecx_getindex(port);
+   if (idx < 0)
+   {
+      return EC_NOFRAME;
+   }
    ecx_setupdatagram(port, &(port->txbuf[idx]), EC_CMD_LRW, idx, LO_WORD(LogAdr), HI_WORD(LogAdr), length, data);
    wkc = ecx_srconfirm(port, idx, timeout);
    if ((wkc > 0) && (port->rxbuf[idx][EC_CMDOFFSET] == EC_CMD_LRW))
@@ -460,10 +496,14 @@ int ecx_LRW(ecx_portt *port, uint32 LogAdr, uint16 length, void *data, int timeo
  */
 int ecx_LRD(ecx_portt *port, uint32 LogAdr, uint16 length, void *data, int timeout)
 {
-   uint8 idx;
+   int idx;
    int wkc;
 
    idx = ecx_getindex(port);
+   if (idx < 0)
+   {
+      return EC_NOFRAME;
+   }
    ecx_setupdatagram(port, &(port->txbuf[idx]), EC_CMD_LRD, idx, LO_WORD(LogAdr), HI_WORD(LogAdr), length, data);
    wkc = ecx_srconfirm(port, idx, timeout);
    if ((wkc > 0) && (port->rxbuf[idx][EC_CMDOFFSET]==EC_CMD_LRD))
@@ -486,10 +526,14 @@ int ecx_LRD(ecx_portt *port, uint32 LogAdr, uint16 length, void *data, int timeo
  */
 int ecx_LWR(ecx_portt *port, uint32 LogAdr, uint16 length, void *data, int timeout)
 {
-   uint8 idx;
+   int idx;
    int wkc;
 
    idx = ecx_getindex(port);
+   if (idx < 0)
+   {
+      return EC_NOFRAME;
+   }
    ecx_setupdatagram(port, &(port->txbuf[idx]), EC_CMD_LWR, idx, LO_WORD(LogAdr), HI_WORD(LogAdr), length, data);
    wkc = ecx_srconfirm(port, idx, timeout);
    ecx_setbufstat(port, idx, EC_BUF_EMPTY);
@@ -512,11 +556,15 @@ int ecx_LWR(ecx_portt *port, uint32 LogAdr, uint16 length, void *data, int timeo
 int ecx_LRWDC(ecx_portt *port, uint32 LogAdr, uint16 length, void *data, uint16 DCrs, int64 *DCtime, int timeout)
 {
    uint16 DCtO;
-   uint8 idx;
+   int idx;
    int wkc;
    uint64 DCtE;
 
    idx = ecx_getindex(port);
+   if (idx < 0)
+   {
+      return EC_NOFRAME;
+   }
    /* LRW in first datagram */
    ecx_setupdatagram(port, &(port->txbuf[idx]), EC_CMD_LRW, idx, LO_WORD(LogAdr), HI_WORD(LogAdr), length, data);
    /* FPRMW in second datagram */
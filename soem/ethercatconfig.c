@@ -100,6 +100,34 @@ int ec_findconfig( uint32 man, uint32 id)
 }
 #endif
 
+/** Switch the bring-up phase timers to another phase. Elapsed time and
+ * transmitted frames since the last switch are added to the current phase.
+ *
+ * @param[in] context  = context struct
+ * @param[in] phase    = new phase, EC_CONFPHASE_NONE to stop timing
+ */
+static void ecx_config_phase(ecx_contextt *context, int phase)
+{
+   ec_confstatt *cs = context->confstat;
+   int64 now;
+   uint32 frames;
+
+   if (cs && (cs->current != phase))
+   {
+      /* monotonic, a clock step during bring-up does not skew the phases */
+      now = osal_monotonic_time();
+      frames = context->port->txframes;
+      if ((cs->current > EC_CONFPHASE_NONE) && (cs->current < EC_CONFPHASE_MAX))
+      {
+         cs->phase[cs->current].time += (uint32)((now - cs->start) / 1000);
+         cs->phase[cs->current].frames += frames - cs->startframes;
+      }
+      cs->current = phase;
+      cs->start = now;
+      cs->startframes = frames;
+   }
+}
+
 void ecx_init_context(ecx_contextt *context)
 {
    int lp;
@@ -318,12 +346,19 @@ int ecx_config_init(ecx_contextt *context, uint8 usetable)
 
    EC_PRINT("ec_config_init %d\n",usetable);
    ecx_init_context(context);
+   if (context->confstat)
+   {
+      memset(context->confstat, 0x00, sizeof(ec_confstatt));
+      context->confstat->current = EC_CONFPHASE_NONE;
+   }
+   ecx_config_phase(context, EC_CONFPHASE_DETECT);
    wkc = ecx_detect_slaves(context);
    if (wkc > 0)
    {
       ecx_set_slaves_to_default(context);
       for (slave = 1; slave <= *(context->slavecount); slave++)
       {
+         ecx_config_phase(context, EC_CONFPHASE_ENUM);
          ADPh = (uint16)(1 - slave);
          val16 = ecx_APRDw(context->port, ADPh, ECT_REG_PDICTL, EC_TIMEOUTRET3); /* read interface type of slave */
          context->slavelist[slave].Itype = etohs(val16);
@@ -350,6 +385,7 @@ int ecx_config_init(ecx_contextt *context, uint8 usetable)
          {
             context->slavelist[slave].eep_8byte = 1;
          }
+         ecx_config_phase(context, EC_CONFPHASE_EEPROM);
          ecx_readeeprom1(context, slave, ECT_SII_MANUF); /* Manuf */
       }
       for (slave = 1; slave <= *(context->slavecount); slave++)
@@ -382,6 +418,7 @@ int ecx_config_init(ecx_contextt *context, uint8 usetable)
       }
       for (slave = 1; slave <= *(context->slavecount); slave++)
       {
+         ecx_config_phase(context, EC_CONFPHASE_EEPROM);
          if (context->slavelist[slave].mbx_l > 0)
          {
             eedat = ecx_readeeprom2(context, slave, EC_TIMEOUTEEP); /* read mailbox offset */
@@ -393,6 +430,7 @@ int ecx_config_init(ecx_contextt *context, uint8 usetable)
             }
             ecx_readeeprom1(context, slave, ECT_SII_MBXPROTO);
          }
+         ecx_config_phase(context, EC_CONFPHASE_ENUM);
          configadr = context->slavelist[slave].configadr;
          val16 = ecx_FPRDw(context->port, configadr, ECT_REG_ESCSUP, EC_TIMEOUTRET3);
          if ((etohs(val16) & 0x04) > 0)  /* Support DC? */
@@ -468,6 +506,7 @@ int ecx_config_init(ecx_contextt *context, uint8 usetable)
             }
             while (slavec > 0);
          }
+         ecx_config_phase(context, EC_CONFPHASE_STATE);
          (void)ecx_statecheck(context, slave, EC_STATE_INIT,  EC_TIMEOUTSTATE); //* check state change Init */
 
          /* set default mailbox configuration if slave has mailbox */
@@ -483,9 +522,11 @@ int ecx_config_init(ecx_contextt *context, uint8 usetable)
             context->slavelist[slave].SM[1].StartAddr = htoes(context->slavelist[slave].mbx_ro);
             context->slavelist[slave].SM[1].SMlength = htoes(context->slavelist[slave].mbx_rl);
             context->slavelist[slave].SM[1].SMflags = htoel(EC_DEFAULTMBXSM1);
+            ecx_config_phase(context, EC_CONFPHASE_EEPROM);
             eedat = ecx_readeeprom2(context, slave, EC_TIMEOUTEEP);
             context->slavelist[slave].mbx_proto = (uint16)etohl(eedat);
          }
+         ecx_config_phase(context, EC_CONFPHASE_SII);
          cindex = 0;
          /* use configuration table ? */
          if (usetable == 1)
@@ -584,10 +625,12 @@ int ecx_config_init(ecx_contextt *context, uint8 usetable)
             }
             /* program SM0 mailbox in and SM1 mailbox out for slave */
             /* writing both SM in one datagram will solve timing issue in old NETX */
+            ecx_config_phase(context, EC_CONFPHASE_SM);
             ecx_FPWR(context->port, configadr, ECT_REG_SM0, sizeof(ec_smt) * 2,
                &(context->slavelist[slave].SM[0]), EC_TIMEOUTRET3);
          }
          /* some slaves need eeprom available to PDI in init->preop transition */
+         ecx_config_phase(context, EC_CONFPHASE_STATE);
          ecx_eeprom2pdi(context, slave);
          /* User may override automatic state change */
          if (context->manualstatechange == 0)
@@ -601,6 +644,7 @@ int ecx_config_init(ecx_contextt *context, uint8 usetable)
          }
       }
    }
+   ecx_config_phase(context, EC_CONFPHASE_NONE);
    return wkc;
 }
 
@@ -643,7 +687,14 @@ static int ecx_map_coe_soe(ecx_contextt *context, uint16 slave, int thread_n)
    uint32 Isize, Osize;
    int rval;
 
+#if EC_MAX_MAPT <= 1
+   /* phases are only switched without mapper threads */
+   ecx_config_phase(context, EC_CONFPHASE_STATE);
+#endif
    ecx_statecheck(context, slave, EC_STATE_PRE_OP, EC_TIMEOUTSTATE); /* check state change pre-op */
+#if EC_MAX_MAPT <= 1
+   ecx_config_phase(context, EC_CONFPHASE_COE);
+#endif
 
    EC_PRINT(" >Slave %d, configadr %x, state %2.2x\n",
             slave, context->slavelist[slave].configadr, context->slavelist[slave].state);
@@ -846,6 +897,7 @@ static void ecx_config_find_mappings(ecx_contextt *context, uint8 group)
    int thrn, thrc;
    uint16 slave;
 
+   ecx_config_phase(context, EC_CONFPHASE_COE);
    for (thrn = 0; thrn < EC_MAX_MAPT; thrn++)
    {
       ecx_mapt[thrn].running = 0;
@@ -887,7 +939,9 @@ static void ecx_config_find_mappings(ecx_contextt *context, uint8 group)
    {
       if (!group || (group == context->slavelist[slave].group))
       {
+         ecx_config_phase(context, EC_CONFPHASE_SIIPDO);
          ecx_map_sii(context, slave);
+         ecx_config_phase(context, EC_CONFPHASE_SM);
          ecx_map_sm(context, slave);
       }
    }
@@ -1175,8 +1229,107 @@ static void ecx_config_create_output_mappings(ecx_contextt *context, void *pIOma
       context->grouplist[group].outputsWKC++;
 }
 
+/** Move the process data of a mapped group from the IOmap into the frame
+ * buffers of the port. The group gets a frame index that stays pinned to it,
+ * the outputs point into its tx buffer and the inputs into its rx buffer. The
+ * frame is built once here, the current IOmap outputs are its initial
+ * content. A frame index pinned by a previous mapping of the group is
+ * released first. Groups with LRD/LWR, groups that need more than one frame,
+ * redundant ports, or without a free frame index, keep using the IOmap and
+ * their zerocopy flag is cleared. The redundancy repair would copy the
+ * received frame over the outputs, and with more than one frame the process
+ * data of the group would not be contiguous.
+ *
+ * @param[in]  context    = context struct
+ * @param[in]  pIOmap     = pointer to IOmap the group was mapped to
+ * @param[in]  group      = group
+ * @param[in]  overlap    = TRUE if the IOmap is overlapping
+ */
+static void ecx_config_zerocopy(ecx_contextt *context, void *pIOmap, uint8 group, boolean overlap)
+{
+   ec_groupt *grp;
+   ec_slavet *slv;
+   uint8 *iomap, *txdata, *rxdata;
+   uint16 slave;
+   int idx;
+
+   grp = &(context->grouplist[group]);
+   if (grp->zcpinned)
+   {
+      ecx_setbufstat(context->port, grp->zcidx, EC_BUF_EMPTY);
+      grp->zcpinned = FALSE;
+   }
+   /* no frames in flight any more */
+   if (grp->zcseq & 1)
+   {
+      grp->zcseq++;
+   }
+   if (!grp->zerocopy)
+   {
+      return;
+   }
+   if (grp->blockLRW || !(grp->Obytes + grp->Ibytes))
+   {
+      EC_PRINT("Group %d zero copy not possible, LRW blocked or no IO\n", group);
+      grp->zerocopy = FALSE;
+      return;
+   }
+   if (context->port->redport || (grp->nsegments > 1))
+   {
+      EC_PRINT("Group %d zero copy not possible, redundant port or more than one frame\n", group);
+      grp->zerocopy = FALSE;
+      return;
+   }
+   idx = ecx_getindex_part(context->port, EC_IDXPART_RT);
+   if (idx < 0)
+   {
+      EC_PRINT("Group %d zero copy not possible, no free frame index\n", group);
+      grp->zerocopy = FALSE;
+      return;
+   }
+   grp->zcidx = (uint8)idx;
+   grp->zcpinned = TRUE;
+   /* build LRW frame from the IOmap */
+   iomap = pIOmap;
+   ecx_setupdatagram(context->port, &(context->port->txbuf[idx]), EC_CMD_LRW, (uint8)idx,
+      LO_WORD(grp->logstartaddr), HI_WORD(grp->logstartaddr), (uint16)grp->IOsegment[0], iomap);
+   /* the index is not released after receive */
+   ecx_setbufstat(context->port, (uint8)idx, EC_BUF_ALLOC);
+   grp->zcdcnext = 0;
+   grp->zcdcoffset = 0;
+   /* point outputs to the tx buffer and inputs to the rx buffer */
+   txdata = &(context->port->txbuf[idx][ETH_HEADERSIZE + EC_HEADERSIZE]);
+   rxdata = &(context->port->rxbuf[idx][EC_HEADERSIZE]);
+   for (slave = 1; slave <= *(context->slavecount); slave++)
+   {
+      slv = &(context->slavelist[slave]);
+      if (group && (group != slv->group))
+      {
+         continue;
+      }
+      if (slv->Obits)
+      {
+         slv->outputs = txdata + (slv->outputs - iomap);
+      }
+      if (slv->Ibits)
+      {
+         slv->inputs = rxdata + (slv->inputs - iomap) - (overlap ? grp->Obytes : 0);
+      }
+   }
+   grp->outputs = txdata;
+   grp->inputs = rxdata + (overlap ? 0 : grp->Obytes);
+   if (!group)
+   {
+      context->slavelist[0].outputs = grp->outputs;
+      context->slavelist[0].inputs = grp->inputs;
+   }
+}
+
 /** Map all PDOs in one group of slaves to IOmap with Outputs/Inputs
 * in sequential order (legacy SOEM way).
+* With grouplist[group].zerocopy set the process data is moved into the
+* frame buffers of the port after mapping, pIOmap then only holds the
+* initial outputs.
 *
  *
  * @param[in]  context    = context struct
@@ -1206,6 +1359,7 @@ int ecx_config_map_group(ecx_contextt *context, void *pIOmap, uint8 group)
 
       /* Find mappings and program syncmanagers */
       ecx_config_find_mappings(context, group);
+      ecx_config_phase(context, EC_CONFPHASE_FMMU);
 
       /* do output mapping of slave and program FMMUs */
       for (slave = 1; slave <= *(context->slavecount); slave++)
@@ -1295,6 +1449,7 @@ int ecx_config_map_group(ecx_contextt *context, void *pIOmap, uint8 group)
                }
             }
 
+            ecx_config_phase(context, EC_CONFPHASE_STATE);
             ecx_eeprom2pdi(context, slave); /* set Eeprom control to PDI */
             /* User may override automatic state change */
             if (context->manualstatechange == 0)
@@ -1306,6 +1461,7 @@ int ecx_config_map_group(ecx_contextt *context, void *pIOmap, uint8 group)
                   htoes(EC_STATE_SAFE_OP),
                   EC_TIMEOUTRET3); /* set safeop status */
             }
+            ecx_config_phase(context, EC_CONFPHASE_FMMU);
             if (context->slavelist[slave].blockLRW)
             {
                context->grouplist[group].blockLRW++;
@@ -1346,6 +1502,9 @@ int ecx_config_map_group(ecx_contextt *context, void *pIOmap, uint8 group)
             context->slavelist[0].Obytes; /* store input bytes in master record */
       }
 
+      ecx_compile_processdata_group(context, group, FALSE);
+      ecx_config_zerocopy(context, pIOmap, group, FALSE);
+      ecx_config_phase(context, EC_CONFPHASE_NONE);
       EC_PRINT("IOmapSize %d\n", LogAddr - context->grouplist[group].logstartaddr);
 
       return (LogAddr - context->grouplist[group].logstartaddr);
@@ -1356,6 +1515,9 @@ int ecx_config_map_group(ecx_contextt *context, void *pIOmap, uint8 group)
 
 /** Map all PDOs in one group of slaves to IOmap with Outputs/Inputs
  * overlapping. NOTE: Must use this for TI ESC when using LRW.
+ * With grouplist[group].zerocopy set the process data is moved into the
+ * frame buffers of the port after mapping, pIOmap then only holds the
+ * initial outputs.
  *
  * @param[in]  context    = context struct
  * @param[out] pIOmap     = pointer to IOmap
@@ -1387,6 +1549,7 @@ int ecx_config_overlap_map_group(ecx_contextt *context, void *pIOmap, uint8 grou
 
       /* Find mappings and program syncmanagers */
       ecx_config_find_mappings(context, group);
+      ecx_config_phase(context, EC_CONFPHASE_FMMU);
       
       /* do IO mapping of slave and program FMMUs */
       for (slave = 1; slave <= *(context->slavecount); slave++)
@@ -1439,6 +1602,7 @@ int ecx_config_overlap_map_group(ecx_contextt *context, void *pIOmap, uint8 grou
                segmentsize += diff;
             }
 
+            ecx_config_phase(context, EC_CONFPHASE_STATE);
             ecx_eeprom2pdi(context, slave); /* set Eeprom control to PDI */
             /* User may override automatic state change */
             if (context->manualstatechange == 0)
@@ -1450,6 +1614,7 @@ int ecx_config_overlap_map_group(ecx_contextt *context, void *pIOmap, uint8 grou
                   htoes(EC_STATE_SAFE_OP),
                   EC_TIMEOUTRET3);
             }
+            ecx_config_phase(context, EC_CONFPHASE_FMMU);
             if (context->slavelist[slave].blockLRW)
             {
                context->grouplist[group].blockLRW++;
@@ -1472,7 +1637,10 @@ int ecx_config_overlap_map_group(ecx_contextt *context, void *pIOmap, uint8 grou
       /* Move calculated inputs with OBytes offset*/
       for (slave = 1; slave <= *(context->slavecount); slave++)
       {
-         context->slavelist[slave].inputs += context->grouplist[group].Obytes;
+         if (!group || (group == context->slavelist[slave].group))
+         {
+            context->slavelist[slave].inputs += context->grouplist[group].Obytes;
+         }
       }
 
       if (!group)
@@ -1484,6 +1652,9 @@ int ecx_config_overlap_map_group(ecx_contextt *context, void *pIOmap, uint8 grou
          context->slavelist[0].Ibytes = siLogAddr - context->grouplist[group].logstartaddr;
       }
 
+      ecx_compile_processdata_group(context, group, TRUE);
+      ecx_config_zerocopy(context, pIOmap, group, TRUE);
+      ecx_config_phase(context, EC_CONFPHASE_NONE);
       EC_PRINT("IOmapSize %d\n", context->grouplist[group].Obytes + context->grouplist[group].Ibytes);
 
       return (context->grouplist[group].Obytes + context->grouplist[group].Ibytes);
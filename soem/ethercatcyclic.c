@@ -0,0 +1,412 @@
+/*
+ * Licensed under the GNU General Public License version 2 with exceptions. See
+ * LICENSE file in the project root for full license information
+ */
+
+/** \file
+ * \brief
+ * Cyclic process data engine.
+ *
+ * Runs the send/receive cycle of one or more groups in a real-time thread
+ * that sleeps to absolute deadlines. Groups can run at a divisor of the base
+ * cycle, staggered and sharing frames with the other groups due in the same
+ * base cycle. When the network has distributed clocks
+ * the deadlines are steered by a PI controller so that the master cycle stays
+ * locked to the DC reference clock, the same way the red_test example does
+ * it by hand.
+ */
+#include <string.h>
+#include "oshw.h"
+#include "osal.h"
+#include "ethercattype.h"
+#include "ethercatbase.h"
+#include "ethercatmain.h"
+#include "ethercatcyclic.h"
+
+/** Initialise a cyclic engine with default settings for group 0 every cycle.
+ *
+ * @param[out] cyclic     = cyclic engine
+ * @param[in]  context    = context struct
+ * @param[in]  cycletime  = cycle time in ns
+ */
+void ecx_cyclic_init(ec_cyclict *cyclic, ecx_contextt *context, int64 cycletime)
+{
+   memset(cyclic, 0, sizeof(*cyclic));
+   cyclic->context = context;
+   cyclic->cycletime = cycletime;
+   cyclic->syncshift = EC_CYCLIC_SYNCSHIFT;
+   cyclic->pdiv = EC_CYCLIC_PDIV;
+   cyclic->idiv = EC_CYCLIC_IDIV;
+   cyclic->timeout = EC_TIMEOUTRET;
+   cyclic->priority = EC_CYCLIC_PRIORITY;
+   cyclic->cpu = -1;
+   cyclic->dcsync = TRUE;
+}
+
+/** DC sync controller. Computes the phase error of the master cycle against
+ * the DC reference clock and the correction to add to the next cycle time.
+ * The proportional part follows the phase error, the integral part counts
+ * the sign of the error and takes out the constant drift between the clocks.
+ *
+ * @param[in]  cyclic     = cyclic engine
+ * @param[in]  reftime    = DC reference time of the last process data frame
+ * @return correction in ns to add to the next cycle time
+ */
+int64 ecx_cyclic_sync(ec_cyclict *cyclic, int64 reftime)
+{
+   int64 delta;
+
+   delta = (reftime - cyclic->syncshift) % cyclic->cycletime;
+   if (delta > (cyclic->cycletime / 2))
+   {
+      delta -= cyclic->cycletime;
+   }
+   if (delta > 0)
+   {
+      cyclic->integral++;
+   }
+   if (delta < 0)
+   {
+      cyclic->integral--;
+   }
+   cyclic->delta = delta;
+   cyclic->toff = -(delta / cyclic->pdiv) - (cyclic->integral / cyclic->idiv);
+
+   return cyclic->toff;
+}
+
+static int ecx_cyclic_gcd(int a, int b)
+{
+   int t;
+
+   while (b)
+   {
+      t = a % b;
+      a = b;
+      b = t;
+   }
+   return a;
+}
+
+static int ecx_cyclic_divisor(ec_cyclict *cyclic, int i)
+{
+   return (cyclic->divisor[i] > 1) ? cyclic->divisor[i] : 1;
+}
+
+/** Collect the groups of the schedule due in a base cycle.
+ *
+ * @param[in]  cyclic     = cyclic engine
+ * @param[in]  tick       = base cycle
+ * @param[out] entries    = entries of groups[] due
+ * @param[out] groups     = groups due
+ * @return number of groups due
+ */
+static int ecx_cyclic_due(ec_cyclict *cyclic, uint64 tick, uint8 *entries, uint8 *groups)
+{
+   int i, n = 0;
+
+   for (i = 0; i < cyclic->ngroups; i++)
+   {
+      if ((tick % ecx_cyclic_divisor(cyclic, i)) == cyclic->phase[i])
+      {
+         entries[n] = (uint8)i;
+         groups[n++] = cyclic->groups[i];
+      }
+   }
+   return n;
+}
+
+/** Compile the schedule of the groups. The schedule repeats every nslots
+ * base cycles, the least common multiple of the divisors. With stagger set
+ * the phases are assigned here: the groups are placed from the biggest to
+ * the smallest, each in the phase that keeps the busiest base cycle it is
+ * sent in as quiet as possible. Then the bus load of every base cycle is
+ * computed from the frame plans of the groups due in it, shared frames
+ * included when coschedule is set.
+ *
+ * @param[in]  cyclic     = cyclic engine
+ * @return number of base cycles in the schedule, 0 if the divisors need more
+ * than EC_CYCLIC_MAXSLOTS
+ */
+int ecx_cyclic_schedule(ec_cyclict *cyclic)
+{
+   ecx_contextt *context = cyclic->context;
+   ec_cyclicslott *slot;
+   uint32 wire[EC_MAXGROUP], busy[EC_CYCLIC_MAXSLOTS], worst, best;
+   uint8 entries[EC_MAXGROUP], groups[EC_MAXGROUP];
+   boolean placed[EC_MAXGROUP];
+   int i, j, d, p, s, nslots, frames, bestp;
+
+   if (cyclic->ngroups <= 0)
+   {
+      /* group 0 every cycle */
+      cyclic->ngroups = 1;
+      cyclic->groups[0] = 0;
+   }
+   nslots = 1;
+   for (i = 0; i < cyclic->ngroups; i++)
+   {
+      d = ecx_cyclic_divisor(cyclic, i);
+      nslots = nslots / ecx_cyclic_gcd(nslots, d) * d;
+      if (nslots > EC_CYCLIC_MAXSLOTS)
+      {
+         return 0;
+      }
+   }
+   for (i = 0; i < cyclic->ngroups; i++)
+   {
+      cyclic->phase[i] = (uint16)(cyclic->phase[i] % ecx_cyclic_divisor(cyclic, i));
+      wire[i] = (uint32)ecx_processdata_groups_wiresize(context, &(cyclic->groups[i]), 1, FALSE, NULL);
+      placed[i] = FALSE;
+   }
+   if (cyclic->stagger)
+   {
+      memset(busy, 0, sizeof(busy));
+      for (j = 0; j < cyclic->ngroups; j++)
+      {
+         /* biggest group not placed yet */
+         i = -1;
+         for (s = 0; s < cyclic->ngroups; s++)
+         {
+            if (!placed[s] && ((i < 0) || (wire[s] > wire[i])))
+            {
+               i = s;
+            }
+         }
+         placed[i] = TRUE;
+         d = ecx_cyclic_divisor(cyclic, i);
+         bestp = 0;
+         best = 0xffffffff;
+         for (p = 0; p < d; p++)
+         {
+            worst = 0;
+            for (s = p; s < nslots; s += d)
+            {
+               if (busy[s] > worst)
+               {
+                  worst = busy[s];
+               }
+            }
+            if (worst < best)
+            {
+               best = worst;
+               bestp = p;
+            }
+         }
+         cyclic->phase[i] = (uint16)bestp;
+         for (s = bestp; s < nslots; s += d)
+         {
+            busy[s] += wire[i];
+         }
+      }
+   }
+   cyclic->nslots = nslots;
+   for (s = 0; s < nslots; s++)
+   {
+      slot = &(cyclic->slot[s]);
+      slot->ngroups = (uint16)ecx_cyclic_due(cyclic, (uint64)s, entries, groups);
+      if (cyclic->coschedule)
+      {
+         slot->wirebytes = (uint32)ecx_processdata_groups_wiresize(context, groups, slot->ngroups,
+                                                                   TRUE, &frames);
+      }
+      else
+      {
+         slot->wirebytes = (uint32)ecx_processdata_groups_wiresize(context, groups, slot->ngroups,
+                                                                   FALSE, &frames);
+      }
+      slot->frames = (uint16)frames;
+      slot->wiretime = slot->wirebytes * EC_CYCLIC_NSPERBYTE;
+      slot->load = (uint32)((int64)slot->wiretime * 1000 / cyclic->cycletime);
+   }
+
+   return nslots;
+}
+
+static void ecx_cyclic_receive(ec_cyclict *cyclic)
+{
+   uint8 groups[EC_MAXGROUP];
+   int wkc[EC_MAXGROUP];
+   int i, n;
+
+   n = cyclic->npending;
+   for (i = 0; i < n; i++)
+   {
+      groups[i] = cyclic->groups[cyclic->pending[i]];
+   }
+   if (cyclic->coschedule && (n > 1))
+   {
+      ecx_receive_processdata_groups(cyclic->context, groups, n, cyclic->timeout, wkc);
+   }
+   else
+   {
+      for (i = 0; i < n; i++)
+      {
+         wkc[i] = ecx_receive_processdata_group(cyclic->context, groups[i], cyclic->timeout);
+      }
+   }
+   for (i = 0; i < n; i++)
+   {
+      cyclic->wkc[cyclic->pending[i]] = wkc[i];
+      if (cyclic->received)
+      {
+         cyclic->received(cyclic, groups[i], wkc[i]);
+      }
+   }
+   cyclic->npending = 0;
+}
+
+static void ecx_cyclic_send(ec_cyclict *cyclic, int64 latency)
+{
+   uint8 groups[EC_MAXGROUP];
+   int i, n;
+
+   n = ecx_cyclic_due(cyclic, cyclic->cycles, cyclic->pending, groups);
+   for (i = 0; i < n; i++)
+   {
+      ecx_pdstat_wakeup(cyclic->context, groups[i], latency);
+      if (cyclic->presend)
+      {
+         cyclic->presend(cyclic, groups[i], 0);
+      }
+   }
+   if (cyclic->coschedule && (n > 1))
+   {
+      if (cyclic->overlap)
+      {
+         ecx_send_overlap_processdata_groups(cyclic->context, groups, n);
+      }
+      else
+      {
+         ecx_send_processdata_groups(cyclic->context, groups, n);
+      }
+   }
+   else
+   {
+      for (i = 0; i < n; i++)
+      {
+         if (cyclic->overlap)
+         {
+            ecx_send_overlap_processdata_group(cyclic->context, groups[i]);
+         }
+         else
+         {
+            ecx_send_processdata_group(cyclic->context, groups[i]);
+         }
+      }
+   }
+   cyclic->npending = n;
+}
+
+/** Run the cycle in the calling thread until ecx_cyclic_stop is called. The
+ * first cycle starts on a multiple of the cycle time. A wakeup that is a
+ * full cycle or more late is counted as an overrun and the missed deadlines
+ * are skipped instead of run back to back. Skipped base cycles still count
+ * in cycles, so the groups keep the phases of the schedule. Ports without
+ * threads can call this directly after setting dorun.
+ *
+ * @param[in]  cyclic     = cyclic engine
+ */
+void ecx_cyclic_run(ec_cyclict *cyclic)
+{
+   ecx_contextt *context = cyclic->context;
+   int64 deadline, latency, skipped;
+
+   cyclic->active = TRUE;
+   if (!ecx_cyclic_schedule(cyclic))
+   {
+      cyclic->active = FALSE;
+      return;
+   }
+   cyclic->integral = 0;
+   cyclic->toff = 0;
+   cyclic->npending = 0;
+   cyclic->lastDCtime = *(context->DCtime);
+   deadline = (osal_monotonic_time() / cyclic->cycletime + 1) * cyclic->cycletime;
+   osal_sleep_until(deadline);
+   ecx_cyclic_send(cyclic, osal_monotonic_time() - deadline);
+   while (cyclic->dorun)
+   {
+      deadline += cyclic->cycletime + cyclic->toff;
+      osal_sleep_until(deadline);
+      latency = osal_monotonic_time() - deadline;
+      if (latency > cyclic->maxlatency)
+      {
+         cyclic->maxlatency = latency;
+      }
+      if (latency >= cyclic->cycletime)
+      {
+         cyclic->overruns++;
+         skipped = latency / cyclic->cycletime;
+         deadline += skipped * cyclic->cycletime;
+         cyclic->cycles += skipped;
+      }
+      ecx_cyclic_receive(cyclic);
+      if (cyclic->dcsync && context->slavelist[0].hasdc)
+      {
+         /* only on a new DC time, the group with DC can run slower */
+         if (*(context->DCtime) != cyclic->lastDCtime)
+         {
+            cyclic->lastDCtime = *(context->DCtime);
+            ecx_cyclic_sync(cyclic, cyclic->lastDCtime);
+         }
+      }
+      else
+      {
+         cyclic->toff = 0;
+      }
+      cyclic->cycles++;
+      ecx_cyclic_send(cyclic, latency);
+   }
+   /* collect the frames of the last send */
+   ecx_cyclic_receive(cyclic);
+   cyclic->active = FALSE;
+}
+
+static OSAL_THREAD_FUNC_RT ecx_cyclic_thread(void *param)
+{
+   ecx_cyclic_run((ec_cyclict *)param);
+}
+
+/** Start the cyclic engine in its own thread with the configured priority
+ * and CPU affinity.
+ *
+ * @param[in]  cyclic     = cyclic engine
+ * @return 1 if the thread was started, 0 if it is already running, the
+ * schedule is invalid or the thread could not be created
+ */
+int ecx_cyclic_start(ec_cyclict *cyclic)
+{
+   if (cyclic->active || (cyclic->cycletime <= 0) || !ecx_cyclic_schedule(cyclic))
+   {
+      return 0;
+   }
+   cyclic->cycles = 0;
+   cyclic->overruns = 0;
+   cyclic->maxlatency = 0;
+   cyclic->dorun = TRUE;
+   cyclic->active = TRUE;
+   if (!osal_thread_create_rt_affinity(&cyclic->thread, EC_CYCLIC_STACKSIZE,
+                                       &ecx_cyclic_thread, cyclic,
+                                       cyclic->priority, cyclic->cpu))
+   {
+      cyclic->dorun = FALSE;
+      cyclic->active = FALSE;
+      return 0;
+   }
+   return 1;
+}
+
+/** Stop the cyclic engine and wait until the last cycle has completed. The
+ * thread is detached, it ends on its own after the last cycle.
+ *
+ * @param[in]  cyclic     = cyclic engine
+ */
+void ecx_cyclic_stop(ec_cyclict *cyclic)
+{
+   cyclic->dorun = FALSE;
+   while (cyclic->active)
+   {
+      osal_usleep(1000);
+   }
+}
@@ -0,0 +1,155 @@
+/*
+ * Licensed under the GNU General Public License version 2 with exceptions. See
+ * LICENSE file in the project root for full license information
+ */
+
+/** \file
+ * \brief
+ * Headerfile for ethercatcyclic.c
+ */
+
+#ifndef _EC_ECATCYCLIC_H
+#define _EC_ECATCYCLIC_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** Default SCHED_FIFO priority of the cyclic thread */
+#define EC_CYCLIC_PRIORITY    40
+/** Default stack size of the cyclic thread */
+#define EC_CYCLIC_STACKSIZE   (128 * 1024)
+/** Default shift of the master cycle after the DC sync point in ns */
+#define EC_CYCLIC_SYNCSHIFT   50000
+/** Default divisor of the proportional part of the DC sync controller */
+#define EC_CYCLIC_PDIV        100
+/** Default divisor of the integral part of the DC sync controller */
+#define EC_CYCLIC_IDIV        20
+/** Max. base cycles in the schedule of the groups */
+#define EC_CYCLIC_MAXSLOTS    64
+/** Wire time of one byte at 100Mbit/s in ns */
+#define EC_CYCLIC_NSPERBYTE   80
+
+/** Bus load of one base cycle of the schedule */
+typedef struct ec_cyclicslot
+{
+   /** number of groups sent in the base cycle */
+   uint16         ngroups;
+   /** frames sent in the base cycle */
+   uint16         frames;
+   /** bytes on the wire, including Ethernet overhead */
+   uint32         wirebytes;
+   /** time on the wire in ns */
+   uint32         wiretime;
+   /** wire time in 1/1000 of the base cycle time */
+   uint32         load;
+} ec_cyclicslott;
+
+typedef struct ec_cyclic ec_cyclict;
+
+/** Hook called by the cyclic engine.
+ *
+ * @param[in]  cyclic     = cyclic engine
+ * @param[in]  group      = group the hook is called for
+ * @param[in]  wkc        = received working counter, 0 for the presend hook
+ */
+typedef void (*ec_cyclichookt)(ec_cyclict *cyclic, uint8 group, int wkc);
+
+/** Cyclic engine. Fill in with ecx_cyclic_init and adjust the fields before
+ * ecx_cyclic_start. Each cycle the engine sleeps to an absolute deadline,
+ * receives the frames sent in the previous cycle, calls the receive hook,
+ * runs the DC sync controller, then calls the presend hook and sends the
+ * groups due in this cycle. Frames are in flight while the engine sleeps.
+ *
+ * The cycle time is the base cycle. A group with a divisor is sent every
+ * divisor base cycles, in the base cycles where the cycle count modulo the
+ * divisor equals its phase. See ecx_cyclic_schedule.
+ *
+ * The wakeup lateness of a cycle is recorded in the process data statistics
+ * of the groups sent in it, see ecx_pdstat_read.
+ */
+struct ec_cyclic
+{
+   /** context the engine runs on */
+   ecx_contextt   *context;
+   /** cycle time in ns */
+   int64          cycletime;
+   /** master cycle shift after the DC sync point in ns */
+   int64          syncshift;
+   /** divisor of the proportional part of the DC sync controller */
+   int64          pdiv;
+   /** divisor of the integral part of the DC sync controller */
+   int64          idiv;
+   /** receive timeout in us */
+   int            timeout;
+   /** SCHED_FIFO priority, 0 to keep the default policy */
+   int            priority;
+   /** CPU the thread is pinned to, -1 for no affinity */
+   int            cpu;
+   /** number of groups in groups[], 0 runs group 0 */
+   int            ngroups;
+   /** groups run by the engine */
+   uint8          groups[EC_MAXGROUP];
+   /** base cycles between sends of each entry of groups[], 0 for every cycle */
+   uint16         divisor[EC_MAXGROUP];
+   /** base cycle within the divisor each entry of groups[] is sent in */
+   uint16         phase[EC_MAXGROUP];
+   /** spread the phases of slow groups to flatten the bus load */
+   boolean        stagger;
+   /** send groups due in the same base cycle in shared frames */
+   boolean        coschedule;
+   /** use the overlap send for the groups */
+   boolean        overlap;
+   /** lock the master cycle to the DC reference clock */
+   boolean        dcsync;
+   /** called after receive of a group */
+   ec_cyclichookt received;
+   /** called before send of a group */
+   ec_cyclichookt presend;
+   /** user data for the hooks */
+   void           *userdata;
+   /** thread handle */
+   OSAL_THREAD_HANDLE thread;
+   /** engine is requested to run */
+   volatile boolean dorun;
+   /** engine thread is running */
+   volatile boolean active;
+   /** base cycles since start, including the ones skipped after an overrun */
+   uint64         cycles;
+   /** cycles that woke up a full cycle or more late and were skipped */
+   uint64         overruns;
+   /** last DC phase error in ns */
+   int64          delta;
+   /** last correction applied to the cycle time in ns */
+   int64          toff;
+   /** integral state of the DC sync controller */
+   int64          integral;
+   /** largest wakeup latency seen in ns */
+   int64          maxlatency;
+   /** last received working counter per entry of groups[] */
+   int            wkc[EC_MAXGROUP];
+   /** entries of groups[] sent in the last cycle */
+   uint8          pending[EC_MAXGROUP];
+   /** number of entries in pending[] */
+   int            npending;
+   /** last DC time the sync controller ran on */
+   int64          lastDCtime;
+   /** base cycles in the schedule, the least common multiple of the divisors */
+   int            nslots;
+   /** bus load of every base cycle of the schedule */
+   ec_cyclicslott slot[EC_CYCLIC_MAXSLOTS];
+};
+
+void ecx_cyclic_init(ec_cyclict *cyclic, ecx_contextt *context, int64 cycletime);
+int64 ecx_cyclic_sync(ec_cyclict *cyclic, int64 reftime);
+int ecx_cyclic_schedule(ec_cyclict *cyclic);
+void ecx_cyclic_run(ec_cyclict *cyclic);
+int ecx_cyclic_start(ec_cyclict *cyclic);
+void ecx_cyclic_stop(ec_cyclict *cyclic);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _EC_ECATCYCLIC_H */
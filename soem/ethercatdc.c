@@ -23,6 +23,42 @@
 /** 1st sync pulse delay in ns here 100ms */
 #define SyncDelay       ((int32)100000000)
 
+/** Latch DCrecvTimeA of all slaves and get the master time of the latch. The
+ * software transmit timestamp of the latch frame is used if the port takes
+ * timestamps, otherwise the current time after the frame returned.
+ *
+ * @param[in]  context        = context struct
+ * @return master time in ns since 2000-01-01
+ */
+static uint64 ecx_dclatch(ecx_contextt *context)
+{
+   ec_timet mastertime;
+   ec_frametimet frametime;
+   int idx;
+   int32 ht;
+
+   ht = 0;
+   frametime.tx = 0;
+   idx = ecx_getindex(context->port);
+   if (idx >= 0)
+   {
+      ecx_setupdatagram(context->port, &(context->port->txbuf[idx]), EC_CMD_BWR, idx, 0,
+                        ECT_REG_DCTIME0, sizeof(ht), &ht);
+      (void)ecx_srconfirm(context->port, idx, EC_TIMEOUTRET);
+      ecx_getframetime(context->port, idx, &frametime);
+      ecx_setbufstat(context->port, idx, EC_BUF_EMPTY);
+   }
+   /* EtherCAT uses 2000-01-01 as epoch start instead of 1970-01-01 */
+   if (frametime.tx > 0)
+   {
+      return (uint64)frametime.tx - ((uint64)946684800UL * 1000000000);
+   }
+   mastertime = osal_current_time();
+   mastertime.sec -= 946684800UL;
+
+   return (((uint64)mastertime.sec * 1000000) + (uint64)mastertime.usec) * 1000;
+}
+
 /**
  * Set DC of slave to fire sync0 at CyclTime interval with CyclShift offset.
  *
@@ -260,17 +296,13 @@ boolean ecx_configdc(ecx_contextt *context)
    int8 nlist;
    int8 plist[4];
    int32 tlist[4];
-   ec_timet mastertime;
    uint64 mastertime64;
 
    context->slavelist[0].hasdc = FALSE;
    context->grouplist[0].hasdc = FALSE;
    ht = 0;
 
-   ecx_BWR(context->port, 0, ECT_REG_DCTIME0, sizeof(ht), &ht, EC_TIMEOUTRET);  /* latch DCrecvTimeA of all slaves */
-   mastertime = osal_current_time();
-   mastertime.sec -= 946684800UL;  /* EtherCAT uses 2000-01-01 as epoch start instead of 1970-01-01 */
-   mastertime64 = (((uint64)mastertime.sec * 1000000) + (uint64)mastertime.usec) * 1000;
+   mastertime64 = ecx_dclatch(context);  /* latch DCrecvTimeA of all slaves */
    for (i = 1; i <= *(context->slavecount); i++)
    {
       context->slavelist[i].consumedports = context->slavelist[i].activeports;
@@ -24,6 +24,18 @@
 
 /** delay in us for eeprom ready loop */
 #define EC_LOCALDELAY  200
+/** tries to read a consistent copy of the process data statistics */
+#define EC_PDSTAT_RETRIES 1000
+/** tries to read a consistent copy of zero copy inputs */
+#define EC_ZCREAD_RETRIES 1000
+
+/** record a mailbox or state event in the trace ring of the port, only
+ * available in ports built with EC_TRACE */
+#ifdef EC_TRACE
+#define EC_TRACEEVENT(...) ecx_trace(__VA_ARGS__)
+#else
+#define EC_TRACEEVENT(...) do {} while (0)
+#endif
 
 /** record for ethercat eeprom communications */
 PACKED_BEGIN
@@ -120,6 +132,8 @@ ecx_contextt  ecx_context = {
     NULL,               // .EOEhook()
     0,                  // .manualstatechange
     NULL,               // .userdata
+    NULL,               // .confstat
+    NULL,               // .pipeline
 };
 #endif
 
@@ -682,13 +696,17 @@ uint32 ecx_siiPDO(ecx_contextt *context, uint16 slave, ec_eepromPDOt* PDO, uint8
 int ecx_FPRD_multi(ecx_contextt *context, int n, uint16 *configlst, ec_alstatust *slstatlst, int timeout)
 {
    int wkc;
-   uint8 idx;
+   int idx;
    ecx_portt *port;
    uint16 sldatapos[MAX_FPRD_MULTI];
    int slcnt;
 
    port = context->port;
    idx = ecx_getindex(port);
+   if (idx < 0)
+   {
+      return EC_NOFRAME;
+   }
    slcnt = 0;
    ecx_setupdatagram(port, &(port->txbuf[idx]), EC_CMD_FPRD, idx,
       *(configlst + slcnt), ECT_REG_ALSTAT, sizeof(ec_alstatust), slstatlst + slcnt);
@@ -846,6 +864,8 @@ int ecx_writestate(ecx_contextt *context, uint16 slave)
       ret = ecx_FPWRw(context->port, configadr, ECT_REG_ALCTL,
 	        htoes(context->slavelist[slave].state), EC_TIMEOUTRET3);
    }
+   EC_TRACEEVENT(context->port, EC_TRACE_STATEREQ, 0, (uint8)context->slavelist[slave].state,
+                 slave, 0, 0, (uint16)ret);
    return ret;
 }
 
@@ -894,6 +914,8 @@ uint16 ecx_statecheck(ecx_contextt *context, uint16 slave, uint16 reqstate, int
    }
    while ((state != reqstate) && (osal_timer_is_expired(&timer) == FALSE));
    context->slavelist[slave].state = rval;
+   EC_TRACEEVENT(context->port, EC_TRACE_STATE, 0, (uint8)rval, slave,
+                 (slave > 0) ? context->slavelist[slave].ALstatuscode : 0, 0, 0);
 
    return state;
 }
@@ -979,6 +1001,9 @@ int ecx_mbxsend(ecx_contextt *context, uint16 slave,ec_mbxbuft *mbx, int timeout
          mbxwo = context->slavelist[slave].mbx_wo;
          /* write slave in mailbox */
          wkc = ecx_FPWR(context->port, configadr, mbxwo, mbxl, mbx, EC_TIMEOUTRET3);
+         EC_TRACEEVENT(context->port, EC_TRACE_MBXTX, (((ec_mbxheadert *)mbx)->mbxtype >> 4) & 0x07,
+                       ((ec_mbxheadert *)mbx)->mbxtype & 0x0f, slave, mbxwo,
+                       etohs(((ec_mbxheadert *)mbx)->length), (uint16)wkc);
       }
       else
       {
@@ -1035,6 +1060,11 @@ int ecx_mbxreceive(ecx_contextt *context, uint16 slave, ec_mbxbuft *mbx, int tim
          do
          {
             wkc = ecx_FPRD(context->port, configadr, mbxro, mbxl, mbx, EC_TIMEOUTRET); /* get mailbox */
+            if (wkc > 0)
+            {
+               EC_TRACEEVENT(context->port, EC_TRACE_MBXRX, (mbxh->mbxtype >> 4) & 0x07,
+                             mbxh->mbxtype & 0x0f, slave, mbxro, etohs(mbxh->length), (uint16)wkc);
+            }
             if ((wkc > 0) && ((mbxh->mbxtype & 0x0f) == 0x00)) /* Mailbox error response? */
             {
                MBXEp = (ec_mbxerrort *)mbx;
@@ -1637,359 +1667,1526 @@ uint32 ecx_readeeprom2(ecx_contextt *context, uint16 slave, int timeout)
 }
 
 /** Push index of segmented LRD/LWR/LRW combination.
- * @param[in]  context        = context struct
+ * @param[in]  idxstack    = index stack of the send
  * @param[in] idx         = Used datagram index.
+ * @param[in] group       = Group of the datagram.
  * @param[in] data        = Pointer to process data segment.
  * @param[in] length      = Length of data segment in bytes.
+ * @param[in] offset      = Offset of datagram data in rx frame.
  * @param[in] DCO         = Offset position of DC frame.
+ * @param[in] datagram    = Position of the datagram in the frame plan of the group.
+ */
+static void ecx_pushindex(ec_idxstackT *idxstack, uint8 idx, uint8 group, void *data, uint16 length, uint16 offset,
+                          uint16 DCO, uint16 datagram)
+{
+   if(idxstack->pushed < EC_MAXBUF)
+   {
+      idxstack->idx[idxstack->pushed] = idx;
+      idxstack->group[idxstack->pushed] = group;
+      idxstack->data[idxstack->pushed] = data;
+      idxstack->length[idxstack->pushed] = length;
+      idxstack->offset[idxstack->pushed] = offset;
+      idxstack->dcoffset[idxstack->pushed] = DCO;
+      idxstack->datagram[idxstack->pushed] = datagram;
+      idxstack->pushed++;
+   }
+}
+
+/** 
+ * Clear the idx stack.
+ * 
+ * @param idxstack          = index stack of the send
+ */
+static void ecx_clearindex(ec_idxstackT *idxstack)  {
+
+   idxstack->pushed = 0;
+   idxstack->pulled = 0;
+
+}
+
+/** Bucket of a value in a process data histogram.
+ * @param[in]  value       = value
+ * @return bucket number
+ */
+static int ecx_hist_bucket(uint32 value)
+{
+   uint32 v;
+   int e = 0;
+
+   if (value < EC_HISTSUB)
+   {
+      return (int)value;
+   }
+   /* position of the highest bit set */
+   v = value;
+   if (v & 0xffff0000) { v >>= 16; e += 16; }
+   if (v & 0xff00) { v >>= 8; e += 8; }
+   if (v & 0xf0) { v >>= 4; e += 4; }
+   if (v & 0xc) { v >>= 2; e += 2; }
+   if (v & 0x2) { e += 1; }
+
+   return ((e - EC_HISTSUBBITS + 1) << EC_HISTSUBBITS) +
+          (int)(value >> (e - EC_HISTSUBBITS)) - EC_HISTSUB;
+}
+
+/** Add a value to a process data histogram, clamped to 0..2^32-1.
+ * @param[in]  hist        = histogram
+ * @param[in]  value       = value
+ */
+static void ecx_hist_add(ec_histt *hist, int64 value)
+{
+   uint32 v;
+
+   v = (value < 0) ? 0 : ((value > 0xffffffff) ? 0xffffffff : (uint32)value);
+   if (!hist->count || (v < hist->min))
+   {
+      hist->min = v;
+   }
+   if (v > hist->max)
+   {
+      hist->max = v;
+   }
+   hist->count++;
+   hist->sum += v;
+   hist->bucket[ecx_hist_bucket(v)]++;
+}
+
+/** Start an update of the process data statistics of a group. Readers retry
+ * while the sequence count is odd or changed under them.
+ * @param[in]  pdstat      = statistics of the group
+ */
+static void ecx_pdstat_begin(ec_pdstatt *pdstat)
+{
+   pdstat->seq++;
+   OSAL_RELEASE_BARRIER();
+   if (pdstat->reset)
+   {
+      pdstat->noframe = 0;
+      memset(pdstat->hist, 0x00, sizeof(pdstat->hist));
+      pdstat->reset = FALSE;
+   }
+}
+
+/** End an update of the process data statistics of a group.
+ * @param[in]  pdstat      = statistics of the group
+ */
+static void ecx_pdstat_end(ec_pdstatt *pdstat)
+{
+   OSAL_RELEASE_BARRIER();
+   pdstat->seq++;
+}
+
+/** Start the statistics of a receive of a group.
+ * @param[in]  grp         = group
+ */
+static void ecx_pdstat_rxstart(ec_groupt *grp)
+{
+   grp->pdstat.rtt = -1;
+   grp->pdstat.rxtime = 0;
+}
+
+/** Account a returned frame with datagrams of a group to its receive.
+ * The clock is only read for the last frame of a receive, the round trip of
+ * the other frames is only known from their timestamps.
+ * @param[in]  grp         = group
+ * @param[in]  frametime   = timestamps of the frame
+ * @param[in]  sendtime    = monotonic time the frame was sent
+ * @param[in]  rxtime      = monotonic time the frame returned, 0 if not read
+ */
+static void ecx_pdstat_rxframe(ec_groupt *grp, const ec_frametimet *frametime,
+                               int64 sendtime, int64 rxtime)
+{
+   int64 rtt = -1;
+
+   if (frametime->tx && frametime->rx)
+   {
+      rtt = frametime->rx - frametime->tx;
+   }
+   else if (rxtime)
+   {
+      rtt = rxtime - sendtime;
+   }
+   if (rtt > grp->pdstat.rtt)
+   {
+      grp->pdstat.rtt = rtt;
+   }
+   if (rxtime)
+   {
+      grp->pdstat.rxtime = rxtime;
+   }
+}
+
+/** Record the receive of a group in its statistics.
+ * @param[in]  grp         = group
+ * @param[in]  wkc         = workcounter of the group, EC_NOFRAME if no frame returned
+ * @param[in]  end         = monotonic time the receive ends
  */
-static void ecx_pushindex(ecx_contextt *context, uint8 idx, void *data, uint16 length, uint16 DCO)
+static void ecx_pdstat_rxend(ec_groupt *grp, int wkc, int64 end)
 {
-   if(context->idxstack->pushed < EC_MAXBUF)
+   ec_pdstatt *pdstat = &(grp->pdstat);
+   int miss;
+
+   miss = (grp->outputsWKC * 2) + grp->inputsWKC - ((wkc > EC_NOFRAME) ? wkc : 0);
+   ecx_pdstat_begin(pdstat);
+   if (wkc == EC_NOFRAME)
+   {
+      pdstat->noframe++;
+   }
+   if (pdstat->rtt >= 0)
+   {
+      ecx_hist_add(&(pdstat->hist[EC_PDSTAT_ROUNDTRIP]), pdstat->rtt);
+   }
+   if (pdstat->rxtime)
    {
-      context->idxstack->idx[context->idxstack->pushed] = idx;
-      context->idxstack->data[context->idxstack->pushed] = data;
-      context->idxstack->length[context->idxstack->pushed] = length;
-      context->idxstack->dcoffset[context->idxstack->pushed] = DCO;
-      context->idxstack->pushed++;
+      ecx_hist_add(&(pdstat->hist[EC_PDSTAT_RXPROC]), end - pdstat->rxtime);
    }
+   ecx_hist_add(&(pdstat->hist[EC_PDSTAT_WKCMISS]), (miss < 0) ? -miss : miss);
+   ecx_pdstat_end(pdstat);
+}
+
+/** Record the wakeup lateness of a cycle in the process data statistics of a
+ * group. The send and receive record everything else, the wakeup is only
+ * known to the thread running the cycle, see ecx_cyclic_run().
+ * @param[in]  context        = context struct
+ * @param[in]  group          = group number
+ * @param[in]  lateness       = wakeup after the deadline of the cycle in ns
+ */
+void ecx_pdstat_wakeup(ecx_contextt *context, uint8 group, int64 lateness)
+{
+   ec_pdstatt *pdstat = &(context->grouplist[group].pdstat);
+
+   ecx_pdstat_begin(pdstat);
+   ecx_hist_add(&(pdstat->hist[EC_PDSTAT_WAKEUP]), lateness);
+   ecx_pdstat_end(pdstat);
 }
 
-/** Pull index of segmented LRD/LWR/LRW combination.
+/** Read a consistent copy of the process data statistics of a group. Does
+ * not block the cycle, the copy is retried if the cycle thread updated the
+ * statistics while it was taken.
  * @param[in]  context        = context struct
- * @return Stack location, -1 if stack is empty.
+ * @param[in]  group          = group number
+ * @param[out] pdstat         = copy of the statistics
+ * @return 1 if the copy is consistent, 0 if the statistics kept changing
  */
-static int ecx_pullindex(ecx_contextt *context)
+int ecx_pdstat_read(ecx_contextt *context, uint8 group, ec_pdstatt *pdstat)
 {
-   int rval = -1;
-   if(context->idxstack->pulled < context->idxstack->pushed)
+   ec_pdstatt *src = &(context->grouplist[group].pdstat);
+   uint32 seq;
+   int retry;
+
+   for (retry = 0; retry < EC_PDSTAT_RETRIES; retry++)
    {
-      rval = context->idxstack->pulled;
-      context->idxstack->pulled++;
+      seq = src->seq;
+      OSAL_ACQUIRE_BARRIER();
+      if (!(seq & 1))
+      {
+         memcpy(pdstat, src, sizeof(ec_pdstatt));
+         OSAL_ACQUIRE_BARRIER();
+         if (src->seq == seq)
+         {
+            return 1;
+         }
+      }
+      osal_usleep(1);
    }
 
-   return rval;
+   return 0;
 }
 
-/** 
- * Clear the idx stack.
- * 
- * @param context           = context struct
+/** Clear the process data statistics of a group. The cycle thread clears
+ * them at its next update, so it is safe while the group is cycled.
+ * @param[in]  context        = context struct
+ * @param[in]  group          = group number
+ */
+void ecx_pdstat_reset(ecx_contextt *context, uint8 group)
+{
+   context->grouplist[group].pdstat.reset = TRUE;
+}
+
+/** Smallest value counted in a bucket of a process data histogram.
+ * @param[in]  bucket         = bucket number, 0 to EC_HISTBUCKETS - 1
+ * @return smallest value of the bucket
+ */
+uint32 ecx_pdstat_bucketstart(int bucket)
+{
+   int e;
+
+   if (bucket < EC_HISTSUB)
+   {
+      return (uint32)bucket;
+   }
+   e = (bucket >> EC_HISTSUBBITS) + EC_HISTSUBBITS - 1;
+
+   return (uint32)((bucket & (EC_HISTSUB - 1)) + EC_HISTSUB) << (e - EC_HISTSUBBITS);
+}
+
+/** Percentile of a process data histogram. Exact to the width of a bucket,
+ * the upper end of the bucket is returned, but never more than the largest
+ * value seen.
+ * @param[in]  hist           = histogram
+ * @param[in]  ppm            = part of the values in parts per million, e.g.
+ *                              500000 for the median, 999000 for the 99.9th
+ *                              percentile
+ * @return smallest value the part of the values is below or equal to, 0 if
+ * the histogram is empty
  */
-static void ecx_clearindex(ecx_contextt *context)  {
+uint32 ecx_pdstat_percentile(const ec_histt *hist, uint32 ppm)
+{
+   uint64 rank, n = 0;
+   uint32 upper;
+   int b;
 
-   context->idxstack->pushed = 0;
-   context->idxstack->pulled = 0;
+   if (!hist->count)
+   {
+      return 0;
+   }
+   if (ppm > 1000000)
+   {
+      ppm = 1000000;
+   }
+   rank = (hist->count * ppm + 999999) / 1000000;
+   if (!rank)
+   {
+      rank = 1;
+   }
+   for (b = 0; b < EC_HISTBUCKETS; b++)
+   {
+      n += hist->bucket[b];
+      if (n >= rank)
+      {
+         upper = ((b + 1) < EC_HISTBUCKETS) ? ecx_pdstat_bucketstart(b + 1) - 1 : 0xffffffff;
+         return (upper < hist->max) ? upper : hist->max;
+      }
+   }
 
+   return hist->max;
 }
 
-/** Transmit processdata to slaves.
- * Uses LRW, or LRD/LWR if LRW is not allowed (blockLRW).
- * Both the input and output processdata are transmitted.
- * The outputs with the actual data, the inputs have a placeholder.
- * The inputs are gathered with the receive processdata function.
- * In contrast to the base LRW function this function is non-blocking.
- * If the processdata does not fit in one datagram, multiple are used.
- * In order to recombine the slave response, a stack is used.
+/** Transmit the frame of a group in zero copy mode. The frame was built by
+ * the mapping and the outputs are written into it directly, only the DC
+ * datagram is added, removed or updated here.
  * @param[in]  context        = context struct
  * @param[in]  group          = group number
- * @param[in]  use_overlap_io = flag if overlapped iomap is used
  * @return >0 if processdata is transmitted.
  */
-static int ecx_main_send_processdata(ecx_contextt *context, uint8 group, boolean use_overlap_io)
+static int ecx_zerocopy_send_processdata(ecx_contextt *context, uint8 group)
+{
+   ec_groupt *grp;
+   ec_comt *datagramP;
+   uint16 dcnext, length;
+   uint8 idx;
+
+   grp = context->grouplist + group;
+   dcnext = grp->hasdc ? grp->DCnext : 0;
+   idx = grp->zcidx;
+   if (dcnext != grp->zcdcnext)
+   {
+      /* reset frame to the LRW datagram */
+      length = (uint16)grp->IOsegment[0];
+      datagramP = (ec_comt*)&(context->port->txbuf[idx][ETH_HEADERSIZE]);
+      datagramP->elength = htoes(EC_ECATTYPE + EC_HEADERSIZE + length);
+      datagramP->dlength = htoes(length);
+      context->port->txbuflength[idx] = ETH_HEADERSIZE + EC_HEADERSIZE + EC_WKCSIZE + length;
+      grp->zcdcoffset = 0;
+      if (dcnext)
+      {
+         /* FPRMW in second datagram */
+         grp->zcdcoffset = ecx_adddatagram(context->port, &(context->port->txbuf[idx]), EC_CMD_FRMW, idx,
+                                           FALSE, context->slavelist[dcnext].configadr,
+                                           ECT_REG_DCSYSTIME, sizeof(int64), context->DCtime);
+      }
+      grp->zcdcnext = dcnext;
+   }
+   else if (dcnext)
+   {
+      memcpy(&(context->port->txbuf[idx][ETH_HEADERSIZE + grp->zcdcoffset]), context->DCtime, sizeof(int64));
+   }
+   /* the driver may write the inputs from now on */
+   if (!(grp->zcseq & 1))
+   {
+      grp->zcseq++;
+   }
+   OSAL_RELEASE_BARRIER();
+   ecx_outframe_red(context->port, idx);
+
+   return 1;
+}
+
+/** Ethernet overhead of a frame on the wire, preamble, SFD, FCS and inter frame gap */
+#define EC_WIREOVERHEAD    (8 + 4 + 12)
+/** Minimum Ethernet frame size without FCS */
+#define EC_MINFRAMESIZE    60
+
+/** Expected workcounter of one process data datagram. Every slave with
+ * outputs starting in the datagram adds 2 for LRW and 1 for LWR, every slave
+ * with inputs starting in it adds 1 for LRW and LRD.
+ * @param[in]  context        = context struct
+ * @param[in]  group          = group number
+ * @param[in]  com            = command of the datagram
+ * @param[in]  start          = logical offset of the datagram in the group
+ * @param[in]  length         = length of the datagram data
+ * @param[in]  use_overlap_io = flag if overlapped iomap is used
+ * @return expected workcounter
+ */
+static uint16 ecx_pddatagram_wkc(ecx_contextt *context, uint8 group, uint8 com, uint32 start,
+                              uint32 length, boolean use_overlap_io)
+{
+   ec_groupt *grp;
+   ec_slavet *slv;
+   uint32 offset;
+   uint16 slave, wkc = 0;
+
+   grp = context->grouplist + group;
+   for (slave = 1; slave <= *(context->slavecount); slave++)
+   {
+      slv = &(context->slavelist[slave]);
+      if (group && (group != slv->group))
+      {
+         continue;
+      }
+      if (slv->Obits && slv->outputs && (com != EC_CMD_LRD))
+      {
+         offset = (uint32)(slv->outputs - grp->outputs);
+         if ((offset >= start) && (offset < (start + length)))
+         {
+            wkc += (com == EC_CMD_LRW) ? 2 : 1;
+         }
+      }
+      if (slv->Ibits && slv->inputs && (com != EC_CMD_LWR))
+      {
+         offset = (uint32)(slv->inputs - (use_overlap_io ? grp->inputs : grp->outputs));
+         if ((offset >= start) && (offset < (start + length)))
+         {
+            wkc++;
+         }
+      }
+   }
+   return wkc;
+}
+
+/** Append a datagram to the process data frame plan of a group. The datagram
+ * is packed into the frame of the previous one if both fit in one frame, the
+ * first frame keeps room for the DC datagram.
+ * @param[in]  context        = context struct
+ * @param[in]  group          = group number
+ * @param[in]  com            = command
+ * @param[in]  LogAdr         = logical address
+ * @param[in]  length         = length of the datagram data
+ * @param[in]  txdata         = source of the datagram data, NULL for none
+ * @param[in]  rxdata         = destination of the received data
+ * @param[in]  use_overlap_io = flag if overlapped iomap is used
+ * @return >0 if the datagram was added, 0 if the plan is full
+ */
+static int ecx_pdplan_add(ecx_contextt *context, uint8 group, uint8 com, uint32 LogAdr,
+                          uint16 length, uint8 *txdata, uint8 *rxdata, boolean use_overlap_io)
+{
+   ec_groupt *grp;
+   ec_pddatagramt *pdf, *prev, *head;
+   uint32 end, limit;
+
+   grp = context->grouplist + group;
+   if (grp->npddatagrams >= EC_MAXPDDATAGRAMS)
+   {
+      EC_PRINT("Process data plan of group %d full, more than %d datagrams\n",
+               group, EC_MAXPDDATAGRAMS);
+      return 0;
+   }
+   pdf = &(grp->pddatagram[grp->npddatagrams]);
+   memset(&(pdf->header), 0, sizeof(pdf->header));
+   pdf->header.command = com;
+   pdf->header.ADP = htoes(LO_WORD(LogAdr));
+   pdf->header.ADO = htoes(HI_WORD(LogAdr));
+   pdf->header.dlength = htoes(length);
+   pdf->txdata = txdata;
+   pdf->rxdata = rxdata;
+   pdf->length = length;
+   pdf->expectedWKC = ecx_pddatagram_wkc(context, group, com, LogAdr - grp->logstartaddr,
+                                         length, use_overlap_io);
+   pdf->offset = EC_HEADERSIZE;
+   pdf->packed = FALSE;
+   if (grp->npddatagrams)
+   {
+      prev = pdf - 1;
+      head = prev;
+      while (head->packed)
+      {
+         head--;
+      }
+      /* rx frame size of one full LRW datagram */
+      limit = EC_HEADERSIZE + EC_MAXLRWDATA + EC_WKCSIZE;
+      if (head == grp->pddatagram)
+      {
+         limit -= EC_FIRSTDCDATAGRAM;
+      }
+      end = prev->offset + prev->length + EC_WKCSIZE;
+      if ((end + EC_HEADERSIZE - EC_ELENGTHSIZE + length + EC_WKCSIZE) <= limit)
+      {
+         pdf->offset = (uint16)(end + EC_HEADERSIZE - EC_ELENGTHSIZE);
+         pdf->packed = TRUE;
+      }
+   }
+   grp->npddatagrams++;
+
+   return 1;
+}
+
+/** Compile the process data frames of a group into its frame plan.
+ * The plan holds the header, data pointers and expected workcounter of every
+ * datagram ecx_send_processdata_group() sends, so the send only copies them
+ * into the frame buffers. Uses LRW, or LRD/LWR if LRW is not allowed
+ * (blockLRW). Datagrams that fit together, like the LRD and LWR of a small
+ * group, share one frame. The mapping functions compile the plan, the send
+ * recompiles it if the group was remapped or is sent with the other IOmap
+ * layout. The DC datagram is added to the first frame at send.
+ * @param[in]  context        = context struct
+ * @param[in]  group          = group number
+ * @param[in]  use_overlap_io = flag if overlapped iomap is used
+ * @return number of datagrams in the plan, -1 if they do not fit in the plan,
+ * the plan is left empty then
+ */
+int ecx_compile_processdata_group(ecx_contextt *context, uint8 group, boolean use_overlap_io)
 {
+   ec_groupt *grp;
    uint32 LogAdr;
-   uint16 w1, w2;
    int length;
    uint16 sublength;
-   uint8 idx;
-   int wkc;
    uint8* data;
-   boolean first=FALSE;
    uint16 currentsegment = 0;
    uint32 iomapinputoffset;
-   uint16 DCO;
 
-   wkc = 0;
-   if(context->grouplist[group].hasdc)
-   {
-      first = TRUE;
-   }
+   grp = context->grouplist + group;
+   grp->npddatagrams = 0;
+   grp->pdoverlap = use_overlap_io;
+   grp->pdoutputs = grp->outputs;
+   grp->pdinputs = grp->inputs;
+   grp->pddcnext = 0;
 
    /* For overlapping IO map use the biggest */
    if(use_overlap_io == TRUE)
    {
       /* For overlap IOmap make the frame EQ big to biggest part */
-      length = (context->grouplist[group].Obytes > context->grouplist[group].Ibytes) ?
-         context->grouplist[group].Obytes : context->grouplist[group].Ibytes;
+      length = (grp->Obytes > grp->Ibytes) ? grp->Obytes : grp->Ibytes;
       /* Save the offset used to compensate where to save inputs when frame returns */
-      iomapinputoffset = context->grouplist[group].Obytes;
+      iomapinputoffset = grp->Obytes;
    }
    else
    {
-      length = context->grouplist[group].Obytes + context->grouplist[group].Ibytes;
+      length = grp->Obytes + grp->Ibytes;
       iomapinputoffset = 0;
    }
-   
-   LogAdr = context->grouplist[group].logstartaddr;
+
+   LogAdr = grp->logstartaddr;
    if(length)
    {
-
-      wkc = 1;
       /* LRW blocked by one or more slaves ? */
-      if(context->grouplist[group].blockLRW)
+      if(grp->blockLRW)
       {
          /* if inputs available generate LRD */
-         if(context->grouplist[group].Ibytes)
+         if(grp->Ibytes)
          {
-            currentsegment = context->grouplist[group].Isegment;
-            data = context->grouplist[group].inputs;
-            length = context->grouplist[group].Ibytes;
-            LogAdr += context->grouplist[group].Obytes;
+            currentsegment = grp->Isegment;
+            data = grp->inputs;
+            length = grp->Ibytes;
+            LogAdr += grp->Obytes;
             /* segment transfer if needed */
             do
             {
-               if(currentsegment == context->grouplist[group].Isegment)
+               if(currentsegment == grp->Isegment)
                {
-                  sublength = (uint16)(context->grouplist[group].IOsegment[currentsegment++] - context->grouplist[group].Ioffset);
+                  sublength = (uint16)(grp->IOsegment[currentsegment++] - grp->Ioffset);
                }
                else
                {
-                  sublength = (uint16)context->grouplist[group].IOsegment[currentsegment++];
+                  sublength = (uint16)grp->IOsegment[currentsegment++];
                }
-               /* get new index */
-               idx = ecx_getindex(context->port);
-               w1 = LO_WORD(LogAdr);
-               w2 = HI_WORD(LogAdr);
-               DCO = 0;
-               ecx_setupdatagram(context->port, &(context->port->txbuf[idx]), EC_CMD_LRD, idx, w1, w2, sublength, data);
-               if(first)
+               if (!ecx_pdplan_add(context, group, EC_CMD_LRD, LogAdr, sublength, NULL, data, use_overlap_io))
                {
-                  /* FPRMW in second datagram */
-                  DCO = ecx_adddatagram(context->port, &(context->port->txbuf[idx]), EC_CMD_FRMW, idx, FALSE,
-                                           context->slavelist[context->grouplist[group].DCnext].configadr,
-                                           ECT_REG_DCSYSTIME, sizeof(int64), context->DCtime);
-                  first = FALSE;
+                  grp->npddatagrams = 0;
+                  return -1;
                }
-               /* send frame */
-               ecx_outframe_red(context->port, idx);
-               /* push index and data pointer on stack */
-               ecx_pushindex(context, idx, data, sublength, DCO);
                length -= sublength;
                LogAdr += sublength;
                data += sublength;
-            } while (length && (currentsegment < context->grouplist[group].nsegments));
+            } while (length && (currentsegment < grp->nsegments));
          }
          /* if outputs available generate LWR */
-         if(context->grouplist[group].Obytes)
+         if(grp->Obytes)
          {
-            data = context->grouplist[group].outputs;
-            length = context->grouplist[group].Obytes;
-            LogAdr = context->grouplist[group].logstartaddr;
+            data = grp->outputs;
+            length = grp->Obytes;
+            LogAdr = grp->logstartaddr;
             currentsegment = 0;
             /* segment transfer if needed */
             do
             {
-               sublength = (uint16)context->grouplist[group].IOsegment[currentsegment++];
+               sublength = (uint16)grp->IOsegment[currentsegment++];
                if((length - sublength) < 0)
                {
                   sublength = (uint16)length;
                }
-               /* get new index */
-               idx = ecx_getindex(context->port);
-               w1 = LO_WORD(LogAdr);
-               w2 = HI_WORD(LogAdr);
-               DCO = 0;
-               ecx_setupdatagram(context->port, &(context->port->txbuf[idx]), EC_CMD_LWR, idx, w1, w2, sublength, data);
-               if(first)
+               if (!ecx_pdplan_add(context, group, EC_CMD_LWR, LogAdr, sublength, data, data, use_overlap_io))
                {
-                  /* FPRMW in second datagram */
-                  DCO = ecx_adddatagram(context->port, &(context->port->txbuf[idx]), EC_CMD_FRMW, idx, FALSE,
-                                           context->slavelist[context->grouplist[group].DCnext].configadr,
-                                           ECT_REG_DCSYSTIME, sizeof(int64), context->DCtime);
-                  first = FALSE;
+                  grp->npddatagrams = 0;
+                  return -1;
                }
-               /* send frame */
-               ecx_outframe_red(context->port, idx);
-               /* push index and data pointer on stack */
-               ecx_pushindex(context, idx, data, sublength, DCO);
                length -= sublength;
                LogAdr += sublength;
                data += sublength;
-            } while (length && (currentsegment < context->grouplist[group].nsegments));
+            } while (length && (currentsegment < grp->nsegments));
          }
       }
       /* LRW can be used */
       else
       {
-         if (context->grouplist[group].Obytes)
+         if (grp->Obytes)
          {
-            data = context->grouplist[group].outputs;
+            data = grp->outputs;
          }
          else
          {
-            data = context->grouplist[group].inputs;
+            data = grp->inputs;
             /* Clear offset, don't compensate for overlapping IOmap if we only got inputs */
             iomapinputoffset = 0;
          }
          /* segment transfer if needed */
          do
          {
-            sublength = (uint16)context->grouplist[group].IOsegment[currentsegment++];
-            /* get new index */
-            idx = ecx_getindex(context->port);
-            w1 = LO_WORD(LogAdr);
-            w2 = HI_WORD(LogAdr);
-            DCO = 0;
-            ecx_setupdatagram(context->port, &(context->port->txbuf[idx]), EC_CMD_LRW, idx, w1, w2, sublength, data);
-            if(first)
-            {
-               /* FPRMW in second datagram */
-               DCO = ecx_adddatagram(context->port, &(context->port->txbuf[idx]), EC_CMD_FRMW, idx, FALSE,
-                                        context->slavelist[context->grouplist[group].DCnext].configadr,
-                                        ECT_REG_DCSYSTIME, sizeof(int64), context->DCtime);
-               first = FALSE;
-            }
-            /* send frame */
-            ecx_outframe_red(context->port, idx);
-            /* push index and data pointer on stack.
-             * the iomapinputoffset compensate for where the inputs are stored 
+            sublength = (uint16)grp->IOsegment[currentsegment++];
+            /* the iomapinputoffset compensate for where the inputs are stored
              * in the IOmap if we use an overlapping IOmap. If a regular IOmap
              * is used it should always be 0.
              */
-            ecx_pushindex(context, idx, (data + iomapinputoffset), sublength, DCO);      
+            if (!ecx_pdplan_add(context, group, EC_CMD_LRW, LogAdr, sublength, data,
+                                data + iomapinputoffset, use_overlap_io))
+            {
+               grp->npddatagrams = 0;
+               return -1;
+            }
             length -= sublength;
             LogAdr += sublength;
             data += sublength;
-         } while (length && (currentsegment < context->grouplist[group].nsegments));
+         } while (length && (currentsegment < grp->nsegments));
       }
    }
 
-   return wkc;
+   return grp->npddatagrams;
 }
 
-/** Transmit processdata to slaves.
-* Uses LRW, or LRD/LWR if LRW is not allowed (blockLRW).
-* Both the input and output processdata are transmitted in the overlapped IOmap.
-* The outputs with the actual data, the inputs replace the output data in the
-* returning frame. The inputs are gathered with the receive processdata function.
-* In contrast to the base LRW function this function is non-blocking.
-* If the processdata does not fit in one datagram, multiple are used.
-* In order to recombine the slave response, a stack is used.
-* @param[in]  context        = context struct
-* @param[in]  group          = group number
-* @return >0 if processdata is transmitted.
-*/
-int ecx_send_overlap_processdata_group(ecx_contextt *context, uint8 group)
+/** Set up the DC datagram of the frame plan for the current DC slave of the
+ * group. Only does work when the DC configuration of the group changed, the
+ * send appends the datagram with ecx_pdframe_close().
+ * @param[in]  context        = context struct
+ * @param[in]  group          = group number
+ */
+static void ecx_pdplan_dc(ecx_contextt *context, uint8 group)
 {
-   return ecx_main_send_processdata(context, group, TRUE);
+   ec_groupt *grp;
+   uint16 dcnext;
+
+   grp = context->grouplist + group;
+   dcnext = grp->hasdc ? grp->DCnext : 0;
+   if ((dcnext == grp->pddcnext) || !grp->npddatagrams)
+   {
+      return;
+   }
+   if (dcnext)
+   {
+      /* FPRMW after the process data */
+      memset(&(grp->pddcheader), 0, sizeof(grp->pddcheader));
+      grp->pddcheader.command = EC_CMD_FRMW;
+      grp->pddcheader.ADP = htoes(context->slavelist[dcnext].configadr);
+      grp->pddcheader.ADO = htoes(ECT_REG_DCSYSTIME);
+      grp->pddcheader.dlength = htoes(sizeof(int64));
+   }
+   grp->pddcnext = dcnext;
 }
 
-/** Transmit processdata to slaves.
-* Uses LRW, or LRD/LWR if LRW is not allowed (blockLRW).
-* Both the input and output processdata are transmitted.
-* The outputs with the actual data, the inputs have a placeholder.
-* The inputs are gathered with the receive processdata function.
-* In contrast to the base LRW function this function is non-blocking.
-* If the processdata does not fit in one datagram, multiple are used.
-* In order to recombine the slave response, a stack is used.
-* @param[in]  context        = context struct
-* @param[in]  group          = group number
-* @return >0 if processdata is transmitted.
-*/
-int ecx_send_processdata_group(ecx_contextt *context, uint8 group)
+/** Size of the frame unit of a frame plan that starts at pddatagram[i], the
+ * datagram and the ones packed behind it, from the first datagram header
+ * after the frame length to the end of the last workcounter.
+ * @param[in]  grp            = group
+ * @param[in]  i              = first datagram of the unit
+ * @param[out] next           = first datagram after the unit
+ * @return size of the unit in bytes
+ */
+static uint16 ecx_pdunit_size(ec_groupt *grp, int i, int *next)
 {
-   return ecx_main_send_processdata(context, group, FALSE);
+   while (((i + 1) < grp->npddatagrams) && grp->pddatagram[i + 1].packed)
+   {
+      i++;
+   }
+   *next = i + 1;
+   return (uint16)(grp->pddatagram[i].offset + grp->pddatagram[i].length +
+                   EC_WKCSIZE - EC_ELENGTHSIZE);
 }
 
-/** Receive processdata from slaves.
- * Second part from ec_send_processdata().
- * Received datagrams are recombined with the processdata with help from the stack.
- * If a datagram contains input processdata it copies it to the processdata structure.
- * @param[in]  context        = context struct
- * @param[in]  group          = group number
- * @param[in]  timeout        = Timeout in us.
- * @return Work counter.
+/** Check if a frame unit fits behind the datagrams already in a frame. Uses
+ * the same limit as ecx_pdplan_add(), the frame with the DC datagram keeps
+ * room for it.
+ * @param[in]  fend           = end of the datagrams in the frame
+ * @param[in]  size           = size of the unit
+ * @param[in]  dcframe        = TRUE if the frame carries the DC datagram
+ * @return TRUE if the unit fits
  */
-int ecx_receive_processdata_group(ecx_contextt *context, uint8 group, int timeout)
+static boolean ecx_pdunit_fits(int fend, uint16 size, boolean dcframe)
 {
-   uint8 idx;
-   int pos;
-   int wkc = 0, wkc2;
-   uint16 le_wkc = 0;
-   int valid_wkc = 0;
-   int64 le_DCtime;
-   ec_idxstackT *idxstack;
-   ec_bufT *rxbuf;
+   int limit;
 
-   /* just to prevent compiler warning for unused group */
-   wkc2 = group;
-
-   idxstack = context->idxstack;
-   rxbuf = context->port->rxbuf;
-   /* get first index */
-   pos = ecx_pullindex(context);
-   /* read the same number of frames as send */
-   while (pos >= 0)
+   /* rx frame size of one full LRW datagram */
+   limit = EC_HEADERSIZE + EC_MAXLRWDATA + EC_WKCSIZE;
+   if (dcframe)
    {
-      idx = idxstack->idx[pos];
-      wkc2 = ecx_waitinframe(context->port, idx, timeout);
-      /* check if there is input data in frame */
-      if (wkc2 > EC_NOFRAME)
+      limit -= EC_FIRSTDCDATAGRAM;
+   }
+   return ((fend + size) <= limit);
+}
+
+/** Finish a process data frame, append the DC datagram if it is the DC frame
+ * and set the frame length.
+ * @param[in]  context        = context struct
+ * @param[in]  idx            = index of the frame
+ * @param[in]  fend           = end of the datagrams in the frame
+ * @param[in]  lastpos        = position of the data of the last datagram
+ * @param[in]  dcgrp          = group that carries the DC datagram, NULL if
+ *                              this is not the DC frame
+ * @param[in]  idxstack       = index stack of the send
+ * @param[in]  dcpos          = stack location of the last datagram
+ */
+static void ecx_pdframe_close(ecx_contextt *context, int idx, int fend, int lastpos,
+                              ec_groupt *dcgrp, ec_idxstackT *idxstack, int dcpos)
+{
+   uint8 *frameP;
+   ec_comt *datagramP;
+
+   frameP = context->port->txbuf[idx];
+   if (dcgrp && (dcpos >= 0))
+   {
+      /* FPRMW after the process data */
+      datagramP = (ec_comt *)&frameP[lastpos - EC_HEADERSIZE];
+      datagramP->dlength = htoes(etohs(datagramP->dlength) | EC_DATAGRAMFOLLOWS);
+      memcpy(&frameP[ETH_HEADERSIZE + fend], &(dcgrp->pddcheader.command),
+             EC_HEADERSIZE - EC_ELENGTHSIZE);
+      frameP[ETH_HEADERSIZE + fend + 1] = (uint8)idx;
+      fend += EC_HEADERSIZE - EC_ELENGTHSIZE;
+      memcpy(&frameP[ETH_HEADERSIZE + fend], context->DCtime, sizeof(int64));
+      idxstack->dcoffset[dcpos] = (uint16)fend;
+      fend += sizeof(int64);
+      frameP[ETH_HEADERSIZE + fend] = 0x00;
+      frameP[ETH_HEADERSIZE + fend + 1] = 0x00;
+      fend += EC_WKCSIZE;
+   }
+   datagramP = (ec_comt *)&frameP[ETH_HEADERSIZE];
+   datagramP->elength = htoes(EC_ECATTYPE + fend - EC_ELENGTHSIZE);
+   context->port->txbuflength[idx] = ETH_HEADERSIZE + fend;
+}
+
+/** Transmit processdata of one or more groups to slaves.
+ * Uses LRW, or LRD/LWR if LRW is not allowed (blockLRW).
+ * Both the input and output processdata are transmitted.
+ * The outputs with the actual data, the inputs have a placeholder.
+ * The inputs are gathered with the receive processdata function.
+ * In contrast to the base LRW function this function is non-blocking.
+ * If the processdata does not fit in one datagram, multiple are used, packed
+ * into as few frames as possible.
+ * The frames of a group come from the plan of
+ * ecx_compile_processdata_group(). With more groups a frame of the next
+ * group is packed into the last frame of the previous one if it fits, so
+ * groups that are due in the same cycle share frames. The DC datagram is
+ * sent once, in the first frame, for the first group with DC.
+ * In order to recombine the slave response, a stack is used.
+ * Every group has its own stack, a send of more groups uses the one of the
+ * first group, so groups can be sent and received from different threads.
+ * With context->pipeline set every send gets its own stack instead, up to
+ * EC_MAXPIPELINE sends can be in flight before the oldest is received, all
+ * from one thread.
+ * Zero copy groups are sent in their own pinned frame.
+ * @param[in]  context        = context struct
+ * @param[in]  groups         = groups to send
+ * @param[in]  ngroups        = number of groups
+ * @param[in]  use_overlap_io = flag if overlapped iomap is used
+ * @param[out] sentstack      = index stack of the frames sent, NULL if none
+ * @return >0 if processdata is transmitted.
+ */
+static int ecx_send_pdframes(ecx_contextt *context, const uint8 *groups, int ngroups,
+                             boolean use_overlap_io, ec_idxstackT **sentstack)
+{
+   ec_groupt *grp, *dcgrp = NULL;
+   ec_pddatagramt *pdf;
+   ec_comt *datagramP;
+   uint8 *frameP = NULL;
+   int idx = -1, g, i, next = 0;
+   int pos, fend = 0, base = 0, lastpos = 0, dcpos = 0;
+   int first = -1, fgroup = -1, sent = 0;
+   uint16 size;
+   uint8 txidx[EC_MAXBUF];
+   int ntx = 0;
+   ec_pipelinet *pipeline;
+   ec_idxstackT *idxstack;
+
+   for (g = 0; g < ngroups; g++)
+   {
+      grp = context->grouplist + groups[g];
+      if (grp->zerocopy)
+      {
+         sent += ecx_zerocopy_send_processdata(context, groups[g]);
+      }
+      else if (first < 0)
+      {
+         first = g;
+      }
+   }
+   if (first < 0)
+   {
+      return sent;
+   }
+   pipeline = context->pipeline;
+   idxstack = &(context->grouplist[groups[first]].idxstack);
+   if (pipeline)
+   {
+      if (pipeline->inflight >= EC_MAXPIPELINE)
+      {
+         /* the oldest send has to be received first */
+         return sent;
+      }
+      idxstack = &(pipeline->stack[(pipeline->oldest + pipeline->inflight) % EC_MAXPIPELINE]);
+      ecx_clearindex(idxstack);
+   }
+   for (g = first; g < ngroups; g++)
+   {
+      grp = context->grouplist + groups[g];
+      if (grp->zerocopy)
+      {
+         continue;
+      }
+      /* group remapped or sent with the other IOmap layout */
+      if ((grp->pdoverlap != use_overlap_io) || (grp->pdoutputs != grp->outputs) ||
+          (grp->pdinputs != grp->inputs))
+      {
+         ecx_compile_processdata_group(context, groups[g], use_overlap_io);
+      }
+      ecx_pdplan_dc(context, groups[g]);
+      if (!dcgrp && grp->npddatagrams && grp->pddcnext)
+      {
+         dcgrp = grp;
+      }
+   }
+
+   for (g = first; g < ngroups; g++)
+   {
+      grp = context->grouplist + groups[g];
+      if (grp->zerocopy)
+      {
+         continue;
+      }
+      for (i = 0; i < grp->npddatagrams; i++)
       {
-         if((rxbuf[idx][EC_CMDOFFSET]==EC_CMD_LRD) || (rxbuf[idx][EC_CMDOFFSET]==EC_CMD_LRW))
+         pdf = &(grp->pddatagram[i]);
+         if (!pdf->packed)
          {
-            if(idxstack->dcoffset[pos] > 0)
+            size = ecx_pdunit_size(grp, i, &next);
+            if ((idx >= 0) && (fgroup != groups[g]) &&
+                ecx_pdunit_fits(fend, size, (ntx == 1) && dcgrp))
             {
-               memcpy(idxstack->data[pos], &(rxbuf[idx][EC_HEADERSIZE]), idxstack->length[pos]);
-               memcpy(&le_wkc, &(rxbuf[idx][EC_HEADERSIZE + idxstack->length[pos]]), EC_WKCSIZE);
-               wkc = etohs(le_wkc);
-               memcpy(&le_DCtime, &(rxbuf[idx][idxstack->dcoffset[pos]]), sizeof(le_DCtime));
-               *(context->DCtime) = etohll(le_DCtime);
+               /* frame of this group shares the frame of the previous group */
+               datagramP = (ec_comt *)&frameP[lastpos - EC_HEADERSIZE];
+               datagramP->dlength = htoes(etohs(datagramP->dlength) | EC_DATAGRAMFOLLOWS);
             }
             else
             {
-               /* copy input data back to process data buffer */
-               memcpy(idxstack->data[pos], &(rxbuf[idx][EC_HEADERSIZE]), idxstack->length[pos]);
-               wkc += wkc2;
+               if (idx >= 0)
+               {
+                  ecx_pdframe_close(context, idx, fend, lastpos,
+                                    (ntx == 1) ? dcgrp : NULL, idxstack, dcpos);
+               }
+               /* get new index */
+               idx = ecx_getindex_part(context->port, EC_IDXPART_RT);
+               if (idx < 0)
+               {
+                  /* all indexes in flight, the remaining frames are not sent */
+                  goto sendframes;
+               }
+               frameP = context->port->txbuf[idx];
+               txidx[ntx++] = (uint8)idx;
+               fend = EC_ELENGTHSIZE;
             }
-            valid_wkc = 1;
+            /* plan offsets are for a frame of its own */
+            base = fend - EC_ELENGTHSIZE;
+            fgroup = groups[g];
          }
-         else if(rxbuf[idx][EC_CMDOFFSET]==EC_CMD_LWR)
+         else
          {
-            if(idxstack->dcoffset[pos] > 0)
-            {
-               memcpy(&le_wkc, &(rxbuf[idx][EC_HEADERSIZE + idxstack->length[pos]]), EC_WKCSIZE);
-               /* output WKC counts 2 times when using LRW, emulate the same for LWR */
-               wkc = etohs(le_wkc) * 2;
-               memcpy(&le_DCtime, &(rxbuf[idx][idxstack->dcoffset[pos]]), sizeof(le_DCtime));
-               *(context->DCtime) = etohll(le_DCtime);
-            }
-            else
+            datagramP = (ec_comt *)&frameP[lastpos - EC_HEADERSIZE];
+            datagramP->dlength = htoes(etohs(datagramP->dlength) | EC_DATAGRAMFOLLOWS);
+         }
+         pos = ETH_HEADERSIZE + base + pdf->offset;
+         /* EtherCAT header, the frame length is set when the frame is closed */
+         memcpy(&frameP[pos - EC_HEADERSIZE + EC_ELENGTHSIZE], &(pdf->header.command),
+                EC_HEADERSIZE - EC_ELENGTHSIZE);
+         datagramP = (ec_comt *)&frameP[pos - EC_HEADERSIZE];
+         datagramP->index = (uint8)idx;
+         datagramP->dlength = htoes(etohs(datagramP->dlength) & ~EC_DATAGRAMFOLLOWS);
+         if (pdf->txdata)
+         {
+            memcpy(&frameP[pos], pdf->txdata, pdf->length);
+         }
+         else
+         {
+            memset(&frameP[pos], 0, pdf->length);
+         }
+         /* set WKC to zero */
+         frameP[pos + pdf->length] = 0x00;
+         frameP[pos + pdf->length + 1] = 0x00;
+         lastpos = pos;
+         fend = pos + pdf->length + EC_WKCSIZE - ETH_HEADERSIZE;
+         /* push index and data pointer on stack */
+         ecx_pushindex(idxstack, (uint8)idx, groups[g], pdf->rxdata, pdf->length,
+                       (uint16)(pos - ETH_HEADERSIZE), 0, (uint16)i);
+         dcpos = idxstack->pushed - 1;
+      }
+   }
+   if (idx >= 0)
+   {
+      ecx_pdframe_close(context, idx, fend, lastpos, (ntx == 1) ? dcgrp : NULL, idxstack, dcpos);
+   }
+
+sendframes:
+   if (!ntx)
+   {
+      return sent;
+   }
+   /* send all frames */
+   ecx_outframe_red_batch(context->port, txidx, ntx);
+   *sentstack = idxstack;
+   if (pipeline)
+   {
+      pipeline->group[(pipeline->oldest + pipeline->inflight) % EC_MAXPIPELINE] = groups[first];
+      pipeline->inflight++;
+   }
+
+   return 1;
+}
+
+/** Transmit processdata of one or more groups to slaves, see
+ * ecx_send_pdframes(). The send time is recorded in the statistics of the
+ * groups and kept for the round trip of frames without timestamps.
+ * @param[in]  context        = context struct
+ * @param[in]  groups         = groups to send
+ * @param[in]  ngroups        = number of groups
+ * @param[in]  use_overlap_io = flag if overlapped iomap is used
+ * @return >0 if processdata is transmitted.
+ */
+static int ecx_main_send_processdata(ecx_contextt *context, const uint8 *groups, int ngroups,
+                                     boolean use_overlap_io)
+{
+   ec_idxstackT *idxstack = NULL;
+   ec_groupt *grp;
+   int64 start, end;
+   int g, sent;
+
+   start = osal_monotonic_time();
+   sent = ecx_send_pdframes(context, groups, ngroups, use_overlap_io, &idxstack);
+   end = osal_monotonic_time();
+   if (idxstack)
+   {
+      idxstack->sendtime = end;
+   }
+   for (g = 0; g < ngroups; g++)
+   {
+      grp = context->grouplist + groups[g];
+      if (grp->zerocopy)
+      {
+         grp->idxstack.sendtime = end;
+      }
+      ecx_pdstat_begin(&(grp->pdstat));
+      ecx_hist_add(&(grp->pdstat.hist[EC_PDSTAT_SEND]), end - start);
+      ecx_pdstat_end(&(grp->pdstat));
+   }
+
+   return sent;
+}
+
+/** Transmit processdata of more groups to slaves, sharing frames.
+ * Frames of the groups are packed together where they fit, see
+ * ecx_send_processdata_group(). Receive with
+ * ecx_receive_processdata_groups() and the same list of groups.
+ * @param[in]  context        = context struct
+ * @param[in]  groups         = groups to send
+ * @param[in]  ngroups        = number of groups
+ * @return >0 if processdata is transmitted.
+ */
+int ecx_send_processdata_groups(ecx_contextt *context, const uint8 *groups, int ngroups)
+{
+   return ecx_main_send_processdata(context, groups, ngroups, FALSE);
+}
+
+/** Transmit processdata of more groups in the overlapped IOmap to slaves,
+ * sharing frames. See ecx_send_processdata_groups().
+ * @param[in]  context        = context struct
+ * @param[in]  groups         = groups to send
+ * @param[in]  ngroups        = number of groups
+ * @return >0 if processdata is transmitted.
+ */
+int ecx_send_overlap_processdata_groups(ecx_contextt *context, const uint8 *groups, int ngroups)
+{
+   return ecx_main_send_processdata(context, groups, ngroups, TRUE);
+}
+
+/** Size of a process data frame on the wire.
+ * @param[in]  fend           = end of the datagrams in the frame
+ * @return size on the wire in bytes
+ */
+static int ecx_pdframe_wiresize(int fend)
+{
+   if ((ETH_HEADERSIZE + fend) < EC_MINFRAMESIZE)
+   {
+      fend = EC_MINFRAMESIZE - ETH_HEADERSIZE;
+   }
+   return ETH_HEADERSIZE + fend + EC_WIREOVERHEAD;
+}
+
+/** Size on the wire of the process data frames of one or more groups, from
+ * their frame plans. Counts the Ethernet header, padding to the minimum frame
+ * size, FCS, preamble and inter frame gap of every frame, so at 100Mbit/s
+ * every byte takes 80ns of bus time.
+ * @param[in]  context        = context struct
+ * @param[in]  groups         = groups
+ * @param[in]  ngroups        = number of groups
+ * @param[in]  shared         = TRUE if the groups are sent together with
+ *                              ecx_send_processdata_groups()
+ * @param[out] frames         = number of frames, NULL if not needed
+ * @return size on the wire in bytes
+ */
+int ecx_processdata_groups_wiresize(ecx_contextt *context, const uint8 *groups, int ngroups,
+                                    boolean shared, int *frames)
+{
+   ec_groupt *grp;
+   int g, i, next, fend = 0, nframes = 0, nshared = 0, wire = 0, fgroup = -1;
+   boolean own, dc = FALSE;
+   uint16 size;
+
+   for (g = 0; shared && (g < ngroups); g++)
+   {
+      grp = context->grouplist + groups[g];
+      if (!grp->zerocopy && grp->hasdc && grp->DCnext && grp->npddatagrams)
+      {
+         dc = TRUE;
+      }
+   }
+   for (g = 0; g < ngroups; g++)
+   {
+      grp = context->grouplist + groups[g];
+      own = !shared || grp->zerocopy;
+      for (i = 0; i < grp->npddatagrams; i = next)
+      {
+         size = ecx_pdunit_size(grp, i, &next);
+         if (own)
+         {
+            /* frames of the plan as they are */
+            nframes++;
+            wire += ecx_pdframe_wiresize(EC_ELENGTHSIZE + size +
+               (((i == 0) && grp->hasdc && grp->DCnext) ? EC_FIRSTDCDATAGRAM : 0));
+         }
+         else if (nshared && (fgroup != groups[g]) &&
+                  ecx_pdunit_fits(fend, size, (nshared == 1) && dc))
+         {
+            fend += size;
+         }
+         else
+         {
+            if (nshared)
             {
-               /* output WKC counts 2 times when using LRW, emulate the same for LWR */
-               wkc += wkc2 * 2;
+               wire += ecx_pdframe_wiresize(fend + (((nshared == 1) && dc) ? EC_FIRSTDCDATAGRAM : 0));
             }
-            valid_wkc = 1;
+            nshared++;
+            fend = EC_ELENGTHSIZE + size;
+            fgroup = groups[g];
+         }
+      }
+   }
+   if (nshared)
+   {
+      wire += ecx_pdframe_wiresize(fend + (((nshared == 1) && dc) ? EC_FIRSTDCDATAGRAM : 0));
+   }
+   if (frames)
+   {
+      *frames = nframes + nshared;
+   }
+   return wire;
+}
+
+/** Transmit processdata to slaves.
+* Uses LRW, or LRD/LWR if LRW is not allowed (blockLRW).
+* Both the input and output processdata are transmitted in the overlapped IOmap.
+* The outputs with the actual data, the inputs replace the output data in the
+* returning frame. The inputs are gathered with the receive processdata function.
+* In contrast to the base LRW function this function is non-blocking.
+* If the processdata does not fit in one datagram, multiple are used.
+* In order to recombine the slave response, a stack is used.
+* @param[in]  context        = context struct
+* @param[in]  group          = group number
+* @return >0 if processdata is transmitted.
+*/
+int ecx_send_overlap_processdata_group(ecx_contextt *context, uint8 group)
+{
+   return ecx_main_send_processdata(context, &group, 1, TRUE);
+}
+
+/** Transmit processdata to slaves.
+* Uses LRW, or LRD/LWR if LRW is not allowed (blockLRW).
+* Both the input and output processdata are transmitted.
+* The outputs with the actual data, the inputs have a placeholder.
+* The inputs are gathered with the receive processdata function.
+* In contrast to the base LRW function this function is non-blocking.
+* If the processdata does not fit in one datagram, multiple are used.
+* In order to recombine the slave response, a stack is used.
+* @param[in]  context        = context struct
+* @param[in]  group          = group number
+* @return >0 if processdata is transmitted.
+*/
+int ecx_send_processdata_group(ecx_contextt *context, uint8 group)
+{
+   return ecx_main_send_processdata(context, &group, 1, FALSE);
+}
+
+/** Receive the frame of a group in zero copy mode. The inputs are left in
+ * the rx buffer of the pinned frame index, only the workcounter and the DC
+ * time are read.
+ * @param[in]  context        = context struct
+ * @param[in]  group          = group number
+ * @param[in]  timeout        = Timeout in us.
+ * @return Work counter.
+ */
+static int ecx_zerocopy_receive_processdata(ecx_contextt *context, uint8 group, int timeout)
+{
+   ec_groupt *grp;
+   ec_bufT *rxbuf;
+   int wkc = EC_NOFRAME, wkc2;
+   uint16 le_wkc;
+   int64 le_DCtime, rxtime;
+   uint8 idx;
+
+   grp = context->grouplist + group;
+   ecx_pdstat_rxstart(grp);
+   rxbuf = context->port->rxbuf;
+   idx = grp->zcidx;
+   wkc2 = ecx_waitinframe(context->port, idx, timeout);
+   rxtime = osal_monotonic_time();
+   if (wkc2 > EC_NOFRAME)
+   {
+      if (grp->zcdcnext)
+      {
+         /* workcounter of LRW datagram, the frame returns the one of FRMW */
+         memcpy(&le_wkc, &(rxbuf[idx][EC_HEADERSIZE + grp->IOsegment[0]]), EC_WKCSIZE);
+         wkc = etohs(le_wkc);
+         memcpy(&le_DCtime, &(rxbuf[idx][grp->zcdcoffset]), sizeof(le_DCtime));
+         *(context->DCtime) = etohll(le_DCtime);
+      }
+      else
+      {
+         wkc = wkc2;
+      }
+   }
+   ecx_getframetime(context->port, idx, &(grp->frametime[0]));
+   grp->nframetime = 1;
+   if (wkc2 > EC_NOFRAME)
+   {
+      ecx_pdstat_rxframe(grp, &(grp->frametime[0]), grp->idxstack.sendtime, rxtime);
+   }
+   /* keep index pinned to the group */
+   ecx_setbufstat(context->port, idx, EC_BUF_ALLOC);
+
+   /* late frames are dropped now that the index is not in flight */
+   OSAL_RELEASE_BARRIER();
+   if (grp->zcseq & 1)
+   {
+      grp->zcseq++;
+   }
+
+   ecx_pdstat_rxend(grp, wkc, osal_monotonic_time());
+   return wkc;
+}
+
+/** Read a consistent copy of zero copy inputs of a group from any thread.
+ * The inputs live in the rx buffer of the frame and change while the frame
+ * is in flight, the copy is retried until it was taken between the receive
+ * and the next send of the group. The thread cycling the group can access
+ * the inputs directly after the receive.
+ * @param[in]  context        = context struct
+ * @param[in]  group          = group number
+ * @param[in]  src            = start within the inputs of the group, f.e.
+ *                              slavelist[slave].inputs
+ * @param[out] dst            = copy of the inputs
+ * @param[in]  length         = bytes to copy
+ * @return 1 if the copy is consistent, 0 if the frame stayed in flight
+ */
+int ecx_zerocopy_read(ecx_contextt *context, uint8 group, const uint8 *src, void *dst, uint32 length)
+{
+   ec_groupt *grp = &(context->grouplist[group]);
+   uint32 seq;
+   int retry;
+
+   for (retry = 0; retry < EC_ZCREAD_RETRIES; retry++)
+   {
+      seq = grp->zcseq;
+      OSAL_ACQUIRE_BARRIER();
+      if (!(seq & 1))
+      {
+         memcpy(dst, src, length);
+         OSAL_ACQUIRE_BARRIER();
+         if (grp->zcseq == seq)
+         {
+            return 1;
+         }
+      }
+      osal_usleep(1);
+   }
+
+   return 0;
+}
+
+/** Select the index stack of the send a receive completes.
+ * @param[in]     context     = context struct
+ * @param[in,out] group       = group number, with context->pipeline set the
+ *                              group of the oldest send in flight
+ * @return index stack, NULL if no send is in flight
+ */
+static ec_idxstackT *ecx_receive_idxstack(ecx_contextt *context, uint8 *group)
+{
+   ec_pipelinet *pipeline;
+   ec_idxstackT *idxstack;
+
+   pipeline = context->pipeline;
+   if (!pipeline)
+   {
+      return &(context->grouplist[*group].idxstack);
+   }
+   if (!pipeline->inflight)
+   {
+      return NULL;
+   }
+   /* complete the oldest send in flight */
+   idxstack = &(pipeline->stack[pipeline->oldest]);
+   *group = pipeline->group[pipeline->oldest];
+   pipeline->oldest = (uint16)((pipeline->oldest + 1) % EC_MAXPIPELINE);
+   pipeline->inflight--;
+
+   return idxstack;
+}
+
+/** Recombine the datagrams of one received process data frame with the
+ * processdata.
+ * @param[in]  context        = context struct
+ * @param[in]  idxstack       = index stack of the send
+ * @param[in]  pos            = stack location of the first datagram of the frame
+ * @param[in]  groups         = groups of the send
+ * @param[in]  ngroups        = number of groups
+ * @param[in]  wkc2           = result of the receive of the frame
+ * @param[in]  callback       = called for every datagram if the frame arrived, NULL for none
+ * @param[in,out] wkc         = workcounter of the datagrams is added, per group,
+ *                              EC_NOFRAME until a datagram of the group arrived
+ * @return stack location after the datagrams of the frame
+ */
+static int ecx_receive_pdframe(ecx_contextt *context, ec_idxstackT *idxstack, int pos,
+                               const uint8 *groups, int ngroups, int wkc2, ec_pdreadyt callback,
+                               int *wkc)
+{
+   uint8 idx, command;
+   uint16 offset, le_wkc;
+   int64 le_DCtime;
+   ec_bufT *rxbuf;
+   int g;
+
+   rxbuf = context->port->rxbuf;
+   idx = idxstack->idx[pos];
+   /* demux the datagrams packed into the frame */
+   do
+   {
+      offset = idxstack->offset[pos];
+      /* check if there is input data in frame */
+      if (wkc2 > EC_NOFRAME)
+      {
+         g = 0;
+         while (((g + 1) < ngroups) && (groups[g] != idxstack->group[pos]))
+         {
+            g++;
+         }
+         memcpy(&le_wkc, &(rxbuf[idx][offset + idxstack->length[pos]]), EC_WKCSIZE);
+         command = rxbuf[idx][offset - EC_HEADERSIZE + EC_CMDOFFSET];
+         if((command == EC_CMD_LRD) || (command == EC_CMD_LRW))
+         {
+            /* copy input data back to process data buffer */
+            memcpy(idxstack->data[pos], &(rxbuf[idx][offset]), idxstack->length[pos]);
+            wkc[g] = ((wkc[g] > EC_NOFRAME) ? wkc[g] : 0) + etohs(le_wkc);
          }
+         else if(command == EC_CMD_LWR)
+         {
+            /* output WKC counts 2 times when using LRW, emulate the same for LWR */
+            wkc[g] = ((wkc[g] > EC_NOFRAME) ? wkc[g] : 0) + etohs(le_wkc) * 2;
+         }
+         if(idxstack->dcoffset[pos] > 0)
+         {
+            memcpy(&le_DCtime, &(rxbuf[idx][idxstack->dcoffset[pos]]), sizeof(le_DCtime));
+            *(context->DCtime) = etohll(le_DCtime);
+         }
+         if (callback)
+         {
+            callback(context, idxstack->group[pos], idxstack->datagram[pos], etohs(le_wkc));
+         }
+      }
+      pos++;
+   } while ((pos < idxstack->pushed) && (idxstack->idx[pos] == idx));
+
+   return pos;
+}
+
+/** Receive processdata from slaves.
+ * Second part from ec_send_processdata().
+ * Received datagrams are recombined with the processdata with help from the stack.
+ * If a datagram contains input processdata it copies it to the processdata structure.
+ * The software timestamps of the frames are kept in the frametime list of the group.
+ * With context->pipeline set it completes the oldest send in flight, receives
+ * have to be called in the order of the sends.
+ * @param[in]  context        = context struct
+ * @param[in]  group          = group number
+ * @param[in]  timeout        = Timeout in us.
+ * @return Work counter.
+ */
+int ecx_receive_processdata_group(ecx_contextt *context, uint8 group, int timeout)
+{
+   uint8 idx;
+   int pos;
+   int wkc = EC_NOFRAME, wkc2;
+   int64 rxtime;
+   ec_idxstackT *idxstack;
+   ec_groupt *grp;
+
+   if (context->grouplist[group].zerocopy)
+   {
+      return ecx_zerocopy_receive_processdata(context, group, timeout);
+   }
+   idxstack = ecx_receive_idxstack(context, &group);
+   if (!idxstack)
+   {
+      return EC_NOFRAME;
+   }
+   grp = context->grouplist + group;
+   grp->nframetime = 0;
+   ecx_pdstat_rxstart(grp);
+   pos = 0;
+   /* read the same number of frames as send */
+   while (pos < idxstack->pushed)
+   {
+      idx = idxstack->idx[pos];
+      wkc2 = ecx_waitinframe(context->port, idx, timeout);
+      rxtime = (idx == idxstack->idx[idxstack->pushed - 1]) ? osal_monotonic_time() : 0;
+      pos = ecx_receive_pdframe(context, idxstack, pos, &group, 1, wkc2, NULL, &wkc);
+      /* keep timestamps of frame before its index is reused */
+      ecx_getframetime(context->port, idx, &(grp->frametime[grp->nframetime]));
+      if (wkc2 > EC_NOFRAME)
+      {
+         ecx_pdstat_rxframe(grp, &(grp->frametime[grp->nframetime]), idxstack->sendtime, rxtime);
       }
+      grp->nframetime++;
       /* release buffer */
       ecx_setbufstat(context->port, idx, EC_BUF_EMPTY);
-      /* get next index */
-      pos = ecx_pullindex(context);
    }
 
-   ecx_clearindex(context);
+   ecx_clearindex(idxstack);
+   ecx_pdstat_rxend(grp, wkc, osal_monotonic_time());
 
-   /* if no frames has arrived */
-   if (valid_wkc == 0)
+   /* EC_NOFRAME if no frames has arrived */
+   return wkc;
+}
+
+/** Receive processdata from slaves, streaming.
+ * Like ecx_receive_processdata_group() but the frames are recombined in the
+ * order they arrive. The callback is called for every datagram as soon as its
+ * frame is in, with the inputs of the datagram already in the IOmap. The
+ * datagram number is the position in grouplist[group].pddatagram, the
+ * workcounter is the one of the datagram alone. Control code for the first
+ * segments can so start before the last frame returned. The frametime list
+ * of the group stays in send order. Zero copy groups are received in order
+ * without callbacks.
+ * @param[in]  context        = context struct
+ * @param[in]  group          = group number
+ * @param[in]  timeout        = Timeout in us, for every frame.
+ * @param[in]  callback       = called for every datagram received, NULL for none
+ * @return Work counter.
+ */
+int ecx_receive_processdata_group_stream(ecx_contextt *context, uint8 group, int timeout,
+                                         ec_pdreadyt callback)
+{
+   int pos, n, npending, k, f;
+   int wkc = EC_NOFRAME, wkc2;
+   uint8 pidx[EC_MAXBUF];
+   uint8 pframe[EC_MAXBUF];
+   uint16 fpos[EC_MAXBUF];
+   int64 rxtime;
+   ec_idxstackT *idxstack;
+   ec_groupt *grp;
+
+   if (context->grouplist[group].zerocopy)
+   {
+      return ecx_zerocopy_receive_processdata(context, group, timeout);
+   }
+   idxstack = ecx_receive_idxstack(context, &group);
+   if (!idxstack)
    {
       return EC_NOFRAME;
    }
+   grp = context->grouplist + group;
+   /* frames of the send and stack location of their first datagram */
+   n = 0;
+   for (pos = 0; (pos < idxstack->pushed) && (n < EC_MAXBUF); pos++)
+   {
+      if (!pos || (idxstack->idx[pos] != idxstack->idx[pos - 1]))
+      {
+         pidx[n] = idxstack->idx[pos];
+         pframe[n] = (uint8)n;
+         fpos[n] = (uint16)pos;
+         n++;
+      }
+   }
+   grp->nframetime = (uint16)n;
+   ecx_pdstat_rxstart(grp);
+   npending = n;
+   while (npending)
+   {
+      k = ecx_waitinframe_any(context->port, pidx, npending, &wkc2, timeout);
+      if (k < 0)
+      {
+         break;
+      }
+      rxtime = (npending == 1) ? osal_monotonic_time() : 0;
+      f = pframe[k];
+      ecx_receive_pdframe(context, idxstack, fpos[f], &group, 1, wkc2, callback, &wkc);
+      /* keep timestamps of frame before its index is reused */
+      ecx_getframetime(context->port, pidx[k], &(grp->frametime[f]));
+      if (wkc2 > EC_NOFRAME)
+      {
+         ecx_pdstat_rxframe(grp, &(grp->frametime[f]), idxstack->sendtime, rxtime);
+      }
+      /* release buffer */
+      ecx_setbufstat(context->port, pidx[k], EC_BUF_EMPTY);
+      npending--;
+      pidx[k] = pidx[npending];
+      pframe[k] = pframe[npending];
+   }
+   /* frames lost */
+   for (k = 0; k < npending; k++)
+   {
+      ecx_getframetime(context->port, pidx[k], &(grp->frametime[pframe[k]]));
+      ecx_setbufstat(context->port, pidx[k], EC_BUF_EMPTY);
+   }
+
+   ecx_clearindex(idxstack);
+   ecx_pdstat_rxend(grp, wkc, osal_monotonic_time());
+
+   /* EC_NOFRAME if no frames has arrived */
    return wkc;
 }
 
 
+/** Receive processdata of more groups from slaves.
+ * Second part from ecx_send_processdata_groups(), with the same list of
+ * groups. Frames shared by groups are recombined into the processdata of
+ * every group in them. The software timestamps of a frame are kept in the
+ * frametime list of every group with datagrams in it.
+ * @param[in]  context        = context struct
+ * @param[in]  groups         = groups of the send
+ * @param[in]  ngroups        = number of groups
+ * @param[in]  timeout        = Timeout in us.
+ * @param[out] wkc            = work counter of every group, EC_NOFRAME if none
+ *                              of its frames arrived
+ * @return Work counter of all groups.
+ */
+int ecx_receive_processdata_groups(ecx_contextt *context, const uint8 *groups, int ngroups,
+                                   int timeout, int *wkc)
+{
+   uint8 idx, group;
+   int g, pos, start, first = -1;
+   int total = EC_NOFRAME, wkc2;
+   int64 rxtime, end;
+   ec_frametimet *frametime;
+   ec_idxstackT *idxstack;
+   ec_groupt *grp;
+
+   for (g = 0; g < ngroups; g++)
+   {
+      grp = context->grouplist + groups[g];
+      if (grp->zerocopy)
+      {
+         wkc[g] = ecx_zerocopy_receive_processdata(context, groups[g], timeout);
+      }
+      else
+      {
+         wkc[g] = EC_NOFRAME;
+         grp->nframetime = 0;
+         ecx_pdstat_rxstart(grp);
+         if (first < 0)
+         {
+            first = g;
+         }
+      }
+   }
+   group = (first >= 0) ? groups[first] : 0;
+   idxstack = (first >= 0) ? ecx_receive_idxstack(context, &group) : NULL;
+   if (idxstack)
+   {
+      pos = 0;
+      /* read the same number of frames as send */
+      while (pos < idxstack->pushed)
+      {
+         idx = idxstack->idx[pos];
+         wkc2 = ecx_waitinframe(context->port, idx, timeout);
+         rxtime = (idx == idxstack->idx[idxstack->pushed - 1]) ? osal_monotonic_time() : 0;
+         start = pos;
+         pos = ecx_receive_pdframe(context, idxstack, pos, groups, ngroups, wkc2, NULL, wkc);
+         /* keep timestamps of frame before its index is reused */
+         for (; start < pos; start++)
+         {
+            if ((start == 0) || (idxstack->group[start] != idxstack->group[start - 1]) ||
+                (idxstack->idx[start] != idxstack->idx[start - 1]))
+            {
+               grp = context->grouplist + idxstack->group[start];
+               if (grp->nframetime < EC_MAXBUF)
+               {
+                  frametime = &(grp->frametime[grp->nframetime++]);
+                  ecx_getframetime(context->port, idx, frametime);
+                  if (wkc2 > EC_NOFRAME)
+                  {
+                     ecx_pdstat_rxframe(grp, frametime, idxstack->sendtime, rxtime);
+                  }
+               }
+            }
+         }
+         /* release buffer */
+         ecx_setbufstat(context->port, idx, EC_BUF_EMPTY);
+      }
+      ecx_clearindex(idxstack);
+      end = osal_monotonic_time();
+      for (g = first; g < ngroups; g++)
+      {
+         grp = context->grouplist + groups[g];
+         if (!grp->zerocopy)
+         {
+            ecx_pdstat_rxend(grp, wkc[g], end);
+         }
+      }
+   }
+
+   for (g = 0; g < ngroups; g++)
+   {
+      if (wkc[g] > EC_NOFRAME)
+      {
+         total = ((total > EC_NOFRAME) ? total : 0) + wkc[g];
+      }
+   }
+   /* EC_NOFRAME if no frames has arrived */
+   return total;
+}
+
+
 int ecx_send_processdata(ecx_contextt *context)
 {
    return ecx_send_processdata_group(context, 0);
@@ -22,7 +22,9 @@ extern "C"
 /** max. length of readable name in slavelist and Object Description List */
 #define EC_MAXNAME        40
 /** max. number of slaves in array */
+#ifndef EC_MAXSLAVE
 #define EC_MAXSLAVE       200
+#endif
 /** max. number of groups */
 #define EC_MAXGROUP       2
 /** max. number of IO segments per group */
@@ -235,6 +237,112 @@ typedef struct ec_slave
    char             name[EC_MAXNAME + 1];
 } ec_slavet;
 
+/** stack structure to store segmented LRD/LWR/LRW constructs */
+typedef struct ec_idxstack
+{
+   uint16  pushed;
+   uint16  pulled;
+   uint8   idx[EC_MAXBUF];
+   uint8   group[EC_MAXBUF];
+   void    *data[EC_MAXBUF];
+   uint16  length[EC_MAXBUF];
+   uint16  dcoffset[EC_MAXBUF];
+   uint16  offset[EC_MAXBUF];
+   /** position of the datagram in the pddatagram plan of its group */
+   uint16  datagram[EC_MAXBUF];
+   /** monotonic time the frames were sent in ns */
+   int64   sendtime;
+} ec_idxstackT;
+
+/** max. number of datagrams in the process data frame plan of a group, LRD
+ * and LWR datagrams for every IO segment */
+#define EC_MAXPDDATAGRAMS  (2 * EC_MAXIOSEGMENTS)
+
+/** precompiled process data datagram, see ecx_compile_processdata_group() */
+typedef struct ec_pddatagram
+{
+   /** EtherCAT header of the process data datagram. The send uses command,
+    * ADP, ADO and data length, it sets the index, the frame length and the
+    * datagram follows flag for the frame the datagram ends up in */
+   ec_comt          header;
+   /** source of the datagram data, NULL for LRD */
+   uint8            *txdata;
+   /** destination of the received datagram data */
+   uint8            *rxdata;
+   /** length of the datagram data */
+   uint16           length;
+   /** offset of the datagram data in the rx frame */
+   uint16           offset;
+   /** TRUE if the datagram is packed into the frame of the previous one */
+   boolean          packed;
+   /** expected workcounter of the datagram */
+   uint16           expectedWKC;
+} ec_pddatagramt;
+
+/** linear sub-buckets per power of two in a process data histogram, as bits */
+#define EC_HISTSUBBITS     3
+/** linear sub-buckets per power of two in a process data histogram */
+#define EC_HISTSUB         (1 << EC_HISTSUBBITS)
+/** buckets of a process data histogram, for values up to 2^32-1 */
+#define EC_HISTBUCKETS     ((32 - EC_HISTSUBBITS + 1) * EC_HISTSUB)
+
+/** Process data statistics recorded for every group, see ec_pdstatt */
+enum
+{
+   /** lateness of the wakeup of the cycle in ns, see ecx_pdstat_wakeup() */
+   EC_PDSTAT_WAKEUP = 0,
+   /** time spent in the send in ns */
+   EC_PDSTAT_SEND,
+   /** round trip of the slowest frame of the cycle in ns, from the frame
+    * timestamps of the port, without them of the last frame from the end of
+    * the send */
+   EC_PDSTAT_ROUNDTRIP,
+   /** time from the return of the last frame to the end of the receive in ns */
+   EC_PDSTAT_RXPROC,
+   /** workcounters missing of the expected outputsWKC * 2 + inputsWKC, 0
+    * for a good cycle, the whole expected workcounter if no frame returned */
+   EC_PDSTAT_WKCMISS,
+   EC_PDSTAT_MAX
+};
+
+/** Log-linear histogram. Values below EC_HISTSUB have a bucket of their own,
+ * above every power of two is split into EC_HISTSUB buckets, so a bucket is
+ * at most 1/EC_HISTSUB of its value wide. See ecx_pdstat_bucketstart().
+ */
+typedef struct ec_hist
+{
+   /** number of values */
+   uint64         count;
+   /** sum of the values */
+   uint64         sum;
+   /** smallest value, valid if count > 0 */
+   uint32         min;
+   /** largest value */
+   uint32         max;
+   /** number of values in each bucket */
+   uint32         bucket[EC_HISTBUCKETS];
+} ec_histt;
+
+/** Process data statistics of a group. Always recorded by the process data
+ * send and receive, without allocation or locks. The cycle thread is the only
+ * writer, read a consistent copy from any thread with ecx_pdstat_read().
+ */
+typedef struct ec_pdstat
+{
+   /** internal, odd while the cycle thread updates the statistics */
+   volatile uint32 seq;
+   /** internal, set by ecx_pdstat_reset(), cleared by the next update */
+   volatile boolean reset;
+   /** receives where no frame of the group returned */
+   uint32         noframe;
+   /** histograms, see EC_PDSTAT_xxx */
+   ec_histt       hist[EC_PDSTAT_MAX];
+   /** internal, slowest round trip of the receive in progress, -1 for none */
+   int64          rtt;
+   /** internal, monotonic time the last frame of the receive returned, 0 for none */
+   int64          rxtime;
+} ec_pdstatt;
+
 /** for list of ethercat slave groups */
 typedef struct ec_group
 {
@@ -270,6 +378,50 @@ typedef struct ec_group
    boolean          docheckstate;
    /** IO segmentation list. Datagrams must not break SM in two. */
    uint32           IOsegment[EC_MAXIOSEGMENTS];
+   /** number of frames in frametime */
+   uint16           nframetime;
+   /** software timestamps of the frames of the last process data receive, in
+    * the order the frames were sent, see ecx_getframetime() */
+   ec_frametimet    frametime[EC_MAXBUF];
+   /** set before mapping to map the process data into the frame buffers of
+    * the port instead of the IOmap, cleared by the mapping if not possible.
+    * Needs a non redundant port and a group that fits in one frame. The
+    * outputs then live in the tx buffer and the inputs in the rx buffer of
+    * the frame, each contiguous but not behind each other as in the IOmap.
+    * The inputs are stable from the return of the receive until the next
+    * send of the group, read them from other threads with
+    * ecx_zerocopy_read() */
+   boolean          zerocopy;
+   /** TRUE if zcidx is pinned to the group in zero copy mode */
+   boolean          zcpinned;
+   /** frame index pinned to the group in zero copy mode */
+   uint8            zcidx;
+   /** DC slave the zero copy frame was built for, 0 = no DC */
+   uint16           zcdcnext;
+   /** offset of DC datagram data in the zero copy rx frame */
+   uint16           zcdcoffset;
+   /** zero copy input sequence, odd from the send until the receive of the
+    * group has completed, while the driver may write the inputs */
+   volatile uint32  zcseq;
+   /** number of datagrams in the process data frame plan */
+   uint16           npddatagrams;
+   /** TRUE if the frame plan was compiled for an overlapping IOmap */
+   boolean          pdoverlap;
+   /** outputs pointer the frame plan was compiled for */
+   uint8            *pdoutputs;
+   /** inputs pointer the frame plan was compiled for */
+   uint8            *pdinputs;
+   /** DC slave the first frame of the plan is set up for, 0 = no DC */
+   uint16           pddcnext;
+   /** EtherCAT header of the DC datagram appended to the first frame */
+   ec_comt          pddcheader;
+   /** process data frame plan, datagrams in the order they are sent */
+   ec_pddatagramt   pddatagram[EC_MAXPDDATAGRAMS];
+   /** frames of the process data send in flight, so every group can be
+    * cycled from its own thread */
+   ec_idxstackT     idxstack;
+   /** latency, jitter and workcounter statistics of the process data cycle */
+   ec_pdstatt       pdstat;
 } ec_groupt;
 
 /** SII FMMU structure */
@@ -332,16 +484,26 @@ typedef struct PACKED ec_alstatus
 } ec_alstatust;
 PACKED_END
 
-/** stack structure to store segmented LRD/LWR/LRW constructs */
-typedef struct ec_idxstack
+/** max. number of process data sends in flight in pipelined mode */
+#define EC_MAXPIPELINE     4
+
+/** index stacks of the process data sends in flight in pipelined mode */
+typedef struct ec_pipeline
 {
-   uint8   pushed;
-   uint8   pulled;
-   uint8   idx[EC_MAXBUF];
-   void    *data[EC_MAXBUF];
-   uint16  length[EC_MAXBUF];
-   uint16  dcoffset[EC_MAXBUF];
-} ec_idxstackT;
+   /** index stack of every send in flight, used as ring */
+   ec_idxstackT stack[EC_MAXPIPELINE];
+   /** group of every send in flight */
+   uint8        group[EC_MAXPIPELINE];
+   /** ring position of the oldest send in flight */
+   uint16       oldest;
+   /** number of sends in flight */
+   uint16       inflight;
+} ec_pipelinet;
+
+/** called by ecx_receive_processdata_group_stream() for every process data
+ * datagram as soon as its frame arrived, datagram is the position in
+ * grouplist[group].pddatagram and wkc the workcounter of the datagram */
+typedef void (*ec_pdreadyt)(ecx_contextt *context, uint8 group, int datagram, int wkc);
 
 /** ringbuf for error storage */
 typedef struct ec_ering
@@ -381,6 +543,57 @@ typedef struct PACKED ec_PDOdesc
 } ec_PDOdesct;
 PACKED_END
 
+/** Bring-up phases timed by ecx_config_init() and ecx_config_map_group() */
+enum
+{
+   /** no phase is timed */
+   EC_CONFPHASE_NONE = -1,
+   /** broadcast slave count and reset of slaves to default */
+   EC_CONFPHASE_DETECT = 0,
+   /** APRD/APWR station addressing and register reads of slaves */
+   EC_CONFPHASE_ENUM,
+   /** ecx_readeeprom1/2 rounds over all slaves */
+   EC_CONFPHASE_EEPROM,
+   /** SII category scans for general, strings, SM and FMMU sections */
+   EC_CONFPHASE_SII,
+   /** AL state requests and state checks */
+   EC_CONFPHASE_STATE,
+   /** PDO mapping by CoE and SoE */
+   EC_CONFPHASE_COE,
+   /** PDO mapping by SII */
+   EC_CONFPHASE_SIIPDO,
+   /** SyncManager programming */
+   EC_CONFPHASE_SM,
+   /** IOmap layout and FMMU programming */
+   EC_CONFPHASE_FMMU,
+   /** number of phases */
+   EC_CONFPHASE_MAX
+};
+
+/** time and traffic of one bring-up phase */
+typedef struct ec_confphase
+{
+   /** elapsed time in us */
+   uint32         time;
+   /** frames transmitted on the primary port */
+   uint32         frames;
+} ec_confphaset;
+
+/** Bring-up phase timers, set ecx_contextt.confstat to enable them.
+ * ecx_config_init() clears them, ecx_config_map_group() adds to them.
+ */
+typedef struct ec_confstat
+{
+   /** phases, see EC_CONFPHASE_xxx */
+   ec_confphaset  phase[EC_CONFPHASE_MAX];
+   /** internal, phase being timed */
+   int            current;
+   /** internal, start time of current phase in ns, see osal_monotonic_time() */
+   int64          start;
+   /** internal, transmitted frames at start of current phase */
+   uint32         startframes;
+} ec_confstatt;
+
 /** Context structure , referenced by all ecx functions*/
 struct ecx_context
 {
@@ -404,7 +617,8 @@ struct ecx_context
    uint16         esislave;
    /** internal, reference to error list */
    ec_eringt      *elist;
-   /** internal, reference to processdata stack buffer info */
+   /** internal, reference to processdata stack buffer info, unused, kept for
+    * compatibility, the groups have their own stack in ec_groupt */
    ec_idxstackT   *idxstack;
    /** reference to ecaterror state */
    boolean        *ecaterror;
@@ -429,6 +643,14 @@ struct ecx_context
    /** userdata, promotes application configuration esp. in EC_VER2 with multiple 
     * ec_context instances. Note: userdata memory is managed by application, not SOEM */
    void           *userdata;
+   /** bring-up phase timers, NULL to disable them. Contexts that are not
+    * static must set it, ecx_config_init() and ecx_config_map_group() write
+    * through it when it is not NULL */
+   ec_confstatt   *confstat;
+   /** index stacks for pipelined process data, NULL for one send in flight.
+    * Contexts that are not static must set it, the process data functions
+    * use the pipelined mode whenever it is not NULL */
+   ec_pipelinet   *pipeline;
 };
 
 #ifdef EC_VER1
@@ -519,10 +741,25 @@ void ecx_readeeprom1(ecx_contextt *context, uint16 slave, uint16 eeproma);
 uint32 ecx_readeeprom2(ecx_contextt *context, uint16 slave, int timeout);
 int ecx_send_overlap_processdata_group(ecx_contextt *context, uint8 group);
 int ecx_receive_processdata_group(ecx_contextt *context, uint8 group, int timeout);
+int ecx_receive_processdata_group_stream(ecx_contextt *context, uint8 group, int timeout,
+                                         ec_pdreadyt callback);
 int ecx_send_processdata(ecx_contextt *context);
 int ecx_send_overlap_processdata(ecx_contextt *context);
 int ecx_receive_processdata(ecx_contextt *context, int timeout);
 int ecx_send_processdata_group(ecx_contextt *context, uint8 group);
+int ecx_compile_processdata_group(ecx_contextt *context, uint8 group, boolean use_overlap_io);
+int ecx_send_processdata_groups(ecx_contextt *context, const uint8 *groups, int ngroups);
+int ecx_send_overlap_processdata_groups(ecx_contextt *context, const uint8 *groups, int ngroups);
+int ecx_receive_processdata_groups(ecx_contextt *context, const uint8 *groups, int ngroups,
+                                   int timeout, int *wkc);
+int ecx_processdata_groups_wiresize(ecx_contextt *context, const uint8 *groups, int ngroups,
+                                    boolean shared, int *frames);
+void ecx_pdstat_wakeup(ecx_contextt *context, uint8 group, int64 lateness);
+int ecx_pdstat_read(ecx_contextt *context, uint8 group, ec_pdstatt *pdstat);
+void ecx_pdstat_reset(ecx_contextt *context, uint8 group);
+uint32 ecx_pdstat_bucketstart(int bucket);
+uint32 ecx_pdstat_percentile(const ec_histt *hist, uint32 ppm);
+int ecx_zerocopy_read(ecx_contextt *context, uint8 group, const uint8 *src, void *dst, uint32 length);
 
 #ifdef __cplusplus
 }
@@ -219,6 +219,19 @@ const ec_mbxerrorlist_t ec_mbxerrorlist[] = {
    {0xffff, "Unknown"}
 };
 
+/** Bring-up phase names, indexed by EC_CONFPHASE_xxx */
+const char *ec_confphasenames[EC_CONFPHASE_MAX] = {
+   "detect",
+   "enumerate",
+   "eeprom",
+   "sii",
+   "state",
+   "coe/soe pdo",
+   "sii pdo",
+   "sm",
+   "fmmu"
+};
+
 /** Look up text string that belongs to SDO error code.
  *
  * @param[in] sdoerrorcode   = SDO error code as defined in EtherCAT protocol
@@ -291,6 +304,21 @@ char* ec_mbxerror2string( uint16 errorcode)
    return (char *) ec_mbxerrorlist[i].errordescription;
 }
 
+/** Look up name of bring-up phase.
+ *
+ * @param[in] phase   = phase, see EC_CONFPHASE_xxx
+ * @return readable string
+ */
+char* ec_confphase2string( int phase)
+{
+   if ((phase < 0) || (phase >= EC_CONFPHASE_MAX))
+   {
+      return "Unknown";
+   }
+
+   return (char *) ec_confphasenames[phase];
+}
+
 /** Convert an error to text string.
  *
  * @param[in] Ec = Struct describing the error.
@@ -58,8 +58,14 @@ extern "C"
 #define EC_BUFSIZE         EC_MAXECATFRAME
 /** datagram type EtherCAT */
 #define EC_ECATTYPE        0x1000
-/** number of frame buffers per channel (tx, rx1 rx2) */
+/** number of frame buffers per channel (tx, rx1 rx2), this is also the
+ * capacity of the frame index pool. Max 256 as the datagram index is 8 bit. */
+#ifndef EC_MAXBUF
 #define EC_MAXBUF          16
+#endif
+#if EC_MAXBUF > 256
+#error "EC_MAXBUF can not exceed the 256 values of the datagram index"
+#endif
 /** timeout value in us for tx frame to return to rx */
 #define EC_TIMEOUTRET      2000
 /** timeout value in us for safe data transfer, max. triple retry */
@@ -186,6 +192,29 @@ typedef enum
    EC_BUF_COMPLETE     = 0x04
 } ec_bufstate;
 
+/** Frame index pool partitions */
+typedef enum
+{
+   /** Best effort, mailbox, EEPROM, configuration and other acyclic traffic */
+   EC_IDXPART_BE       = 0x00,
+   /** Reserved for process data */
+   EC_IDXPART_RT       = 0x01
+} ec_idxpart;
+
+/** number of frame index pool partitions */
+#define EC_IDXPARTS        2
+
+/** Software timestamps of a frame, taken by the network stack where the port
+ * supports it. In ns since 1970-01-01 on the realtime clock, 0 if not available.
+ */
+typedef struct
+{
+   /** transmit time */
+   int64 tx;
+   /** receive time */
+   int64 rx;
+} ec_frametimet;
+
 /** Ethercat data types */
 typedef enum
 {
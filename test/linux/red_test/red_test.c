@@ -24,16 +24,14 @@
 
 #include "ethercat.h"
 
-#define NSEC_PER_SEC 1000000000
 #define EC_TIMEOUTMON 500
 
 struct sched_param schedp;
 char IOmap[4096];
-pthread_t thread1, thread2;
+pthread_t thread2;
 struct timeval tv, t1, t2;
-int dorun = 0;
 int deltat, tmax = 0;
-int64 toff, gl_delta;
+ec_cyclict cyclic;
 int DCdiff;
 int os;
 uint8 ob;
@@ -46,9 +44,19 @@ boolean inOP;
 uint8 currentgroup = 0;
 
 
-void redtest(char *ifname, char *ifname2)
+/* called by the cyclic engine after the process data returned */
+void received(ec_cyclict *cyc, uint8 group, int cwkc)
+{
+   (void)group;
+   wkc = cwkc;
+   /* if we have some digital output, cycle */
+   if( digout ) *digout = (uint8) ((cyc->cycles / 16) & 0xff);
+}
+
+void redtest(char *ifname, char *ifname2, int ctime)
 {
    int cnt, i, j, oloop, iloop;
+   ec_portstatT portstats;
 
    printf("Starting Redundant test\n");
 
@@ -90,8 +98,13 @@ void redtest(char *ifname, char *ifname2)
          ec_slave[0].state = EC_STATE_OPERATIONAL;
          /* request OP state for all slaves */
          ec_writestate(0);
-         /* activate cyclic process data */
-         dorun = 1;
+         /* activate cyclic process data, the engine locks its cycle to DC */
+         ecx_cyclic_init(&cyclic, &ecx_context, (int64)ctime * 1000);
+         cyclic.received = &received;
+         if (!ecx_cyclic_start(&cyclic))
+         {
+            printf("Could not start RT cyclic thread\n");
+         }
          /* wait for all slaves to reach OP state */
          ec_statecheck(0, EC_STATE_OPERATIONAL,  5 * EC_TIMEOUTSTATE);
          oloop = ec_slave[0].Obytes;
@@ -108,7 +121,7 @@ void redtest(char *ifname, char *ifname2)
             for(i = 1; i <= 5000; i++)
             {
                printf("Processdata cycle %5d , Wck %3d, DCtime %12"PRId64", dt %12"PRId64", O:",
-                  dorun, wkc , ec_DCtime, gl_delta);
+                  (int)cyclic.cycles, wkc , ec_DCtime, cyclic.delta);
                for(j = 0 ; j < oloop; j++)
                {
                   printf(" %2.2x", *(ec_slave[0].outputs + j));
@@ -122,7 +135,6 @@ void redtest(char *ifname, char *ifname2)
                fflush(stdout);
                osal_usleep(20000);
             }
-            dorun = 0;
             inOP = FALSE;
          }
          else
@@ -138,6 +150,11 @@ void redtest(char *ifname, char *ifname2)
                  }
              }
          }
+         ecx_cyclic_stop(&cyclic);
+         ec_getportstats(&portstats);
+         printf("\nFrames tx %u/%u rx %u, timeouts %u, retries %u, ring repairs %u, stale %u, foreign %u\n",
+            portstats.txframes, portstats.redtxframes, portstats.rxframes, portstats.timeouts,
+            portstats.retries, portstats.redrepairs, portstats.stale, portstats.foreign);
          printf("Request safe operational state for all slaves\n");
          ec_slave[0].state = EC_STATE_SAFE_OP;
          /* request SAFE_OP state for all slaves */
@@ -157,79 +174,6 @@ void redtest(char *ifname, char *ifname2)
    }
 }
 
-/* add ns to timespec */
-void add_timespec(struct timespec *ts, int64 addtime)
-{
-   int64 sec, nsec;
-
-   nsec = addtime % NSEC_PER_SEC;
-   sec = (addtime - nsec) / NSEC_PER_SEC;
-   ts->tv_sec += sec;
-   ts->tv_nsec += nsec;
-   if ( ts->tv_nsec >= NSEC_PER_SEC )
-   {
-      nsec = ts->tv_nsec % NSEC_PER_SEC;
-      ts->tv_sec += (ts->tv_nsec - nsec) / NSEC_PER_SEC;
-      ts->tv_nsec = nsec;
-   }
-}
-
-/* PI calculation to get linux time synced to DC time */
-void ec_sync(int64 reftime, int64 cycletime , int64 *offsettime)
-{
-   static int64 integral = 0;
-   int64 delta;
-   /* set linux sync point 50us later than DC sync, just as example */
-   delta = (reftime - 50000) % cycletime;
-   if(delta> (cycletime / 2)) { delta= delta - cycletime; }
-   if(delta>0){ integral++; }
-   if(delta<0){ integral--; }
-   *offsettime = -(delta / 100) - (integral / 20);
-   gl_delta = delta;
-}
-
-/* RT EtherCAT thread */
-OSAL_THREAD_FUNC_RT ecatthread(void *ptr)
-{
-   struct timespec   ts, tleft;
-   int ht;
-   int64 cycletime;
-
-   clock_gettime(CLOCK_MONOTONIC, &ts);
-   ht = (ts.tv_nsec / 1000000) + 1; /* round to nearest ms */
-   ts.tv_nsec = ht * 1000000;
-   if (ts.tv_nsec >= NSEC_PER_SEC) {
-      ts.tv_sec++;
-      ts.tv_nsec -= NSEC_PER_SEC;
-   }
-   cycletime = *(int*)ptr * 1000; /* cycletime in ns */
-   toff = 0;
-   dorun = 0;
-   ec_send_processdata();
-   while(1)
-   {
-      /* calculate next cycle start */
-      add_timespec(&ts, cycletime + toff);
-      /* wait to cycle start */
-      clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, &tleft);
-      if (dorun>0)
-      {
-         wkc = ec_receive_processdata(EC_TIMEOUTRET);
-
-         dorun++;
-         /* if we have some digital output, cycle */
-         if( digout ) *digout = (uint8) ((dorun / 16) & 0xff);
-
-         if (ec_slave[0].hasdc)
-         {
-            /* calulate toff to get linux time and DC synced */
-            ec_sync(ec_DCtime, cycletime, &toff);
-         }
-         ec_send_processdata();
-      }
-   }
-}
-
 OSAL_THREAD_FUNC ecatcheck( void *ptr )
 {
     int slave;
@@ -318,17 +262,13 @@ int main(int argc, char *argv[])
 
    if (argc > 3)
    {
-      dorun = 0;
       ctime = atoi(argv[3]);
 
-      /* create RT thread */
-      osal_thread_create_rt(&thread1, stack64k * 2, &ecatthread, (void*) &ctime);
-
       /* create thread to handle slave error handling in OP */
       osal_thread_create(&thread2, stack64k * 4, &ecatcheck, NULL);
 
       /* start acyclic part */
-      redtest(argv[1],argv[2]);
+      redtest(argv[1],argv[2],ctime);
    }
    else
    {
@@ -0,0 +1,432 @@
+/** \file
+ * \brief Slave emulator for Simple Open EtherCAT master
+ *
+ * Usage : slavesim ifname [-n slaves] [-o bytes] [-i bytes] [-d ns] [-f devfile]...
+ * ifname is one end of a veth pair, the master runs unmodified on the other
+ * end, f.e.
+ *
+ *    ip link add vetha type veth peer name vethb
+ *    ip link set vetha up; ip link set vethb up
+ *    slavesim vethb -f el2008.dev -f el1008.dev
+ *    simple_test vetha
+ *
+ * Frames received on ifname are processed by a line of simulated slaves, see
+ * nicdrv_sim.c, and sent back when the frame would return from a real line,
+ * after the processing delay of all slaves. Frames in flight do not hold up
+ * each other.
+ *
+ * -n slaves   number of generated slaves when no device file is given
+ * -o bytes    output bytes of generated slaves
+ * -i bytes    input bytes of generated slaves
+ * -d ns       processing delay per slave, for generated slaves and the device
+ *             files after it
+ * -f devfile  add the slaves of a device file, may be repeated
+ *
+ * A device file has one "key value" per line, # starts a comment:
+ * name     device name
+ * vendor   vendor ID
+ * product  product code
+ * outputs  output bytes
+ * inputs   input bytes
+ * sii      binary SII image, f.e. from eepromtool -r, it replaces the image
+ *          generated from the keys above and its PDOs define the layout
+ * delay    processing delay in ns
+ * count    number of slaves of this device
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <net/if.h>
+#include <netpacket/packet.h>
+#include <arpa/inet.h>
+
+#include "ethercat.h"
+#include "nicdrv_sim.h"
+
+#define MAXDEV      64
+#define MAXSII      65536
+#define MAXSLENGTH  256
+#define MAXQUEUE    64
+/* time in ns spent spinning before a frame is due, longer waits sleep */
+#define SPINTIME    50000
+
+typedef struct
+{
+   char     name[MAXSLENGTH];
+   uint32   vendor;
+   uint32   product;
+   int      obytes;
+   int      ibytes;
+   int      delay;
+   int      count;
+   uint8    *sii;
+   int      siisize;
+} devicet;
+
+typedef struct
+{
+   uint8    buf[EC_BUFSIZE];
+   int      len;
+   int64    due;
+} framet;
+
+devicet dev[MAXDEV];
+int ndev;
+ec_simT sim;
+framet queue[MAXQUEUE];
+int qhead, qcount;
+volatile sig_atomic_t run = 1;
+uint32 nframes, ndropped;
+
+static int64 now_ns(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (int64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void stop(int sig)
+{
+   (void)sig;
+   run = 0;
+}
+
+static int input_sii(const char *fname, devicet *d)
+{
+   FILE *fp;
+   uint8 *buf;
+   int cc = 0, c;
+
+   fp = fopen(fname, "rb");
+   if (fp == NULL)
+      return 0;
+   buf = (uint8 *)malloc(MAXSII);
+   if (buf == NULL)
+   {
+      fclose(fp);
+      return 0;
+   }
+   while (((c = fgetc(fp)) != EOF) && (cc < MAXSII))
+      buf[cc++] = (uint8)c;
+   fclose(fp);
+   free(d->sii);
+   d->sii = buf;
+   d->siisize = cc;
+
+   return (cc > 0);
+}
+
+static void default_device(devicet *d, int obytes, int ibytes, int delay)
+{
+   memset(d, 0, sizeof(*d));
+   strcpy(d->name, "SOEM simulated slave");
+   d->vendor = EC_SIM_VENDOR;
+   d->obytes = obytes;
+   d->ibytes = ibytes;
+   d->delay = delay;
+   d->count = 1;
+}
+
+static int input_device(const char *fname, devicet *d, int delay)
+{
+   FILE *fp;
+   char sline[MAXSLENGTH], key[MAXSLENGTH], val[MAXSLENGTH];
+   int retval = 1, product = 0, ln = 0;
+
+   fp = fopen(fname, "r");
+   if (fp == NULL)
+   {
+      printf("Can not open device file %s\n", fname);
+      return 0;
+   }
+   default_device(d, 0, 0, delay);
+   while (retval && fgets(sline, MAXSLENGTH, fp))
+   {
+      ln++;
+      if (strchr(sline, '#'))
+         *strchr(sline, '#') = 0;
+      if (sscanf(sline, "%255s %255[^\r\n]", key, val) != 2)
+         continue;
+      if (!strcmp(key, "name"))
+         strcpy(d->name, val);
+      else if (!strcmp(key, "vendor"))
+         d->vendor = (uint32)strtoul(val, NULL, 0);
+      else if (!strcmp(key, "product"))
+      {
+         d->product = (uint32)strtoul(val, NULL, 0);
+         product = 1;
+      }
+      else if (!strcmp(key, "outputs"))
+         d->obytes = atoi(val);
+      else if (!strcmp(key, "inputs"))
+         d->ibytes = atoi(val);
+      else if (!strcmp(key, "delay"))
+         d->delay = atoi(val);
+      else if (!strcmp(key, "count"))
+         d->count = atoi(val);
+      else if (!strcmp(key, "sii"))
+      {
+         retval = input_sii(val, d);
+         if (!retval)
+            printf("%s:%d can not read SII image %s\n", fname, ln, val);
+      }
+      else
+      {
+         printf("%s:%d unknown key %s\n", fname, ln, key);
+         retval = 0;
+      }
+   }
+   fclose(fp);
+   if (retval && !product)
+      d->product = ((uint32)d->obytes << 16) | (uint32)d->ibytes;
+   if (retval && (d->count < 1))
+   {
+      printf("%s invalid count %d\n", fname, d->count);
+      retval = 0;
+   }
+
+   return retval;
+}
+
+static int setup_sim(void)
+{
+   uint8 *sii;
+   int i, c, slave, total, size;
+
+   total = 0;
+   for (i = 0; i < ndev; i++)
+      total += dev[i].count;
+   if (!ecx_sim_create(&sim, total, 0, 0))
+   {
+      printf("Can not create %d slaves\n", total);
+      return 0;
+   }
+   slave = 1;
+   for (i = 0; i < ndev; i++)
+   {
+      sii = dev[i].sii;
+      size = dev[i].siisize;
+      if (sii == NULL)
+      {
+         size = EC_SIM_SIISIZE(dev[i].obytes, dev[i].ibytes);
+         sii = (uint8 *)malloc(size);
+         size = sii ? ecx_sim_gensii(sii, size, dev[i].name, dev[i].vendor,
+                                     dev[i].product, dev[i].obytes, dev[i].ibytes) : 0;
+         if (!size)
+         {
+            printf("Invalid layout of %s, O:%d I:%d bytes\n",
+                   dev[i].name, dev[i].obytes, dev[i].ibytes);
+            free(sii);
+            return 0;
+         }
+      }
+      printf("Slave %d..%d: %s O:%d I:%d delay %d ns\n", slave, slave + dev[i].count - 1,
+             dev[i].name, dev[i].obytes, dev[i].ibytes, dev[i].delay);
+      for (c = 0; c < dev[i].count; c++)
+      {
+         ecx_sim_setsii(&sim, slave, sii, size);
+         ecx_sim_setdelay(&sim, slave, dev[i].delay);
+         slave++;
+      }
+      if (sii != dev[i].sii)
+         free(sii);
+   }
+   printf("%d slaves, line delay %lld ns\n", total, (long long)sim.linedelay);
+
+   return 1;
+}
+
+static int open_socket(const char *ifname)
+{
+   struct ifreq ifr;
+   struct sockaddr_ll sll;
+   int sock;
+
+   sock = socket(PF_PACKET, SOCK_RAW, htons(ETH_P_ECAT));
+   if (sock < 0)
+      return -1;
+   memset(&ifr, 0, sizeof(ifr));
+   strncpy(ifr.ifr_name, ifname, IFNAMSIZ - 1);
+   if (ioctl(sock, SIOCGIFINDEX, &ifr) < 0)
+   {
+      close(sock);
+      return -1;
+   }
+   memset(&sll, 0, sizeof(sll));
+   sll.sll_family = AF_PACKET;
+   sll.sll_ifindex = ifr.ifr_ifindex;
+   sll.sll_protocol = htons(ETH_P_ECAT);
+   ioctl(sock, SIOCGIFFLAGS, &ifr);
+   ifr.ifr_flags |= IFF_PROMISC | IFF_BROADCAST;
+   ioctl(sock, SIOCSIFFLAGS, &ifr);
+   if (bind(sock, (struct sockaddr *)&sll, sizeof(sll)) < 0)
+   {
+      close(sock);
+      return -1;
+   }
+
+   return sock;
+}
+
+/* receive and process all pending frames, queue them until they are due */
+static void receive_frames(int sock)
+{
+   struct sockaddr_ll sll;
+   socklen_t sll_len;
+   ec_etherheadert *ehp;
+   framet *f;
+   int len;
+
+   while (qcount < MAXQUEUE)
+   {
+      f = &queue[(qhead + qcount) % MAXQUEUE];
+      sll_len = sizeof(sll);
+      len = (int)recvfrom(sock, f->buf, sizeof(f->buf), MSG_DONTWAIT,
+                          (struct sockaddr *)&sll, &sll_len);
+      if (len <= 0)
+         break;
+      /* own frames are looped back to the packet socket */
+      if (sll.sll_pkttype == PACKET_OUTGOING)
+         continue;
+      ehp = (ec_etherheadert *)f->buf;
+      if ((len <= (int)ETH_HEADERSIZE) || (ehp->etype != htons(ETH_P_ECAT)) ||
+          (ecx_sim_process(&sim, f->buf + ETH_HEADERSIZE, len - ETH_HEADERSIZE) == EC_NOFRAME))
+      {
+         ndropped++;
+         continue;
+      }
+      /* set U/L bit of source MAC as the first ESC does */
+      ehp->sa0 |= htons(0x0200);
+      f->len = len;
+      f->due = now_ns() + sim.linedelay;
+      qcount++;
+   }
+}
+
+static void slavesim(const char *ifname)
+{
+   struct pollfd pfd;
+   struct timespec ts;
+   int64 wait;
+   framet *f;
+   int sock;
+
+   sock = open_socket(ifname);
+   if (sock < 0)
+   {
+      printf("Can not open raw socket on %s: %s\n", ifname, strerror(errno));
+      return;
+   }
+   printf("Serving %s, stop with Ctrl-C\n", ifname);
+   pfd.fd = sock;
+   pfd.events = POLLIN;
+   while (run)
+   {
+      if (!qcount)
+      {
+         if (ppoll(&pfd, 1, NULL, NULL) > 0)
+            receive_frames(sock);
+         continue;
+      }
+      f = &queue[qhead];
+      wait = f->due - now_ns();
+      if (wait <= 0)
+      {
+         if (send(sock, f->buf, f->len, 0) == f->len)
+            nframes++;
+         else
+            ndropped++;
+         qhead = (qhead + 1) % MAXQUEUE;
+         qcount--;
+      }
+      else if ((wait > SPINTIME) && (qcount < MAXQUEUE))
+      {
+         wait -= SPINTIME;
+         ts.tv_sec = wait / 1000000000;
+         ts.tv_nsec = wait % 1000000000;
+         if (ppoll(&pfd, 1, &ts, NULL) > 0)
+            receive_frames(sock);
+      }
+      else if (qcount < MAXQUEUE)
+      {
+         receive_frames(sock);
+      }
+   }
+   close(sock);
+   printf("\n%u frames returned, %u dropped\n", nframes, ndropped);
+}
+
+int main(int argc, char *argv[])
+{
+   struct sigaction sa;
+   int i, nslave = 1, obytes = 1, ibytes = 1, delay = EC_SIM_FWDDELAY, retval = 1;
+
+   printf("SOEM (Simple Open EtherCAT Master)\nSlave emulator\n");
+
+   if (argc < 2)
+   {
+      printf("Usage: slavesim ifname [-n slaves] [-o bytes] [-i bytes] [-d ns] [-f devfile]...\n");
+      printf("ifname = vethb for example\n");
+      printf("    -n slaves   number of generated slaves when no device file is given\n");
+      printf("    -o bytes    output bytes of generated slaves\n");
+      printf("    -i bytes    input bytes of generated slaves\n");
+      printf("    -d ns       processing delay per slave, for generated slaves and the\n");
+      printf("                device files after it\n");
+      printf("    -f devfile  add the slaves of a device file, may be repeated\n");
+      return 0;
+   }
+   for (i = 2; retval && (i < argc); i++)
+   {
+      if ((i + 1 < argc) && !strcmp(argv[i], "-n"))
+         nslave = atoi(argv[++i]);
+      else if ((i + 1 < argc) && !strcmp(argv[i], "-o"))
+         obytes = atoi(argv[++i]);
+      else if ((i + 1 < argc) && !strcmp(argv[i], "-i"))
+         ibytes = atoi(argv[++i]);
+      else if ((i + 1 < argc) && !strcmp(argv[i], "-d"))
+         delay = atoi(argv[++i]);
+      else if ((i + 1 < argc) && !strcmp(argv[i], "-f") && (ndev < MAXDEV))
+      {
+         retval = input_device(argv[++i], &dev[ndev], delay);
+         ndev++;
+      }
+      else
+      {
+         printf("Invalid option %s\n", argv[i]);
+         retval = 0;
+      }
+   }
+   if (retval && !ndev)
+   {
+      default_device(&dev[0], obytes, ibytes, delay);
+      dev[0].product = ((uint32)obytes << 16) | (uint32)ibytes;
+      dev[0].count = nslave;
+      ndev = 1;
+   }
+   if (retval && setup_sim())
+   {
+      memset(&sa, 0, sizeof(sa));
+      /* no SA_RESTART, ppoll() returns on Ctrl-C */
+      sa.sa_handler = stop;
+      sigaction(SIGINT, &sa, NULL);
+      sigaction(SIGTERM, &sa, NULL);
+      slavesim(argv[1]);
+      ecx_sim_destroy(&sim);
+   }
+   for (i = 0; i < ndev; i++)
+      free(dev[i].sii);
+
+   printf("End program\n");
+
+   return 0;
+}
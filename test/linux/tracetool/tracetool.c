@@ -0,0 +1,201 @@
+/** \file
+ * \brief Decoder of the trace files of Simple Open EtherCAT master
+ *
+ * Usage : tracetool tracefile [-n records]
+ * tracefile is written by ecx_trace_save() of a port built with EC_TRACE,
+ * f.e. soem_bench -T trace.bin. The records are printed as a timeline, one
+ * line per record:
+ *
+ * time     us since the first record
+ * delta    us since the previous record
+ * event    TX, RX, TIMEOUT, MBXTX, MBXRX, STATEREQ or STATE
+ * stack    P = primary, S = secondary
+ * idx      frame index, mailbox counter for mailbox events
+ * cmd      EtherCAT command, mailbox type or slave state
+ * adp/ado  address of the first datagram, slave and mailbox address or AL
+ *          status code for the other events
+ * len      frame or mailbox length
+ * dgr      datagrams in the frame
+ * wkc      workcounter
+ * rtt      us since the frame was sent, for RX
+ *
+ * -n records  print only the last records
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ethercat.h"
+
+static ec_tracerect *rec;
+static int64 txtime[256];
+
+static const char *eventname(uint8 type)
+{
+   switch (type)
+   {
+      case EC_TRACE_TX: return "TX";
+      case EC_TRACE_RX: return "RX";
+      case EC_TRACE_TIMEOUT: return "TIMEOUT";
+      case EC_TRACE_MBXTX: return "MBXTX";
+      case EC_TRACE_MBXRX: return "MBXRX";
+      case EC_TRACE_STATEREQ: return "STATEREQ";
+      case EC_TRACE_STATE: return "STATE";
+      default: return "?";
+   }
+}
+
+static const char *cmdname(uint8 cmd)
+{
+   static const char *name[] = { "NOP", "APRD", "APWR", "APRW", "FPRD", "FPWR", "FPRW",
+                                 "BRD", "BWR", "BRW", "LRD", "LWR", "LRW", "ARMW", "FRMW" };
+
+   if (cmd < sizeof(name) / sizeof(name[0]))
+   {
+      return name[cmd];
+   }
+   return "?";
+}
+
+static const char *mbxname(uint8 type)
+{
+   switch (type)
+   {
+      case ECT_MBXT_ERR: return "ERR";
+      case ECT_MBXT_AOE: return "AoE";
+      case ECT_MBXT_EOE: return "EoE";
+      case ECT_MBXT_COE: return "CoE";
+      case ECT_MBXT_FOE: return "FoE";
+      case ECT_MBXT_SOE: return "SoE";
+      case ECT_MBXT_VOE: return "VoE";
+      default: return "?";
+   }
+}
+
+static void statename(uint8 state, char *buf, size_t size)
+{
+   const char *name;
+
+   switch (state & 0x0f)
+   {
+      case EC_STATE_NONE: name = "NONE"; break;
+      case EC_STATE_INIT: name = "INIT"; break;
+      case EC_STATE_PRE_OP: name = "PRE-OP"; break;
+      case EC_STATE_BOOT: name = "BOOT"; break;
+      case EC_STATE_SAFE_OP: name = "SAFE-OP"; break;
+      case EC_STATE_OPERATIONAL: name = "OP"; break;
+      default: name = "?"; break;
+   }
+   snprintf(buf, size, "%s%s", name, (state & EC_STATE_ERROR) ? "+ERR" : "");
+}
+
+static void printrecord(const ec_tracerect *r, int64 start, int64 prev)
+{
+   char cmd[16];
+   char rtt[16];
+
+   rtt[0] = 0;
+   switch (r->type)
+   {
+      case EC_TRACE_TX:
+      case EC_TRACE_RX:
+      case EC_TRACE_TIMEOUT:
+         snprintf(cmd, sizeof(cmd), "%s", cmdname(r->cmd));
+         break;
+      case EC_TRACE_MBXTX:
+      case EC_TRACE_MBXRX:
+         snprintf(cmd, sizeof(cmd), "%s", mbxname(r->cmd));
+         break;
+      default:
+         statename(r->cmd, cmd, sizeof(cmd));
+         break;
+   }
+   if ((r->type == EC_TRACE_TX) && !r->stack)
+   {
+      txtime[r->idx] = r->time;
+   }
+   if ((r->type == EC_TRACE_RX) && txtime[r->idx])
+   {
+      snprintf(rtt, sizeof(rtt), "%9.3f", (r->time - txtime[r->idx]) / 1000.0);
+   }
+   printf("%12.3f %9.3f %-8s %c %3d %-8s %5d 0x%4.4x %5d %3d %5d %s\n",
+          (r->time - start) / 1000.0, (r->time - prev) / 1000.0, eventname(r->type),
+          r->stack ? 'S' : 'P', r->idx, cmd, r->adp, r->ado, r->length, r->datagrams,
+          r->wkc, rtt);
+}
+
+int main(int argc, char *argv[])
+{
+   ec_traceheadert header;
+   FILE *fp;
+   int i, first, last;
+   int count[EC_TRACE_STATE + 1];
+
+   if ((argc < 2) || ((argc == 4) && strcmp(argv[2], "-n")) || ((argc != 2) && (argc != 4)))
+   {
+      printf("Usage: tracetool tracefile [-n records]\n");
+      printf("tracefile = trace saved with ecx_trace_save()\n");
+      printf("    -n records  print only the last records\n");
+      return 0;
+   }
+   fp = fopen(argv[1], "rb");
+   if (fp == NULL)
+   {
+      printf("Could not open %s\n", argv[1]);
+      return 1;
+   }
+   if ((fread(&header, sizeof(header), 1, fp) != 1) || (header.magic != EC_TRACEMAGIC))
+   {
+      printf("%s is not a trace file\n", argv[1]);
+      fclose(fp);
+      return 1;
+   }
+   if ((header.version != EC_TRACEVERSION) || (header.recsize != sizeof(ec_tracerect)))
+   {
+      printf("Unsupported trace version %u, record size %u\n", header.version, header.recsize);
+      fclose(fp);
+      return 1;
+   }
+   rec = (ec_tracerect *)malloc((header.count + 1) * sizeof(ec_tracerect));
+   if ((rec == NULL) || (fread(rec, sizeof(ec_tracerect), header.count, fp) != header.count))
+   {
+      printf("Truncated trace file\n");
+      free(rec);
+      fclose(fp);
+      return 1;
+   }
+   fclose(fp);
+
+   last = (int)header.count;
+   first = 0;
+   if ((argc == 4) && (atoi(argv[3]) < last))
+   {
+      first = last - atoi(argv[3]);
+   }
+   printf("%d records\n", last);
+   printf("     time us  delta us event    S idx cmd        adp    ado   len dgr   wkc    rtt us\n");
+   memset(count, 0, sizeof(count));
+   for (i = 0; i < last; i++)
+   {
+      if (rec[i].type <= EC_TRACE_STATE)
+      {
+         count[rec[i].type]++;
+      }
+      if (i >= first)
+      {
+         printrecord(&rec[i], rec[0].time, (i > 0) ? rec[i - 1].time : rec[0].time);
+      }
+      else if ((rec[i].type == EC_TRACE_TX) && !rec[i].stack)
+      {
+         txtime[rec[i].idx] = rec[i].time;
+      }
+   }
+   printf("TX %d RX %d TIMEOUT %d MBXTX %d MBXRX %d STATEREQ %d STATE %d\n",
+          count[EC_TRACE_TX], count[EC_TRACE_RX], count[EC_TRACE_TIMEOUT],
+          count[EC_TRACE_MBXTX], count[EC_TRACE_MBXRX], count[EC_TRACE_STATEREQ],
+          count[EC_TRACE_STATE]);
+   free(rec);
+
+   return 0;
+}
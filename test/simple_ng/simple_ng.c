@@ -75,6 +75,10 @@ fieldbus_initialize(Fieldbus *fieldbus, char *iface)
     context->FOEhook = NULL;
     context->EOEhook = NULL;
     context->manualstatechange = 0;
+#ifdef __linux__
+    /* Measure the round trip with the timestamps of the network stack */
+    fieldbus->port.portmode = ECT_PORTMODE_TIMESTAMP;
+#endif
 }
 
 static int
@@ -82,16 +86,23 @@ fieldbus_roundtrip(Fieldbus *fieldbus)
 {
     ecx_contextt *context;
     ec_timet start, end, diff;
+    ec_frametimet *frametime;
     int wkc;
 
     context = &fieldbus->context;
+    frametime = &fieldbus->grouplist[0].frametime[0];
 
     start = osal_current_time();
     ecx_send_processdata(context);
     wkc = ecx_receive_processdata(context, EC_TIMEOUTRET);
     end = osal_current_time();
-    osal_time_diff(&start, &end, &diff);
-    fieldbus->roundtrip_time = diff.sec * 1000000 + diff.usec;
+    if (fieldbus->grouplist[0].nframetime > 0 && frametime->tx != 0 && frametime->rx != 0) {
+        /* Wire round trip of the first frame, without the user space overhead */
+        fieldbus->roundtrip_time = (int)((frametime->rx - frametime->tx) / 1000);
+    } else {
+        osal_time_diff(&start, &end, &diff);
+        fieldbus->roundtrip_time = diff.sec * 1000000 + diff.usec;
+    }
 
     return wkc;
 }
@@ -280,6 +291,40 @@ fieldbus_check_state(Fieldbus *fieldbus)
     }
 }
 
+static void
+fieldbus_print_hist(const char *name, const ec_histt *hist)
+{
+    if (hist->count == 0) {
+        return;
+    }
+    printf("%-12s min %7u  p50 %7u  p99 %7u  p99.9 %7u  max %7u\n", name,
+           hist->min,
+           ecx_pdstat_percentile(hist, 500000),
+           ecx_pdstat_percentile(hist, 990000),
+           ecx_pdstat_percentile(hist, 999000),
+           hist->max);
+}
+
+static void
+fieldbus_print_stat(Fieldbus *fieldbus)
+{
+    ec_pdstatt pdstat;
+    const ec_histt *miss;
+
+    if (! ecx_pdstat_read(&fieldbus->context, fieldbus->group, &pdstat)) {
+        return;
+    }
+    printf("\nProcess data statistics (nsec):\n");
+    fieldbus_print_hist("send", &pdstat.hist[EC_PDSTAT_SEND]);
+    fieldbus_print_hist("roundtrip", &pdstat.hist[EC_PDSTAT_ROUNDTRIP]);
+    fieldbus_print_hist("receive", &pdstat.hist[EC_PDSTAT_RXPROC]);
+    miss = &pdstat.hist[EC_PDSTAT_WKCMISS];
+    printf("%llu cycles, %llu with wrong WKC, %u without frames\n",
+           (unsigned long long) miss->count,
+           (unsigned long long) (miss->count - miss->bucket[0]),
+           pdstat.noframe);
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -295,6 +340,7 @@ main(int argc, char *argv[])
     if (fieldbus_start(&fieldbus)) {
         int i, min_time, max_time;
         min_time = max_time = 0;
+        ecx_pdstat_reset(&fieldbus.context, fieldbus.group);
         for (i = 1; i <= 10000; ++i) {
             printf("Iteration %4d:", i);
             if (! fieldbus_dump(&fieldbus)) {
@@ -309,6 +355,7 @@ main(int argc, char *argv[])
             osal_usleep(5000);
         }
         printf("\nRoundtrip time (usec): min %d max %d\n", min_time, max_time);
+        fieldbus_print_stat(&fieldbus);
         fieldbus_stop(&fieldbus);
     }
 
@@ -0,0 +1,938 @@
+/** \file
+ * \brief Process data cycle benchmark for Simple Open EtherCAT master
+ *
+ * Usage: soem_bench [options]
+ *
+ * Runs ecx_send_processdata_group() and ecx_receive_processdata_group()
+ * cycles against simulated slaves for every combination of the swept
+ * parameters and reports per case the distribution of the cycle round trip,
+ * the syscalls and the CPU time of one cycle.
+ *
+ * By default the in-process simulator transport answers the frames, so the
+ * numbers are the cost of the master alone. With -i and -p the frames go
+ * through the raw socket of the driver on one end of a veth pair and a
+ * stand-in thread answers them on the other end with the same simulator.
+ *
+ * The slave counts are limited by EC_MAXSLAVE. Configure with f.e.
+ * -DSOEM_MAXSLAVE=1024 to measure networks of 1000 slaves and more.
+ *
+ * Syscalls are counted by wrapping the socket calls of the driver at link
+ * time, only those of the cycle thread are counted.
+ *
+ * With -u the full bring-up from ecx_config_init() to OP is run instead for
+ * every slave count and the time and frames of each phase are reported,
+ * using the phase timers of ethercatconfig.c.
+ *
+ * With -T and a library built with SOEM_TRACE the trace ring of the port is
+ * saved at the end of every case, the file holds the last case. Decode it
+ * with tracetool.
+ */
+
+#define _GNU_SOURCE
+#include "ethercat.h"
+#include "nicdrv_sim.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#include <net/if.h>
+#include <netpacket/packet.h>
+#include <arpa/inet.h>
+
+#define BENCH_MAXLIST   16
+#define BENCH_MAPSIZE   (1 << 20)
+#define BENCH_WARMUP    1000
+/* group 0 maps all slaves, the benchmark uses groups 1 .. BENCH_MAXGROUP - 1 */
+#define BENCH_MAXGROUP  9
+
+typedef struct {
+    int     slaves;
+    int     bytes;
+    int     groups;
+    boolean lrdlwr;
+    boolean overlap;
+    boolean zerocopy;
+    int     depth;
+} BenchCase;
+
+typedef struct {
+    uint32  min;
+    uint32  median;
+    uint32  p99;
+    uint32  p999;
+    uint32  max;
+    double  syscalls;
+    double  cputime;
+    uint32  wkcerrors;
+} BenchResult;
+
+typedef struct {
+    ecx_contextt    context;
+    int             expected_wkc[BENCH_MAXGROUP];
+
+    /* Used by the context */
+    ecx_portt       port;
+    ec_slavet       slavelist[EC_MAXSLAVE];
+    int             slavecount;
+    ec_groupt       grouplist[BENCH_MAXGROUP];
+    uint8           esibuf[EC_MAXEEPBUF];
+    uint32          esimap[EC_MAXEEPBITMAP];
+    ec_eringt       elist;
+    ec_idxstackT    idxstack;
+    boolean         ecaterror;
+    int64           DCtime;
+    ec_SMcommtypet  SMcommtype[EC_MAX_MAPT];
+    ec_PDOassignt   PDOassign[EC_MAX_MAPT];
+    ec_PDOdesct     PDOdesc[EC_MAX_MAPT];
+    ec_eepromSMt    eepSM;
+    ec_eepromFMMUt  eepFMMU;
+    ec_confstatt    confstat;
+    ec_pipelinet    pipeline;
+} Bench;
+
+/* bring-up steps timed by the benchmark itself, after the EC_CONFPHASE_xxx */
+enum {
+    BRINGUP_DC = EC_CONFPHASE_MAX,
+    BRINGUP_SAFEOP,
+    BRINGUP_OP,
+    BRINGUP_TOTAL,
+    BRINGUP_PHASES
+};
+
+typedef struct {
+    double  time[BRINGUP_PHASES];
+    double  frames[BRINGUP_PHASES];
+} BringupResult;
+
+typedef struct {
+    ec_simT *       sim;
+    int             sock;
+    volatile int    run;
+    pthread_t       thread;
+} Standin;
+
+static Bench bench;
+static uint8 iomap[BENCH_MAPSIZE];
+static ec_simT sim;
+static Standin standin;
+
+/* options */
+static int cycles = 100000;
+static int bringup = 0;
+static char *ifname = NULL;
+static char *peername = NULL;
+static int portmode = 0;
+static int waitmode = 0;
+static int timeout = EC_TIMEOUTRET;
+static int stream = 0;
+static int shared = 0;
+static char *tracefile = NULL;
+
+/* datagrams of the streaming receive with an unexpected workcounter */
+static uint32 datagramerrors;
+
+/* Syscalls of the driver, wrapped with -Wl,--wrap=<name> */
+static __thread uint64 nsyscalls;
+
+ssize_t __real_send(int fd, const void *buf, size_t len, int flags);
+ssize_t __real_sendto(int fd, const void *buf, size_t len, int flags,
+                      const struct sockaddr *addr, socklen_t addrlen);
+int __real_sendmmsg(int fd, struct mmsghdr *msgvec, unsigned int vlen, int flags);
+ssize_t __real_recv(int fd, void *buf, size_t len, int flags);
+ssize_t __real_recvmsg(int fd, struct msghdr *msg, int flags);
+int __real_recvmmsg(int fd, struct mmsghdr *msgvec, unsigned int vlen, int flags,
+                    struct timespec *timeout);
+int __real_ppoll(struct pollfd *fds, nfds_t nfds, const struct timespec *tmo,
+                 const sigset_t *sigmask);
+long __real_syscall(long number, ...);
+int __real_eventfd_read(int fd, eventfd_t *value);
+int __real_eventfd_write(int fd, eventfd_t value);
+
+ssize_t __wrap_send(int fd, const void *buf, size_t len, int flags)
+{
+    nsyscalls++;
+    return __real_send(fd, buf, len, flags);
+}
+
+ssize_t __wrap_sendto(int fd, const void *buf, size_t len, int flags,
+                      const struct sockaddr *addr, socklen_t addrlen)
+{
+    nsyscalls++;
+    return __real_sendto(fd, buf, len, flags, addr, addrlen);
+}
+
+int __wrap_sendmmsg(int fd, struct mmsghdr *msgvec, unsigned int vlen, int flags)
+{
+    nsyscalls++;
+    return __real_sendmmsg(fd, msgvec, vlen, flags);
+}
+
+ssize_t __wrap_recv(int fd, void *buf, size_t len, int flags)
+{
+    nsyscalls++;
+    return __real_recv(fd, buf, len, flags);
+}
+
+ssize_t __wrap_recvmsg(int fd, struct msghdr *msg, int flags)
+{
+    nsyscalls++;
+    return __real_recvmsg(fd, msg, flags);
+}
+
+int __wrap_recvmmsg(int fd, struct mmsghdr *msgvec, unsigned int vlen, int flags,
+                    struct timespec *tmo)
+{
+    nsyscalls++;
+    return __real_recvmmsg(fd, msgvec, vlen, flags, tmo);
+}
+
+int __wrap_ppoll(struct pollfd *fds, nfds_t nfds, const struct timespec *tmo,
+                 const sigset_t *sigmask)
+{
+    nsyscalls++;
+    return __real_ppoll(fds, nfds, tmo, sigmask);
+}
+
+int __wrap_eventfd_read(int fd, eventfd_t *value)
+{
+    nsyscalls++;
+    return __real_eventfd_read(fd, value);
+}
+
+int __wrap_eventfd_write(int fd, eventfd_t value)
+{
+    nsyscalls++;
+    return __real_eventfd_write(fd, value);
+}
+
+/* the arguments are forwarded with their types, only for the calls the
+ * driver makes: futex of the rx buffer waiters and bpf of AF_XDP */
+long __wrap_syscall(long number, ...)
+{
+    va_list ap;
+    void *addr, *ts, *addr2;
+    int op, val, val3;
+    size_t size;
+    long r;
+
+    nsyscalls++;
+    va_start(ap, number);
+    switch (number) {
+    case __NR_futex:
+        addr = va_arg(ap, void *);
+        op = va_arg(ap, int);
+        val = va_arg(ap, int);
+        ts = va_arg(ap, void *);
+        addr2 = va_arg(ap, void *);
+        val3 = va_arg(ap, int);
+        r = __real_syscall(number, addr, op, val, ts, addr2, val3);
+        break;
+    case __NR_bpf:
+        op = va_arg(ap, int);
+        addr = va_arg(ap, void *);
+        size = va_arg(ap, size_t);
+        r = __real_syscall(number, op, addr, size);
+        break;
+    default:
+        errno = ENOSYS;
+        r = -1;
+        break;
+    }
+    va_end(ap);
+    return r;
+}
+
+static int64
+now_ns(clockid_t clock)
+{
+    struct timespec ts;
+
+    clock_gettime(clock, &ts);
+    return (int64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void *
+standin_run(void *arg)
+{
+    Standin *s = (Standin *)arg;
+    struct pollfd pfd;
+    struct sockaddr_ll sll;
+    socklen_t sll_len;
+    ec_etherheadert *ehp;
+    uint8 frame[EC_BUFSIZE];
+    int len;
+
+    pfd.fd = s->sock;
+    pfd.events = POLLIN;
+    while (s->run) {
+        if (poll(&pfd, 1, 100) <= 0) {
+            continue;
+        }
+        for (;;) {
+            sll_len = sizeof(sll);
+            len = (int)recvfrom(s->sock, frame, sizeof(frame), MSG_DONTWAIT,
+                                (struct sockaddr *)&sll, &sll_len);
+            if (len <= 0) {
+                break;
+            }
+            ehp = (ec_etherheadert *)frame;
+            if (sll.sll_pkttype == PACKET_OUTGOING || len <= (int)ETH_HEADERSIZE ||
+                ehp->etype != htons(ETH_P_ECAT)) {
+                continue;
+            }
+            if (ecx_sim_process(s->sim, frame + ETH_HEADERSIZE,
+                                len - ETH_HEADERSIZE) != EC_NOFRAME) {
+                ehp->sa0 |= htons(0x0200);
+                send(s->sock, frame, len, 0);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+static boolean
+standin_start(Standin *s, ec_simT *simulator, const char *iface)
+{
+    struct ifreq ifr;
+    struct sockaddr_ll sll;
+
+    s->sim = simulator;
+    s->sock = socket(PF_PACKET, SOCK_RAW, htons(ETH_P_ECAT));
+    if (s->sock < 0) {
+        return FALSE;
+    }
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, iface, IFNAMSIZ - 1);
+    memset(&sll, 0, sizeof(sll));
+    if (ioctl(s->sock, SIOCGIFINDEX, &ifr) == 0) {
+        sll.sll_family = AF_PACKET;
+        sll.sll_ifindex = ifr.ifr_ifindex;
+        sll.sll_protocol = htons(ETH_P_ECAT);
+        ioctl(s->sock, SIOCGIFFLAGS, &ifr);
+        ifr.ifr_flags |= IFF_PROMISC | IFF_BROADCAST;
+        ioctl(s->sock, SIOCSIFFLAGS, &ifr);
+        if (bind(s->sock, (struct sockaddr *)&sll, sizeof(sll)) == 0) {
+            s->run = 1;
+            if (pthread_create(&s->thread, NULL, standin_run, s) == 0) {
+                return TRUE;
+            }
+        }
+    }
+    close(s->sock);
+
+    return FALSE;
+}
+
+static void
+standin_stop(Standin *s)
+{
+    s->run = 0;
+    pthread_join(s->thread, NULL);
+    close(s->sock);
+}
+
+static void
+bench_initialize(Bench *b)
+{
+    ecx_contextt *context;
+
+    memset(b, 0, sizeof(*b));
+    context = &b->context;
+    context->port = &b->port;
+    context->slavelist = b->slavelist;
+    context->slavecount = &b->slavecount;
+    context->maxslave = EC_MAXSLAVE;
+    context->grouplist = b->grouplist;
+    context->maxgroup = BENCH_MAXGROUP;
+    context->esibuf = b->esibuf;
+    context->esimap = b->esimap;
+    context->esislave = 0;
+    context->elist = &b->elist;
+    context->idxstack = &b->idxstack;
+    context->ecaterror = &b->ecaterror;
+    context->DCtime = &b->DCtime;
+    context->SMcommtype = b->SMcommtype;
+    context->PDOassign = b->PDOassign;
+    context->PDOdesc = b->PDOdesc;
+    context->eepSM = &b->eepSM;
+    context->eepFMMU = &b->eepFMMU;
+    context->FOEhook = NULL;
+    context->EOEhook = NULL;
+    context->manualstatechange = 0;
+    context->userdata = NULL;
+    context->confstat = &b->confstat;
+}
+
+/* Streaming receive callback, checks the workcounter of every datagram */
+static void
+bench_ready(ecx_contextt *context, uint8 group, int datagram, int wkc)
+{
+    if (wkc != context->grouplist[group].pddatagram[datagram].expectedWKC) {
+        datagramerrors++;
+    }
+}
+
+static int
+bench_receive(Bench *b, int g)
+{
+    if (stream) {
+        return ecx_receive_processdata_group_stream(&b->context, (uint8)g, timeout, bench_ready);
+    }
+    return ecx_receive_processdata_group(&b->context, (uint8)g, timeout);
+}
+
+/* Send all groups in shared frames and receive them, per group workcounters */
+static void
+bench_cycle_shared(Bench *b, const BenchCase *bc, uint32 *wkcerrors)
+{
+    ecx_contextt *context = &b->context;
+    ec_pipelinet *pipeline = context->pipeline;
+    uint8 list[BENCH_MAXGROUP];
+    int wkc[BENCH_MAXGROUP];
+    int g;
+
+    for (g = 0; g < bc->groups; g++) {
+        list[g] = (uint8)(g + 1);
+    }
+    if (bc->overlap) {
+        ecx_send_overlap_processdata_groups(context, list, bc->groups);
+    } else {
+        ecx_send_processdata_groups(context, list, bc->groups);
+    }
+    /* pipelined, every send of all groups takes one stack */
+    while (!pipeline || pipeline->inflight > bc->depth - 1) {
+        ecx_receive_processdata_groups(context, list, bc->groups, timeout, wkc);
+        for (g = 0; g < bc->groups; g++) {
+            if (wkc[g] != b->expected_wkc[list[g]]) {
+                (*wkcerrors)++;
+            }
+        }
+        if (!pipeline) {
+            break;
+        }
+    }
+}
+
+static void
+bench_cycle(Bench *b, const BenchCase *bc, uint32 *wkcerrors)
+{
+    ecx_contextt *context = &b->context;
+    ec_pipelinet *pipeline = context->pipeline;
+    int g;
+
+    if (shared) {
+        bench_cycle_shared(b, bc, wkcerrors);
+        return;
+    }
+    /* pipelined, the sends of depth cycles are in flight */
+    if (pipeline) {
+        for (g = 1; g <= bc->groups; g++) {
+            if (bc->overlap) {
+                ecx_send_overlap_processdata_group(context, (uint8)g);
+            } else {
+                ecx_send_processdata_group(context, (uint8)g);
+            }
+        }
+        while (pipeline->inflight > (bc->depth - 1) * bc->groups) {
+            g = pipeline->group[pipeline->oldest];
+            if (bench_receive(b, g) != b->expected_wkc[g]) {
+                (*wkcerrors)++;
+            }
+        }
+        return;
+    }
+    /* every group has its own index stack, the frames of all groups are in
+     * flight at the same time */
+    for (g = 1; g <= bc->groups; g++) {
+        if (bc->overlap) {
+            ecx_send_overlap_processdata_group(context, (uint8)g);
+        } else {
+            ecx_send_processdata_group(context, (uint8)g);
+        }
+    }
+    for (g = 1; g <= bc->groups; g++) {
+        if (bench_receive(b, g) != b->expected_wkc[g]) {
+            (*wkcerrors)++;
+        }
+    }
+}
+
+/* Bring the simulated slaves of the case to OP, returns an error text */
+static const char *
+bench_start(Bench *b, const BenchCase *bc)
+{
+    ecx_contextt *context = &b->context;
+    ec_groupt *grp;
+    int i, g, size, frames;
+    uint32 dummy = 0;
+
+    if (ecx_config_init(context, FALSE) != bc->slaves) {
+        return "config_init";
+    }
+    for (i = 1; i <= b->slavecount; i++) {
+        b->slavelist[i].group = (uint8)(1 + (i - 1) * bc->groups / bc->slaves);
+        b->slavelist[i].blockLRW = bc->lrdlwr ? 1 : 0;
+    }
+    size = 0;
+    frames = 0;
+    for (g = 1; g <= bc->groups; g++) {
+        b->grouplist[g].zerocopy = bc->zerocopy;
+        if (bc->overlap) {
+            size += ecx_config_overlap_map_group(context, iomap + size, (uint8)g);
+        } else {
+            size += ecx_config_map_group(context, iomap + size, (uint8)g);
+        }
+        grp = &b->grouplist[g];
+        if (grp->zerocopy != bc->zerocopy) {
+            return "zero copy needs lrw and one frame";
+        }
+        b->expected_wkc[g] = grp->outputsWKC * 2 + grp->inputsWKC;
+        frames += grp->nsegments * (bc->lrdlwr ? 2 : 1);
+    }
+    /* all frames of a cycle have to be in flight at the same time */
+    if (frames * bc->depth >= b->port.bufnr) {
+        return "too many frames";
+    }
+    ecx_statecheck(context, 0, EC_STATE_SAFE_OP, EC_TIMEOUTSTATE);
+    b->slavelist[0].state = EC_STATE_OPERATIONAL;
+    bench_cycle(b, bc, &dummy);
+    ecx_writestate(context, 0);
+    for (i = 0; i < 100 && b->slavelist[0].state != EC_STATE_OPERATIONAL; i++) {
+        bench_cycle(b, bc, &dummy);
+        ecx_statecheck(context, 0, EC_STATE_OPERATIONAL, 50000);
+    }
+    if (b->slavelist[0].state != EC_STATE_OPERATIONAL) {
+        return "no OP";
+    }
+
+    return NULL;
+}
+
+static int
+compare_uint32(const void *a, const void *b)
+{
+    uint32 x = *(const uint32 *)a, y = *(const uint32 *)b;
+
+    return (x > y) - (x < y);
+}
+
+/* Simulate the slaves and open the port of the benchmark, returns an error text */
+static const char *
+bench_open(Bench *b, int slaves, int bytes)
+{
+    if (!ecx_sim_create(&sim, slaves, bytes / 2, bytes - bytes / 2)) {
+        return "sim_create";
+    }
+    bench_initialize(b);
+    b->port.portmode = portmode;
+    b->port.waitmode = waitmode;
+    if (ifname) {
+        if (!standin_start(&standin, &sim, peername)) {
+            ecx_sim_destroy(&sim);
+            return "stand-in";
+        }
+    } else {
+        b->port.transport = &ecx_simtransport;
+        b->port.transportdata = &sim;
+    }
+    if (!ecx_init(&b->context, ifname ? ifname : "sim")) {
+        if (ifname) {
+            standin_stop(&standin);
+        }
+        ecx_sim_destroy(&sim);
+        return "init";
+    }
+
+    return NULL;
+}
+
+static void
+bench_close(Bench *b)
+{
+    b->slavelist[0].state = EC_STATE_INIT;
+    ecx_writestate(&b->context, 0);
+#ifdef EC_TRACE
+    if (tracefile && ecx_trace_save(&b->port, tracefile) < 0) {
+        printf("Can not save trace to %s\n", tracefile);
+    }
+#endif
+    ecx_close(&b->context);
+    if (ifname) {
+        standin_stop(&standin);
+    }
+    ecx_sim_destroy(&sim);
+}
+
+static const char *
+bench_run(const BenchCase *bc, uint32 *rtt, BenchResult *res)
+{
+    Bench *b = &bench;
+    const char *err;
+    int64 t0, cpu0, sys0;
+    int c;
+
+    err = bench_open(b, bc->slaves, bc->bytes);
+    if (err) {
+        return err;
+    }
+    err = bench_start(b, bc);
+    if (!err) {
+        memset(res, 0, sizeof(*res));
+        if (bc->depth > 1) {
+            b->context.pipeline = &b->pipeline;
+        }
+        for (c = 0; c < BENCH_WARMUP; c++) {
+            bench_cycle(b, bc, &res->wkcerrors);
+        }
+        res->wkcerrors = 0;
+        datagramerrors = 0;
+        cpu0 = now_ns(CLOCK_THREAD_CPUTIME_ID);
+        sys0 = (int64)nsyscalls;
+        for (c = 0; c < cycles; c++) {
+            t0 = now_ns(CLOCK_MONOTONIC);
+            bench_cycle(b, bc, &res->wkcerrors);
+            rtt[c] = (uint32)(now_ns(CLOCK_MONOTONIC) - t0);
+        }
+        res->cputime = (double)(now_ns(CLOCK_THREAD_CPUTIME_ID) - cpu0) / cycles;
+        res->syscalls = (double)((int64)nsyscalls - sys0) / cycles;
+        qsort(rtt, cycles, sizeof(*rtt), compare_uint32);
+        res->min = rtt[0];
+        res->median = rtt[(cycles - 1) / 2];
+        res->p99 = rtt[(int)((cycles - 1) * 0.99)];
+        res->p999 = rtt[(int)((cycles - 1) * 0.999)];
+        res->max = rtt[cycles - 1];
+        res->wkcerrors += datagramerrors;
+        /* complete the sends still in flight */
+        while (b->pipeline.inflight) {
+            ecx_receive_processdata_group(&b->context, b->pipeline.group[b->pipeline.oldest],
+                                          timeout);
+        }
+        b->context.pipeline = NULL;
+    }
+    bench_close(b);
+
+    return err;
+}
+
+/* Add time in us and frames since the last mark to a bring-up step */
+static void
+bringup_mark(Bench *b, BringupResult *res, int step, int64 *t, uint32 *frames)
+{
+    int64 now = now_ns(CLOCK_MONOTONIC);
+
+    res->time[step] += (now - *t) / 1000.0;
+    res->frames[step] += b->port.txframes - *frames;
+    *t = now;
+    *frames = b->port.txframes;
+}
+
+static const char *
+bringup_run(int slaves, int bytes, BringupResult *res)
+{
+    Bench *b = &bench;
+    const char *err;
+    int64 t, start;
+    uint32 frames, startframes;
+    int i, p;
+
+    err = bench_open(b, slaves, bytes);
+    if (err) {
+        return err;
+    }
+    t = start = now_ns(CLOCK_MONOTONIC);
+    frames = startframes = b->port.txframes;
+    if (ecx_config_init(&b->context, FALSE) != slaves) {
+        err = "config_init";
+    } else {
+        ecx_config_map_group(&b->context, iomap, 0);
+        for (p = 0; p < EC_CONFPHASE_MAX; p++) {
+            res->time[p] += b->confstat.phase[p].time;
+            res->frames[p] += b->confstat.phase[p].frames;
+        }
+        t = now_ns(CLOCK_MONOTONIC);
+        frames = b->port.txframes;
+        ecx_configdc(&b->context);
+        bringup_mark(b, res, BRINGUP_DC, &t, &frames);
+        ecx_statecheck(&b->context, 0, EC_STATE_SAFE_OP, EC_TIMEOUTSTATE);
+        bringup_mark(b, res, BRINGUP_SAFEOP, &t, &frames);
+        b->slavelist[0].state = EC_STATE_OPERATIONAL;
+        ecx_send_processdata_group(&b->context, 0);
+        ecx_receive_processdata_group(&b->context, 0, timeout);
+        ecx_writestate(&b->context, 0);
+        for (i = 0; i < 100 && b->slavelist[0].state != EC_STATE_OPERATIONAL; i++) {
+            ecx_send_processdata_group(&b->context, 0);
+            ecx_receive_processdata_group(&b->context, 0, timeout);
+            ecx_statecheck(&b->context, 0, EC_STATE_OPERATIONAL, 50000);
+        }
+        bringup_mark(b, res, BRINGUP_OP, &t, &frames);
+        t = start;
+        frames = startframes;
+        bringup_mark(b, res, BRINGUP_TOTAL, &t, &frames);
+        if (b->slavelist[0].state != EC_STATE_OPERATIONAL) {
+            err = "no OP";
+        }
+    }
+    bench_close(b);
+
+    return err;
+}
+
+static void
+bringup_report(int slaves, int bytes, int runs)
+{
+    static const char *steps[BRINGUP_PHASES - EC_CONFPHASE_MAX] = {
+        "dc", "safeop", "op", "total"
+    };
+    BringupResult res;
+    const char *err;
+    int r, p;
+
+    printf("%d slaves, %d bytes per slave, %d runs, averages per run\n", slaves, bytes, runs);
+    memset(&res, 0, sizeof(res));
+    for (r = 0; r < runs; r++) {
+        err = bringup_run(slaves, bytes, &res);
+        if (err) {
+            printf("skipped, %s\n\n", err);
+            return;
+        }
+    }
+    printf("phase             ms   frames\n");
+    for (p = 0; p < BRINGUP_PHASES; p++) {
+        printf("%-12s %7.2f %8.0f\n",
+               p < EC_CONFPHASE_MAX ? ec_confphase2string(p) : steps[p - EC_CONFPHASE_MAX],
+               res.time[p] / runs / 1000.0, res.frames[p] / runs);
+    }
+    printf("\n");
+}
+
+static int
+parse_list(char *arg, int *list, int max)
+{
+    char *tok;
+    int n = 0;
+
+    for (tok = strtok(arg, ","); tok && n < max; tok = strtok(NULL, ",")) {
+        if (!strcmp(tok, "lrw")) {
+            list[n++] = 0;
+        } else if (!strcmp(tok, "lrdlwr")) {
+            list[n++] = 1;
+        } else {
+            list[n++] = atoi(tok);
+        }
+    }
+
+    return n;
+}
+
+/* Check that all values of a list are within lo .. hi */
+static int
+list_in_range(const int *list, int n, int lo, int hi)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        if (list[i] < lo || list[i] > hi) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/* Combinations of the swept parameters that SOEM can not run */
+static int
+bench_runnable(const BenchCase *bc)
+{
+    /* every group needs at least one slave */
+    if (bc->groups > bc->slaves) {
+        return 0;
+    }
+    /* the LRD of blockLRW addresses the inputs behind the outputs */
+    if (bc->lrdlwr && (bc->overlap || bc->zerocopy)) {
+        return 0;
+    }
+    if (bc->depth * (shared ? 1 : bc->groups) > EC_MAXPIPELINE) {
+        return 0;
+    }
+    /* a zero copy frame is sent again after its receive */
+    if (bc->zerocopy && bc->depth > 1) {
+        return 0;
+    }
+
+    return 1;
+}
+
+static void
+usage(void)
+{
+    printf("Usage: soem_bench [options]\n");
+    printf("    -c cycles      measured cycles per case, default 100000\n");
+    printf("    -s list        slave counts, max %d, default 1,16,64,%d\n",
+           EC_MAXSLAVE - 1, EC_MAXSLAVE - 1);
+    printf("    -b list        process data bytes per slave, half outputs, default 2,32\n");
+    printf("    -g list        group counts, max %d, default 1,2\n", BENCH_MAXGROUP - 1);
+    printf("    -a list        access lrw and/or lrdlwr (blockLRW), default lrw,lrdlwr\n");
+    printf("    -o list        overlap mode 0 and/or 1, default 0,1, overlap is\n");
+    printf("                   not measured with lrdlwr as SOEM does not support it\n");
+    printf("    -z list        zero copy mapping 0 and/or 1, default 0,1\n");
+    printf("    -d list        pipeline depth, cycles in flight, default 1, the\n");
+    printf("                   median is then the time per cycle, not the round trip,\n");
+    printf("                   depth times groups is max %d\n", EC_MAXPIPELINE);
+    printf("    -t us          receive timeout, default %d\n", EC_TIMEOUTRET);
+    printf("    -i ifname      use the raw socket on ifname instead of the in-process\n");
+    printf("                   simulator, needs -p\n");
+    printf("    -p peer        other end of the veth pair, answered by a stand-in thread\n");
+    printf("    -m portmode    ECT_PORTMODE_xxx bits of the raw socket port\n");
+    printf("    -w waitmode    ECT_WAIT_xxx of the raw socket port\n");
+    printf("    -r             receive with ecx_receive_processdata_group_stream()\n");
+    printf("    -k             send all groups in shared frames with\n");
+    printf("                   ecx_send_processdata_groups()\n");
+    printf("    -u runs        time the bring-up phases over runs per slave count and\n");
+    printf("                   bytes instead of the process data cycle\n");
+    printf("    -T file        save the frame trace of the last case, needs a\n");
+    printf("                   library built with SOEM_TRACE\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+    int slaves[BENCH_MAXLIST] = { 1, 16, 64, EC_MAXSLAVE - 1 }, nslaves = 4;
+    int bytes[BENCH_MAXLIST] = { 2, 32 }, nbytes = 2;
+    int groups[BENCH_MAXLIST] = { 1, 2 }, ngroups = 2;
+    int access[BENCH_MAXLIST] = { 0, 1 }, naccess = 2;
+    int overlap[BENCH_MAXLIST] = { 0, 1 }, noverlap = 2;
+    int zerocopy[BENCH_MAXLIST] = { 0, 1 }, nzerocopy = 2;
+    int depth[BENCH_MAXLIST] = { 1 }, ndepth = 1;
+    int is, ib, ig, ia, io, iz, id, opt, dropped = 0;
+    BenchCase bc;
+    BenchResult res;
+    const char *err;
+    uint32 *rtt;
+
+    while ((opt = getopt(argc, argv, "c:s:b:g:a:o:z:d:t:i:p:m:w:rku:T:h")) != -1) {
+        switch (opt) {
+        case 'c': cycles = atoi(optarg); break;
+        case 's': nslaves = parse_list(optarg, slaves, BENCH_MAXLIST); break;
+        case 'b': nbytes = parse_list(optarg, bytes, BENCH_MAXLIST); break;
+        case 'g': ngroups = parse_list(optarg, groups, BENCH_MAXLIST); break;
+        case 'a': naccess = parse_list(optarg, access, BENCH_MAXLIST); break;
+        case 'o': noverlap = parse_list(optarg, overlap, BENCH_MAXLIST); break;
+        case 'z': nzerocopy = parse_list(optarg, zerocopy, BENCH_MAXLIST); break;
+        case 'd': ndepth = parse_list(optarg, depth, BENCH_MAXLIST); break;
+        case 't': timeout = atoi(optarg); break;
+        case 'i': ifname = optarg; break;
+        case 'p': peername = optarg; break;
+        case 'm': portmode = (int)strtol(optarg, NULL, 0); break;
+        case 'w': waitmode = atoi(optarg); break;
+        case 'r': stream = 1; break;
+        case 'k': shared = 1; break;
+        case 'u': bringup = atoi(optarg); break;
+        case 'T': tracefile = optarg; break;
+        default: usage(); return 1;
+        }
+    }
+    if (cycles < 1 || (ifname && !peername) || (stream && shared)) {
+        usage();
+        return 1;
+    }
+    if (!list_in_range(slaves, nslaves, 1, EC_MAXSLAVE - 1) ||
+        !list_in_range(groups, ngroups, 1, BENCH_MAXGROUP - 1) ||
+        !list_in_range(depth, ndepth, 1, EC_MAXPIPELINE)) {
+        printf("Slave counts must be 1 .. %d, group counts 1 .. %d and depths 1 .. %d\n",
+               EC_MAXSLAVE - 1, BENCH_MAXGROUP - 1, EC_MAXPIPELINE);
+        return 1;
+    }
+#ifndef EC_TRACE
+    if (tracefile) {
+        printf("-T needs a library built with SOEM_TRACE\n");
+        return 1;
+    }
+#endif
+    rtt = (uint32 *)malloc(cycles * sizeof(*rtt));
+    if (rtt == NULL) {
+        printf("Can not allocate %d samples\n", cycles);
+        return 1;
+    }
+
+    printf("SOEM (Simple Open EtherCAT Master)\n%s benchmark\n",
+           bringup ? "Bring-up" : "Process data");
+    if (ifname) {
+        printf("Transport raw socket %s, stand-in on %s, portmode 0x%x waitmode %d\n",
+               ifname, peername, portmode, waitmode);
+    } else {
+        printf("Transport in-process simulator\n");
+    }
+    if (stream) {
+        printf("Streaming receive, datagram workcounters checked\n");
+    }
+    if (shared) {
+        printf("Groups sent in shared frames\n");
+    }
+    if (bringup) {
+        printf("\n");
+        for (is = 0; is < nslaves; is++) {
+            for (ib = 0; ib < nbytes; ib++) {
+                bringup_report(slaves[is], bytes[ib], bringup);
+            }
+        }
+        free(rtt);
+        return 0;
+    }
+    printf("%d cycles per case, times in us\n\n", cycles);
+    printf("slaves bytes groups access ovl zc pl      min   median      p99    p99.9      max"
+           "  sys/cyc  cpu/cyc wkcerr\n");
+    for (is = 0; is < nslaves; is++) {
+        for (ib = 0; ib < nbytes; ib++) {
+            for (ig = 0; ig < ngroups; ig++) {
+                for (ia = 0; ia < naccess; ia++) {
+                    for (io = 0; io < noverlap; io++) {
+                        for (iz = 0; iz < nzerocopy; iz++) {
+                            for (id = 0; id < ndepth; id++) {
+                                bc.slaves = slaves[is];
+                                bc.bytes = bytes[ib];
+                                bc.groups = groups[ig];
+                                bc.lrdlwr = access[ia] ? TRUE : FALSE;
+                                bc.overlap = overlap[io] ? TRUE : FALSE;
+                                bc.zerocopy = zerocopy[iz] ? TRUE : FALSE;
+                                bc.depth = depth[id];
+                                if (!bench_runnable(&bc)) {
+                                    dropped++;
+                                    continue;
+                                }
+                                printf("%6d %5d %6d %6s %3d %2d %2d ", bc.slaves, bc.bytes, bc.groups,
+                                       bc.lrdlwr ? "lrdlwr" : "lrw", bc.overlap, bc.zerocopy, bc.depth);
+                                fflush(stdout);
+                                err = bench_run(&bc, rtt, &res);
+                                if (err) {
+                                    printf("skipped, %s\n", err);
+                                    continue;
+                                }
+                                printf("%8.2f %8.2f %8.2f %8.2f %8.2f %8.2f %8.2f %6u\n",
+                                       res.min / 1000.0, res.median / 1000.0, res.p99 / 1000.0,
+                                       res.p999 / 1000.0, res.max / 1000.0, res.syscalls,
+                                       res.cputime / 1000.0, res.wkcerrors);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+    if (dropped) {
+        printf("\n%d combinations left out, groups > slaves, overlap or zero copy with\n"
+               "lrdlwr, pipelined zero copy or depth times groups > %d\n", dropped, EC_MAXPIPELINE);
+    }
+    free(rtt);
+
+    return 0;
+}